@@ -0,0 +1,468 @@
+// Headless benchmarks of engine hot paths
+//	They run without a window or GPU on the null graphics device, with reproducible synthetic scenes,
+//	and the results are written to a JSON file that can be compared between engine versions
+//
+// Command line arguments (all optional):
+//	entities=10000,100000,1000000	: scene sizes to run every benchmark with
+//	iterations=10					: measured iterations of each benchmark, after one warm up iteration
+//	filter=scene					: only run benchmarks whose name contains this text
+//	output=benchmarks.json			: the JSON results file
+//	trace=trace.json				: also record the run with wi::trace and export it to this file
+//	seed=0							: random seed of the synthetic scenes
+
+#include "WickedEngine.h"
+#include "wiGraphicsDevice_Null.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace wi::ecs;
+using namespace wi::scene;
+
+struct Config
+{
+	wi::vector<uint32_t> entity_counts = { 10000, 100000, 1000000 };
+	uint32_t iterations = 10;
+	uint32_t seed = 0;
+	std::string filter;
+	std::string output = "benchmarks.json";
+	std::string trace;
+};
+
+struct Result
+{
+	std::string name;
+	uint32_t entities = 0;
+	uint64_t items = 0; // amount of work items that one iteration processes
+	wi::vector<double> samples; // milliseconds
+	wi::vector<std::pair<std::string, double>> metrics; // extra values that describe the workload, for example output sizes
+};
+
+static Config config;
+static wi::vector<Result> results;
+static volatile float sink; // keeps the results of loops that only read data
+
+// Runs func once to warm up, then measures config.iterations runs of it
+//	setup runs before every iteration and is not measured
+template<typename Func, typename Setup>
+Result* Measure(const std::string& name, uint32_t entities, uint64_t items, Func&& func, Setup&& setup)
+{
+	if (!config.filter.empty() && name.find(config.filter) == std::string::npos)
+		return nullptr;
+
+	wi::trace::ScopedRange range(name.c_str());
+
+	Result result;
+	result.name = name;
+	result.entities = entities;
+	result.items = items;
+
+	wi::Timer timer;
+	for (uint32_t i = 0; i < config.iterations + 1; ++i)
+	{
+		setup();
+		timer.record();
+		func();
+		const double time = timer.elapsed_milliseconds();
+		if (i > 0)
+		{
+			result.samples.push_back(time);
+		}
+		wi::allocator::ResetFrameAllocators();
+		wi::graphics::GetDevice()->SubmitCommandLists();
+	}
+
+	wi::vector<double> sorted = result.samples;
+	std::sort(sorted.begin(), sorted.end());
+	std::printf("%-40s %8u entities: median %10.3f ms, min %10.3f ms\n", name.c_str(), entities, sorted[sorted.size() / 2], sorted.front());
+
+	results.push_back(std::move(result));
+	return &results.back();
+}
+template<typename Func>
+Result* Measure(const std::string& name, uint32_t entities, uint64_t items, Func&& func)
+{
+	return Measure(name, entities, items, std::forward<Func>(func), [] {});
+}
+
+// Objects are instances of one cube mesh, spread in a cube of constant density, so that
+//	the visible ratio of the camera and the intersection test hit rates are similar at every scale
+//	Every 8th object is a parent of the next 7 objects, and there is a point light for every 1000 objects
+static float CreateScene(Scene& scene, uint32_t entities, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unorm(0.0f, 1.0f);
+
+	const float extent = std::cbrt(float(entities)) * 4.0f;
+	auto random_position = [&] {
+		return XMFLOAT3((unorm(rng) * 2 - 1) * extent, (unorm(rng) * 2 - 1) * extent, (unorm(rng) * 2 - 1) * extent);
+	};
+
+	const Entity cube = scene.Entity_CreateCube("cube");
+	const Entity mesh = scene.objects.GetComponent(cube)->meshID;
+
+	Entity parent = INVALID_ENTITY;
+	for (uint32_t i = 1; i < entities; ++i)
+	{
+		const Entity entity = scene.Entity_CreateObject("object");
+		scene.objects.GetComponent(entity)->meshID = mesh;
+		TransformComponent& transform = *scene.transforms.GetComponent(entity);
+		transform.Translate(random_position());
+		transform.RotateRollPitchYaw(XMFLOAT3(unorm(rng) * XM_2PI, unorm(rng) * XM_2PI, unorm(rng) * XM_2PI));
+		transform.UpdateTransform();
+
+		if (i % 8 == 0)
+		{
+			parent = entity;
+		}
+		else if (parent != INVALID_ENTITY)
+		{
+			scene.Component_Attach(entity, parent);
+		}
+	}
+
+	for (uint32_t i = 0; i < std::max(1u, entities / 1000); ++i)
+	{
+		scene.Entity_CreateLight("light", random_position(), XMFLOAT3(1, 1, 1), 1, 20);
+	}
+
+	const Entity camera = scene.Entity_CreateCamera("camera", 1920, 1080, 0.1f, extent * 2);
+	scene.transforms.GetComponent(camera)->Translate(XMFLOAT3(0, 0, -extent));
+
+	return extent;
+}
+
+static void BenchmarkJobSystem(uint32_t entities)
+{
+	wi::vector<uint32_t> data(entities);
+	for (uint32_t group_size : { 1u, 64u, 1024u })
+	{
+		Measure("jobsystem.dispatch.groupsize_" + std::to_string(group_size), entities, entities, [&] {
+			wi::jobsystem::context ctx;
+			wi::jobsystem::Dispatch(ctx, entities, group_size, [&](wi::jobsystem::JobArgs args) {
+				data[args.jobIndex] = args.jobIndex;
+			});
+			wi::jobsystem::Wait(ctx);
+		});
+	}
+
+	const uint32_t job_count = std::max(1u, entities / 100);
+	Measure("jobsystem.execute", entities, job_count, [&] {
+		wi::jobsystem::context ctx;
+		for (uint32_t i = 0; i < job_count; ++i)
+		{
+			wi::jobsystem::Execute(ctx, [&data, i](wi::jobsystem::JobArgs args) {
+				data[i] = i;
+			});
+		}
+		wi::jobsystem::Wait(ctx);
+	});
+}
+
+static void BenchmarkComponentManager(uint32_t entities)
+{
+	// Entities are created in order, but queried in a random order, like the systems do when they look up other components:
+	wi::vector<Entity> entity_array(entities);
+	for (auto& entity : entity_array)
+	{
+		entity = CreateEntity();
+	}
+	wi::vector<Entity> query_array = entity_array;
+	std::shuffle(query_array.begin(), query_array.end(), std::mt19937(config.seed));
+
+	ComponentManager<TransformComponent> manager;
+	auto fill = [&] {
+		manager.Clear();
+		for (Entity entity : entity_array)
+		{
+			manager.Create(entity);
+		}
+	};
+
+	Measure("ecs.create", entities, entities, [&] {
+		for (Entity entity : entity_array)
+		{
+			manager.Create(entity);
+		}
+	}, [&] {
+		manager.Clear();
+	});
+
+	fill();
+	float sum = 0;
+	Measure("ecs.lookup_random", entities, entities, [&] {
+		for (Entity entity : query_array)
+		{
+			sum += manager.GetComponent(entity)->translation_local.x;
+		}
+	});
+	Measure("ecs.iterate", entities, entities, [&] {
+		for (size_t i = 0; i < manager.GetCount(); ++i)
+		{
+			sum += manager[i].translation_local.x + float(manager.GetEntity(i));
+		}
+	});
+	sink = sum;
+	Measure("ecs.remove", entities, entities / 2, [&] {
+		for (size_t i = 0; i < query_array.size(); i += 2)
+		{
+			manager.Remove(query_array[i]);
+		}
+	}, fill);
+}
+
+static void BenchmarkScene(uint32_t entities)
+{
+	Scene scene;
+	const float extent = CreateScene(scene, entities, config.seed);
+	const float dt = 1.0f / 60.0f;
+	scene.Update(dt);
+
+	Measure("scene.update", entities, entities, [&] {
+		scene.Update(dt);
+	});
+
+	// The individual systems, after a full update has allocated the scene resources:
+	using System = void(Scene::*)(wi::jobsystem::context&);
+	const std::pair<const char*, System> systems[] = {
+		{ "scene.update.transform", &Scene::RunTransformUpdateSystem },
+		{ "scene.update.hierarchy", &Scene::RunHierarchyUpdateSystem },
+		{ "scene.update.mesh", &Scene::RunMeshUpdateSystem },
+		{ "scene.update.object", &Scene::RunObjectUpdateSystem },
+		{ "scene.update.camera", &Scene::RunCameraUpdateSystem },
+		{ "scene.update.light", &Scene::RunLightUpdateSystem },
+	};
+	for (auto& system : systems)
+	{
+		Measure(system.first, entities, entities, [&] {
+			wi::jobsystem::context ctx;
+			(scene.*system.second)(ctx);
+			wi::jobsystem::Wait(ctx);
+		});
+	}
+
+	wi::renderer::Visibility vis;
+	vis.scene = &scene;
+	vis.camera = &scene.cameras[0];
+	vis.flags = wi::renderer::Visibility::ALLOW_EVERYTHING;
+	if (Result* result = Measure("renderer.update_visibility", entities, entities, [&] {
+		wi::renderer::UpdateVisibility(vis);
+	}))
+	{
+		result->metrics.push_back({ "visible_objects", double(vis.visibleObjects.size()) });
+		result->metrics.push_back({ "visible_lights", double(vis.visibleLights.size()) });
+	}
+
+	// Random queries are generated once, so that every iteration does the same work:
+	const uint32_t query_count = 1000;
+	std::mt19937 rng(config.seed);
+	std::uniform_real_distribution<float> unorm(0.0f, 1.0f);
+	auto random_position = [&] {
+		return XMFLOAT3((unorm(rng) * 2 - 1) * extent, (unorm(rng) * 2 - 1) * extent, (unorm(rng) * 2 - 1) * extent);
+	};
+	wi::vector<wi::primitive::Ray> rays(query_count);
+	wi::vector<wi::primitive::Sphere> spheres(query_count);
+	wi::vector<wi::primitive::Capsule> capsules(query_count);
+	for (uint32_t i = 0; i < query_count; ++i)
+	{
+		const XMFLOAT3 origin = random_position();
+		const XMFLOAT3 target = random_position();
+		rays[i] = wi::primitive::Ray(XMLoadFloat3(&origin), XMVector3Normalize(XMLoadFloat3(&target) - XMLoadFloat3(&origin)));
+		spheres[i] = wi::primitive::Sphere(origin, 2);
+		capsules[i] = wi::primitive::Capsule(origin, XMFLOAT3(origin.x, origin.y + 4, origin.z), 1);
+	}
+
+	uint32_t hits = 0;
+	if (Result* result = Measure("scene.pick", entities, query_count, [&] {
+		hits = 0;
+		for (auto& ray : rays)
+		{
+			hits += wi::scene::Pick(ray, ~0u, ~0u, scene).entity != INVALID_ENTITY;
+		}
+	}))
+	{
+		result->metrics.push_back({ "hits", double(hits) });
+	}
+	if (Result* result = Measure("scene.intersect_sphere", entities, query_count, [&] {
+		hits = 0;
+		for (auto& sphere : spheres)
+		{
+			hits += wi::scene::SceneIntersectSphere(sphere, ~0u, ~0u, scene).entity != INVALID_ENTITY;
+		}
+	}))
+	{
+		result->metrics.push_back({ "hits", double(hits) });
+	}
+	if (Result* result = Measure("scene.intersect_capsule", entities, query_count, [&] {
+		hits = 0;
+		for (auto& capsule : capsules)
+		{
+			hits += wi::scene::SceneIntersectCapsule(capsule, ~0u, ~0u, scene).entity != INVALID_ENTITY;
+		}
+	}))
+	{
+		result->metrics.push_back({ "hits", double(hits) });
+	}
+
+	// The archive memory is reused, like when a scene is saved repeatedly:
+	wi::Archive archive;
+	if (Result* result = Measure("archive.serialize", entities, entities, [&] {
+		scene.Serialize(archive);
+	}, [&] {
+		archive.SetReadModeAndResetPos(false);
+	}))
+	{
+		result->metrics.push_back({ "bytes", double(archive.GetPos()) });
+	}
+	else
+	{
+		scene.Serialize(archive);
+	}
+
+	std::unique_ptr<Scene> loaded;
+	Measure("archive.deserialize", entities, entities, [&] {
+		wi::Archive read(archive.GetData());
+		loaded->Serialize(read);
+	}, [&] {
+		loaded = std::make_unique<Scene>();
+	});
+}
+
+static std::string ToJSON()
+{
+	auto number = [](double value) {
+		char text[32];
+		std::snprintf(text, sizeof(text), "%.6f", value);
+		return std::string(text);
+	};
+
+	std::string json = "{\n";
+	json += "\t\"engine_version\": \"" + std::string(wi::version::GetVersionString()) + "\",\n";
+	json += "\t\"thread_count\": " + std::to_string(wi::jobsystem::GetThreadCount()) + ",\n";
+	json += "\t\"iterations\": " + std::to_string(config.iterations) + ",\n";
+	json += "\t\"seed\": " + std::to_string(config.seed) + ",\n";
+	json += "\t\"results\": [";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& result = results[i];
+		wi::vector<double> sorted = result.samples;
+		std::sort(sorted.begin(), sorted.end());
+		double mean = 0;
+		for (double x : sorted)
+		{
+			mean += x;
+		}
+		mean /= double(sorted.size());
+		const double median = sorted[sorted.size() / 2];
+
+		json += i > 0 ? ",\n" : "\n";
+		json += "\t\t{ \"name\": \"" + result.name + "\"";
+		json += ", \"entities\": " + std::to_string(result.entities);
+		json += ", \"items\": " + std::to_string(result.items);
+		json += ", \"min_ms\": " + number(sorted.front());
+		json += ", \"median_ms\": " + number(median);
+		json += ", \"mean_ms\": " + number(mean);
+		json += ", \"max_ms\": " + number(sorted.back());
+		json += ", \"ns_per_item\": " + number(result.items > 0 ? median * 1000000.0 / double(result.items) : 0);
+		for (auto& metric : result.metrics)
+		{
+			json += ", \"" + metric.first + "\": " + number(metric.second);
+		}
+		json += " }";
+	}
+	json += "\n\t]\n}\n";
+	return json;
+}
+
+int main(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const size_t separator = arg.find('=');
+		const std::string key = arg.substr(0, separator);
+		const std::string value = separator == std::string::npos ? "" : arg.substr(separator + 1);
+		if (key == "entities")
+		{
+			config.entity_counts.clear();
+			size_t start = 0;
+			while (start < value.size())
+			{
+				size_t end = value.find(',', start);
+				if (end == std::string::npos)
+				{
+					end = value.size();
+				}
+				config.entity_counts.push_back((uint32_t)std::stoul(value.substr(start, end - start)));
+				start = end + 1;
+			}
+		}
+		else if (key == "iterations")
+		{
+			config.iterations = std::max(1u, (uint32_t)std::stoul(value));
+		}
+		else if (key == "seed")
+		{
+			config.seed = (uint32_t)std::stoul(value);
+		}
+		else if (key == "filter")
+		{
+			config.filter = value;
+		}
+		else if (key == "output")
+		{
+			config.output = value;
+		}
+		else if (key == "trace")
+		{
+			config.trace = value;
+		}
+		else
+		{
+			std::printf("Unknown argument: %s\n", arg.c_str());
+			return 1;
+		}
+	}
+
+	// The engine log is only printed for errors, to keep the benchmark output readable:
+	wi::backlog::SetLogLevel(wi::backlog::LogLevel::Error);
+
+	wi::jobsystem::Initialize();
+	auto device = std::make_unique<wi::graphics::GraphicsDevice_Null>();
+	wi::graphics::GetDevice() = device.get();
+
+	if (!config.trace.empty())
+	{
+		wi::trace::SetThreadName("Main thread");
+		wi::trace::SetEnabled(true);
+	}
+
+	for (uint32_t entities : config.entity_counts)
+	{
+		entities = std::max(8u, entities);
+		BenchmarkJobSystem(entities);
+		BenchmarkComponentManager(entities);
+		BenchmarkScene(entities);
+	}
+
+	if (!config.trace.empty())
+	{
+		wi::trace::SetEnabled(false);
+		wi::trace::Export(config.trace);
+	}
+
+	const std::string json = ToJSON();
+	if (!wi::helper::FileWrite(config.output, (const uint8_t*)json.data(), json.size()))
+	{
+		std::printf("Failed to write %s\n", config.output.c_str());
+		return 1;
+	}
+	std::printf("Results written to %s\n", config.output.c_str());
+
+	wi::graphics::GetDevice() = nullptr;
+	return 0;
+}
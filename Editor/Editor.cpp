@@ -2648,10 +2648,13 @@ void EditorComponent::ConsumeHistoryOperation(bool undo)
 void EditorComponent::Save(const std::string& filename)
 {
 	const bool dump_to_header = optionsWnd.saveModeComboBox.GetSelected() == 2;
+	const bool compressed = optionsWnd.saveModeComboBox.GetSelected() == 3;
 
 	wi::Archive archive = dump_to_header ? wi::Archive() : wi::Archive(filename, false);
 	if (archive.IsOpen())
 	{
+		archive.SetCompressionEnabled(compressed);
+
 		Scene& scene = GetCurrentScene();
 
 		wi::resourcemanager::Mode embed_mode = (wi::resourcemanager::Mode)optionsWnd.saveModeComboBox.GetItemUserData(optionsWnd.saveModeComboBox.GetSelected());
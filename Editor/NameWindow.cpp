@@ -42,7 +42,7 @@ void NameWindow::Create(EditorComponent* _editor)
 		{
 			name = &editor->GetCurrentScene().names.Create(entity);
 		}
-		name->name = args.sValue;
+		*name = args.sValue;
 
 		editor->optionsWnd.RefreshEntityTree();
 	});
@@ -684,7 +684,7 @@ void Example_ImGuiRenderer::Update(float dt)
 			{
 				Entity e = scene.objects.GetEntity(i);
 				NameComponent& name = *scene.names.GetComponent(e);
-				if (name.name.empty()) name.name = std::to_string(e);
+				if (name.name.empty()) name = std::to_string(e);
 
 				bool is_selected = false;
 				if (highlight_entity == e) is_selected = true;;
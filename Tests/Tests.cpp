@@ -6,6 +6,8 @@
 #include <thread>
 #include <unordered_map>
 #include <vector>
+#include <random>
+#include <algorithm>
 
 using namespace wi::ecs;
 using namespace wi::scene;
@@ -32,6 +34,8 @@ enum TEST_TYPE
 	INVERSEKINEMATICSTEST,
 	INSTANCESTEST,
 	CONTAINERPERF,
+	COMPONENTMANAGERPERF,
+	RENDERQUEUESORTPERF,
 };
 
 // Controller Test UI Data, info down below will be using Xbox Controller as reference
@@ -163,6 +167,8 @@ void TestsRenderer::Load()
 	testSelector.AddItem("Inverse Kinematics", INVERSEKINEMATICSTEST);
 	testSelector.AddItem("65k Instances", INSTANCESTEST);
 	testSelector.AddItem("Container perf", CONTAINERPERF);
+	testSelector.AddItem("ComponentManager perf", COMPONENTMANAGERPERF);
+	testSelector.AddItem("RenderQueue sort perf", RENDERQUEUESORTPERF);
 	testSelector.SetMaxVisibleItemCount(10);
 	testSelector.OnSelect([=](wi::gui::EventArgs args) {
 
@@ -419,6 +425,14 @@ void TestsRenderer::Load()
 			ContainerTest();
 			break;
 
+		case COMPONENTMANAGERPERF:
+			ComponentManagerTest();
+			break;
+
+		case RENDERQUEUESORTPERF:
+			RenderQueueSortTest();
+			break;
+
 		default:
 			assert(0);
 			break;
@@ -1247,6 +1261,7 @@ void TestsRenderer::ContainerTest()
 #else
 	ss += "wi::vector implementation uses std::vector. There is nothing to test.";
 #endif // WI_VECTOR_TYPE
+#undef shuffle
 
 	static wi::SpriteFont font;
 	font = wi::SpriteFont(ss);
@@ -1257,3 +1272,159 @@ void TestsRenderer::ContainerTest()
 	font.params.size = 24;
 	this->AddFont(&font);
 }
+void TestsRenderer::ComponentManagerTest()
+{
+	wi::Timer timer;
+
+	const size_t elements = 1000000;
+
+	std::string ss = "ComponentManager test for " + std::to_string(elements) + " components:\n";
+
+	// Entities are created in order, but queried in a random order, like the systems do when they look up other components:
+	wi::vector<Entity> entity_array(elements);
+	for (size_t i = 0; i < elements; ++i)
+	{
+		entity_array[i] = CreateEntity();
+	}
+	wi::vector<Entity> query_array = entity_array;
+	std::shuffle(query_array.begin(), query_array.end(), std::mt19937(0));
+
+	ComponentManager<TransformComponent, HashEntityLookup> hash_manager;
+	{
+		timer.record();
+		for (Entity entity : entity_array)
+		{
+			hash_manager.Create(entity);
+		}
+		ss += "\nHashEntityLookup create: " + std::to_string(timer.elapsed_milliseconds()) + " ms\n";
+
+		timer.record();
+		size_t found = 0;
+		for (Entity entity : query_array)
+		{
+			if (hash_manager.GetComponent(entity) != nullptr)
+			{
+				found++;
+			}
+		}
+		ss += "HashEntityLookup lookup: " + std::to_string(timer.elapsed_milliseconds()) + " ms (" + std::to_string(found) + " found)\n";
+
+		timer.record();
+		for (size_t i = 0; i < hash_manager.GetCount(); ++i)
+		{
+			hash_manager[i].translation_local.x = float(hash_manager.GetEntity(i));
+		}
+		ss += "HashEntityLookup iteration: " + std::to_string(timer.elapsed_milliseconds()) + " ms\n";
+
+		timer.record();
+		for (size_t i = 0; i < query_array.size(); i += 2)
+		{
+			hash_manager.Remove(query_array[i]);
+		}
+		ss += "HashEntityLookup remove: " + std::to_string(timer.elapsed_milliseconds()) + " ms\n";
+	}
+
+	ComponentManager<TransformComponent, SparseEntityLookup> sparse_manager;
+	{
+		timer.record();
+		for (Entity entity : entity_array)
+		{
+			sparse_manager.Create(entity);
+		}
+		ss += "\nSparseEntityLookup create: " + std::to_string(timer.elapsed_milliseconds()) + " ms\n";
+
+		timer.record();
+		size_t found = 0;
+		for (Entity entity : query_array)
+		{
+			if (sparse_manager.GetComponent(entity) != nullptr)
+			{
+				found++;
+			}
+		}
+		ss += "SparseEntityLookup lookup: " + std::to_string(timer.elapsed_milliseconds()) + " ms (" + std::to_string(found) + " found)\n";
+
+		timer.record();
+		for (size_t i = 0; i < sparse_manager.GetCount(); ++i)
+		{
+			sparse_manager[i].translation_local.x = float(sparse_manager.GetEntity(i));
+		}
+		ss += "SparseEntityLookup iteration: " + std::to_string(timer.elapsed_milliseconds()) + " ms\n";
+
+		timer.record();
+		for (size_t i = 0; i < query_array.size(); i += 2)
+		{
+			sparse_manager.Remove(query_array[i]);
+		}
+		ss += "SparseEntityLookup remove: " + std::to_string(timer.elapsed_milliseconds()) + " ms\n";
+	}
+
+	static wi::SpriteFont font;
+	font = wi::SpriteFont(ss);
+	font.params.posX = GetLogicalWidth() / 2;
+	font.params.posY = GetLogicalHeight() / 2;
+	font.params.h_align = wi::font::WIFALIGN_CENTER;
+	font.params.v_align = wi::font::WIFALIGN_CENTER;
+	font.params.size = 24;
+	this->AddFont(&font);
+}
+void TestsRenderer::RenderQueueSortTest()
+{
+	std::string ss = "RenderQueue sort test:\n";
+
+	std::mt19937 rng(0);
+	for (uint32_t count : { 1000u, 10000u, 50000u, 200000u })
+	{
+		// Random meshes and distances, in the visibility order that is not sorted:
+		wi::vector<wi::renderer::RenderBatch> batches(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			batches[i].Create(rng() % 1000, i, float(rng() % 100000) * 0.01f);
+		}
+		std::shuffle(batches.begin(), batches.end(), rng);
+
+		ss += "\n" + std::to_string(count) + " batches:\n";
+		for (bool transparent : { false, true })
+		{
+			wi::Timer timer;
+			wi::vector<wi::renderer::RenderBatch> reference = batches;
+			timer.record();
+			if (transparent)
+			{
+				std::sort(reference.begin(), reference.end(), std::greater<wi::renderer::RenderBatch>());
+			}
+			else
+			{
+				std::sort(reference.begin(), reference.end(), std::less<wi::renderer::RenderBatch>());
+			}
+			const double time_std = timer.elapsed_milliseconds();
+
+			wi::vector<wi::renderer::RenderBatch> serial = batches;
+			timer.record();
+			wi::renderer::SortRenderBatches(serial.data(), serial.size(), transparent, false);
+			const double time_serial = timer.elapsed_milliseconds();
+
+			wi::vector<wi::renderer::RenderBatch> parallel = batches;
+			timer.record();
+			wi::renderer::SortRenderBatches(parallel.data(), parallel.size(), transparent, true);
+			const double time_parallel = timer.elapsed_milliseconds();
+
+			bool match = true;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				match &= reference[i].data == serial[i].data && reference[i].data == parallel[i].data;
+			}
+
+			ss += std::string(transparent ? "transparent" : "opaque") + " std::sort: " + std::to_string(time_std) + " ms, radix: " + std::to_string(time_serial) + " ms, parallel radix: " + std::to_string(time_parallel) + " ms" + (match ? "" : " (MISMATCH)") + "\n";
+		}
+	}
+
+	static wi::SpriteFont font;
+	font = wi::SpriteFont(ss);
+	font.params.posX = GetLogicalWidth() / 2;
+	font.params.posY = GetLogicalHeight() / 2;
+	font.params.h_align = wi::font::WIFALIGN_CENTER;
+	font.params.v_align = wi::font::WIFALIGN_CENTER;
+	font.params.size = 20;
+	this->AddFont(&font);
+}
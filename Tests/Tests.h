@@ -17,6 +17,8 @@ public:
 	void RunSpriteTest();
 	void RunNetworkTest();
 	void ContainerTest();
+	void ComponentManagerTest();
+	void RenderQueueSortTest();
 };
 
 class Tests : public wi::Application
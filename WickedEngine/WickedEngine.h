@@ -52,6 +52,8 @@
 #include "wiGraphicsDevice.h"
 #include "wiGUI.h"
 #include "wiArchive.h"
+#include "wiAllocator.h"
+#include "wiTrace.h"
 #include "wiSpinLock.h"
 #include "wiRectPacker.h"
 #include "wiProfiler.h"
@@ -59,6 +61,7 @@
 #include "wiFFTGenerator.h"
 #include "wiArguments.h"
 #include "wiGPUBVH.h"
+#include "wiBVH.h"
 #include "wiGPUSortLib.h"
 #include "wiJobSystem.h"
 #include "wiNetwork.h"
@@ -0,0 +1,137 @@
+#include "wiAllocator.h"
+
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <cassert>
+
+namespace wi::allocator
+{
+	void* LinearAllocator::allocate(size_t size, size_t alignment)
+	{
+		while (current_block < blocks.size())
+		{
+			Block& block = blocks[current_block];
+			const uintptr_t address = (uintptr_t)block.data.get() + offset;
+			const size_t padding = (alignment - address % alignment) % alignment;
+			if (offset + padding + size <= block.size)
+			{
+				offset += padding + size;
+				used += padding + size;
+				return (void*)(address + padding);
+			}
+			if (current_block + 1 == blocks.size())
+				break;
+			current_block++;
+			offset = 0;
+		}
+
+		// Out of blocks, the new block is at least twice as large as the previous one:
+		Block& block = blocks.emplace_back();
+		block.size = std::max(size + alignment, std::max(default_block_size, capacity));
+		block.data = std::make_unique<uint8_t[]>(block.size);
+		capacity += block.size;
+		current_block = blocks.size() - 1;
+		offset = 0;
+		return allocate(size, alignment);
+	}
+	void LinearAllocator::deallocate(void* ptr, size_t size)
+	{
+		if (ptr == nullptr || current_block >= blocks.size())
+			return;
+		const uint8_t* top = blocks[current_block].data.get() + offset;
+		if ((const uint8_t*)ptr + size == top)
+		{
+			offset -= size;
+			used -= size;
+		}
+	}
+	void LinearAllocator::reset()
+	{
+		if (blocks.size() > 1)
+		{
+			// Merge all blocks into one, so the next frame with the same usage fits without allocating:
+			blocks.clear();
+			Block& block = blocks.emplace_back();
+			block.size = capacity;
+			block.data = std::make_unique<uint8_t[]>(block.size);
+		}
+		current_block = 0;
+		offset = 0;
+		used = 0;
+	}
+
+	namespace frame_internal
+	{
+		struct ThreadAllocator;
+		std::mutex locker;
+		wi::vector<ThreadAllocator*> allocators;
+		FrameAllocatorStatistics statistics;
+
+		// The allocator of a thread is registered, so that it can be reset from the main thread
+		struct ThreadAllocator
+		{
+			LinearAllocator allocator;
+			std::atomic<uint32_t> live_allocations{ 0 }; // only modified by the owner thread, checked when the allocators are reset
+
+			ThreadAllocator()
+			{
+				std::scoped_lock lck(locker);
+				allocators.push_back(this);
+			}
+			~ThreadAllocator()
+			{
+				std::scoped_lock lck(locker);
+				for (auto& x : allocators)
+				{
+					if (x == this)
+					{
+						x = allocators.back();
+						allocators.pop_back();
+						break;
+					}
+				}
+			}
+		};
+		thread_local ThreadAllocator thread_allocator;
+	}
+
+	void* AllocateFrame(size_t size, size_t alignment)
+	{
+		frame_internal::ThreadAllocator& thread_allocator = frame_internal::thread_allocator;
+		thread_allocator.live_allocations.fetch_add(1, std::memory_order_relaxed);
+		return thread_allocator.allocator.allocate(size, alignment);
+	}
+
+	void DeallocateFrame(void* ptr, size_t size)
+	{
+		if (ptr == nullptr)
+			return;
+		frame_internal::ThreadAllocator& thread_allocator = frame_internal::thread_allocator;
+		assert(thread_allocator.live_allocations.load(std::memory_order_relaxed) > 0); // not allocated by this thread in this frame
+		thread_allocator.live_allocations.fetch_sub(1, std::memory_order_release);
+		thread_allocator.allocator.deallocate(ptr, size);
+	}
+
+	void ResetFrameAllocators()
+	{
+		std::scoped_lock lck(frame_internal::locker);
+		FrameAllocatorStatistics statistics;
+		for (auto& x : frame_internal::allocators)
+		{
+			// The memory must not be in use anymore, otherwise a job or container outlived the frame and it would be overwritten next frame:
+			assert(x->live_allocations.load(std::memory_order_acquire) == 0);
+			statistics.used += x->allocator.get_used();
+			x->allocator.reset();
+			statistics.capacity += x->allocator.get_capacity();
+			statistics.thread_count++;
+		}
+		frame_internal::statistics = statistics;
+	}
+
+	FrameAllocatorStatistics GetFrameAllocatorStatistics()
+	{
+		std::scoped_lock lck(frame_internal::locker);
+		return frame_internal::statistics;
+	}
+}
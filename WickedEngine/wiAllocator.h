@@ -0,0 +1,89 @@
+#pragma once
+#include "wiVector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace wi::allocator
+{
+	// Linear (bump pointer) allocator, memory is only freed all at once by reset()
+	//	When more than one block was required before the reset, the blocks are merged into one, so that the same usage won't need to allocate again
+	class LinearAllocator
+	{
+	public:
+		static constexpr size_t default_block_size = 64 * 1024;
+
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		// Only the last allocation can be freed, others will be freed when the allocator is reset
+		void deallocate(void* ptr, size_t size);
+
+		void reset();
+
+		inline size_t get_used() const { return used; }
+		inline size_t get_capacity() const { return capacity; }
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<uint8_t[]> data;
+			size_t size = 0;
+		};
+		wi::vector<Block> blocks;
+		size_t current_block = 0;
+		size_t offset = 0; // in current_block
+		size_t used = 0;
+		size_t capacity = 0;
+	};
+
+	// Allocate memory that is valid until the end of the frame from the frame allocator of the current thread
+	//	Every allocation must be freed with DeallocateFrame() before the frame ends
+	void* AllocateFrame(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	// Free memory that was allocated with AllocateFrame(). Only the last allocation of the current thread can be reused, others are reused after the frame ended
+	void DeallocateFrame(void* ptr, size_t size);
+
+	// Reset the frame allocators of every thread, all memory allocated with AllocateFrame() will be invalid
+	//	wi::Application calls this at the end of every frame, when the jobs of the frame finished
+	//	It asserts that no frame allocation is still in use, for example by a job or a container that outlived the frame
+	void ResetFrameAllocators();
+
+	struct FrameAllocatorStatistics
+	{
+		size_t used = 0; // bytes allocated by every thread in the last frame
+		size_t capacity = 0; // bytes reserved by the frame allocators of every thread
+		uint32_t thread_count = 0; // number of threads that used a frame allocator
+	};
+	FrameAllocatorStatistics GetFrameAllocatorStatistics();
+
+	// Standard allocator interface over the frame allocator of the current thread
+	//	Containers using this must not be kept after the frame ended
+	template<typename T>
+	struct FrameAllocator
+	{
+		using value_type = T;
+
+		FrameAllocator() = default;
+		template<typename U>
+		FrameAllocator(const FrameAllocator<U>&) {}
+
+		inline T* allocate(size_t count)
+		{
+			return (T*)AllocateFrame(sizeof(T) * count, alignof(T));
+		}
+		inline void deallocate(T* ptr, size_t count)
+		{
+			DeallocateFrame(ptr, sizeof(T) * count);
+		}
+
+		template<typename U>
+		constexpr bool operator==(const FrameAllocator<U>&) const { return true; }
+		template<typename U>
+		constexpr bool operator!=(const FrameAllocator<U>&) const { return false; }
+	};
+
+	// Vector that allocates from the frame allocator of the current thread, it must not be kept after the frame ended
+	template<typename T>
+	using frame_vector = wi::vector<T, FrameAllocator<T>>;
+}
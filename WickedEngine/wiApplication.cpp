@@ -15,9 +15,13 @@
 #include "wiFont.h"
 #include "wiImage.h"
 #include "wiEventHandler.h"
+#include "wiAllocator.h"
+#include "wiTrace.h"
+#include "wiResourceManager.h"
 
 #include "wiGraphicsDevice_DX12.h"
 #include "wiGraphicsDevice_Vulkan.h"
+#include "wiGraphicsDevice_Null.h"
 
 #include <string>
 #include <algorithm>
@@ -41,6 +45,13 @@ namespace wi
 		}
 		initialized = true;
 
+		wi::trace::SetThreadName("Main thread");
+		if (wi::arguments::HasArgument("trace"))
+		{
+			// Trace the first frames, including initialization:
+			wi::trace::CaptureFrames(300, "trace.json");
+		}
+
 		wi::initializer::InitializeComponentsAsync();
 	}
 
@@ -222,6 +233,14 @@ namespace wi
 		wi::input::ClearForNextFrame();
 		wi::profiler::EndFrame(cmd);
 		graphicsDevice->SubmitCommandLists();
+
+		// Every temporary allocation of the frame is released at once:
+		wi::allocator::ResetFrameAllocators();
+
+		// Cached resources that expired or exceed the memory budgets are freed:
+		wi::resourcemanager::UpdateCache();
+
+		wi::trace::EndFrame();
 	}
 
 	void Application::Update(float dt)
@@ -473,6 +492,7 @@ namespace wi
 
 			bool use_dx12 = wi::arguments::HasArgument("dx12");
 			bool use_vulkan = wi::arguments::HasArgument("vulkan");
+			bool use_null = wi::arguments::HasArgument("nulldevice");
 
 #ifndef WICKEDENGINE_BUILD_DX12
 			if (use_dx12) {
@@ -487,7 +507,14 @@ namespace wi
 			}
 #endif
 
-			if (!use_dx12 && !use_vulkan)
+			if (use_null)
+			{
+				// No GPU work is executed, only the CPU side of the engine is running:
+				use_dx12 = false;
+				use_vulkan = false;
+				graphicsDevice = std::make_unique<GraphicsDevice_Null>();
+			}
+			else if (!use_dx12 && !use_vulkan)
 			{
 #if defined(WICKEDENGINE_BUILD_DX12)
 				use_dx12 = true;
@@ -498,7 +525,7 @@ namespace wi
 				assert(false);
 #endif
 			}
-			assert(use_dx12 || use_vulkan);
+			assert(use_dx12 || use_vulkan || use_null);
 
 			if (use_vulkan)
 			{
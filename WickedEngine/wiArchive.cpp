@@ -1,16 +1,41 @@
 #include "wiArchive.h"
 #include "wiHelper.h"
+#include "wiJobSystem.h"
+#include "wiBacklog.h"
+#include "wiTimer.h"
+
+#include "Utility/basis_universal/zstd/zstd.h"
+
+#include <atomic>
+#include <cmath>
 
 namespace wi
 {
 
 	// this should always be only INCREMENTED and only if a new serialization is implemeted somewhere!
-	static constexpr uint64_t __archiveVersion = 83;
+	static constexpr uint64_t __archiveVersion = 86;
 	// this is the version number of which below the archive is not compatible with the current version
 	static constexpr uint64_t __archiveVersionBarrier = 22;
+	// starting from this version, the version number is followed by the header flags
+	static constexpr uint64_t __archiveVersionHeaderFlags = 85;
 
 	// version history is logged in ArchiveVersionHistory.txt file!
 
+	enum ARCHIVE_FLAGS : uint64_t
+	{
+		ARCHIVE_FLAG_NONE = 0,
+		// The data after the header is stored in independently compressed blocks:
+		//	uint64_t uncompressed size
+		//	uint64_t block size (uncompressed)
+		//	uint64_t block count
+		//	uint64_t block offsets [block count + 1], relative to the start of the first block
+		//	compressed blocks. A block that couldn't be compressed is stored as is, with its uncompressed size
+		ARCHIVE_FLAG_COMPRESSED = 1 << 0,
+	};
+	static constexpr size_t archive_header_size = sizeof(uint64_t) * 2; // version, flags
+	static constexpr uint64_t archive_compression_block_size = 1024 * 1024;
+	static constexpr int archive_compression_level = 1; // fastest compression, the decompression speed is similar at every level
+
 	Archive::Archive()
 	{
 		CreateEmpty();
@@ -22,10 +47,22 @@ namespace wi
 			directory = wi::helper::GetDirectoryFromPath(fileName);
 			if (readMode)
 			{
-				if (wi::helper::FileRead(fileName, DATA))
+				// The file is memory mapped if possible, so that it doesn't need to be copied:
+				wi::helper::MappedFile file;
+				if (wi::helper::FileMap(fileName, file))
+				{
+					mapped_file = file.handle;
+					data_ptr = file.data;
+					data_size = file.size;
+				}
+				else if (wi::helper::FileRead(fileName, DATA))
 				{
 					data_ptr = DATA.data();
-					(*this) >> version;
+					data_size = DATA.size();
+				}
+				if (data_ptr != nullptr)
+				{
+					SetReadModeAndResetPos(true);
 					if (version < __archiveVersionBarrier)
 					{
 						wi::helper::messageBox("The archive version (" + std::to_string(version) + ") is no longer supported!", "Error!");
@@ -45,9 +82,11 @@ namespace wi
 		}
 	}
 
-	Archive::Archive(const uint8_t* data)
+	Archive::Archive(const uint8_t* data, size_t size)
 	{
 		data_ptr = data;
+		data_size = size;
+		readMode = true;
 		SetReadModeAndResetPos(true);
 	}
 
@@ -61,16 +100,182 @@ namespace wi
 
 	void Archive::SetReadModeAndResetPos(bool isReadMode)
 	{
+		if (isReadMode && !readMode)
+		{
+			data_size = pos; // the data that was written can be read back
+		}
 		readMode = isReadMode;
 		pos = 0;
 
+		if (!readMode && DATA.empty())
+		{
+			// A memory mapped archive can't be written, so writing continues in a new memory block:
+			DATA.resize(128);
+			data_ptr = DATA.data();
+			data_size = ~size_t(0);
+			mapped_file.reset();
+		}
+
 		if (readMode)
 		{
 			(*this) >> version;
+			if (version >= __archiveVersionHeaderFlags && version <= __archiveVersion)
+			{
+				uint64_t flags = ARCHIVE_FLAG_NONE;
+				(*this) >> flags;
+				if (flags & ARCHIVE_FLAG_COMPRESSED)
+				{
+					compressed = true;
+					Decompress();
+				}
+			}
 		}
 		else
 		{
 			(*this) << version;
+			if (version >= __archiveVersionHeaderFlags)
+			{
+				// The data in memory is never compressed, compression is only applied when saving:
+				(*this) << uint64_t(ARCHIVE_FLAG_NONE);
+			}
+		}
+	}
+
+	void Archive::Decompress()
+	{
+		wi::Timer timer;
+
+		// The container is validated before anything is read from it, a corrupted file must not read out of bounds:
+		uint64_t uncompressed_size = 0;
+		uint64_t block_size = 0;
+		uint64_t block_count = 0;
+		const uint64_t* block_offsets = nullptr;
+		const uint8_t* blocks = nullptr;
+		bool valid = data_size >= pos && data_size - pos >= sizeof(uint64_t) * 3;
+		if (valid)
+		{
+			(*this) >> uncompressed_size;
+			(*this) >> block_size;
+			(*this) >> block_count;
+			valid = block_size == archive_compression_block_size;
+		}
+		if (valid)
+		{
+			const uint64_t expected_block_count = uncompressed_size / block_size + (uncompressed_size % block_size != 0 ? 1 : 0);
+			const uint64_t max_offset_count = (data_size - pos) / sizeof(uint64_t); // the offset table must fit
+			valid = block_count == expected_block_count && block_count < max_offset_count && block_count < UINT32_MAX;
+		}
+		if (valid)
+		{
+			block_offsets = (const uint64_t*)(data_ptr + pos);
+			blocks = data_ptr + pos + (block_count + 1) * sizeof(uint64_t);
+			const uint64_t blocks_size = data_size - pos - (block_count + 1) * sizeof(uint64_t);
+			valid = block_offsets[0] == 0 && block_offsets[block_count] <= blocks_size;
+			for (uint64_t i = 0; i < block_count && valid; ++i)
+			{
+				valid = block_offsets[i] <= block_offsets[i + 1];
+			}
+		}
+
+		// The decompressed data is laid out like an archive that was never compressed:
+		wi::vector<uint8_t> decompressed;
+		std::atomic_bool success{ valid };
+		if (valid)
+		{
+			decompressed.resize(archive_header_size + uncompressed_size);
+			std::memcpy(decompressed.data(), &version, sizeof(version));
+			std::memset(decompressed.data() + sizeof(version), 0, sizeof(uint64_t));
+
+			wi::jobsystem::context ctx;
+			wi::jobsystem::Dispatch(ctx, (uint32_t)block_count, 1, [&](wi::jobsystem::JobArgs args) {
+				const uint64_t offset = args.jobIndex * block_size;
+				const size_t size = (size_t)std::min(block_size, uncompressed_size - offset);
+				const size_t compressed_size = size_t(block_offsets[args.jobIndex + 1] - block_offsets[args.jobIndex]);
+				const uint8_t* src = blocks + block_offsets[args.jobIndex];
+				uint8_t* dst = decompressed.data() + archive_header_size + offset;
+				if (compressed_size == size)
+				{
+					std::memcpy(dst, src, size);
+				}
+				else
+				{
+					const size_t result = ZSTD_decompress(dst, size, src, compressed_size);
+					if (ZSTD_isError(result) || result != size)
+					{
+						success.store(false);
+					}
+				}
+			});
+			wi::jobsystem::Wait(ctx);
+		}
+
+		mapped_file.reset();
+		if (success.load())
+		{
+			DATA = std::move(decompressed);
+			data_ptr = DATA.data();
+			data_size = DATA.size();
+			pos = archive_header_size;
+			wi::backlog::post("wi::Archive decompressed " + std::to_string(uncompressed_size) + " bytes from " + std::to_string(block_count) + " blocks (" + std::to_string((int)std::round(timer.elapsed())) + " ms)");
+		}
+		else
+		{
+			wi::backlog::post("wi::Archive decompression failed: " + fileName, wi::backlog::LogLevel::Error);
+			DATA.clear();
+			data_ptr = nullptr;
+			data_size = 0;
+		}
+	}
+
+	void Archive::Compress(wi::vector<uint8_t>& dst) const
+	{
+		const uint64_t uncompressed_size = pos - archive_header_size;
+		const uint64_t block_count = (uncompressed_size + archive_compression_block_size - 1) / archive_compression_block_size;
+
+		// Every block is compressed into its own worst case sized memory first, then they are concatenated:
+		const size_t block_capacity = ZSTD_compressBound((size_t)archive_compression_block_size);
+		wi::vector<uint8_t> temp(block_count * block_capacity);
+		wi::vector<uint64_t> block_offsets(block_count + 1);
+
+		wi::jobsystem::context ctx;
+		wi::jobsystem::Dispatch(ctx, (uint32_t)block_count, 1, [&](wi::jobsystem::JobArgs args) {
+			const uint64_t offset = args.jobIndex * archive_compression_block_size;
+			const size_t size = (size_t)std::min(archive_compression_block_size, uncompressed_size - offset);
+			const uint8_t* src = data_ptr + archive_header_size + offset;
+			uint8_t* block = temp.data() + args.jobIndex * block_capacity;
+			size_t compressed_size = ZSTD_compress(block, block_capacity, src, size, archive_compression_level);
+			if (ZSTD_isError(compressed_size) || compressed_size >= size)
+			{
+				std::memcpy(block, src, size);
+				compressed_size = size;
+			}
+			block_offsets[args.jobIndex + 1] = compressed_size; // sizes are converted to offsets after all blocks are finished
+		});
+		wi::jobsystem::Wait(ctx);
+
+		for (uint64_t i = 0; i < block_count; ++i)
+		{
+			block_offsets[i + 1] += block_offsets[i];
+		}
+
+		const uint64_t header[] = {
+			version,
+			ARCHIVE_FLAG_COMPRESSED,
+			uncompressed_size,
+			archive_compression_block_size,
+			block_count,
+		};
+		dst.resize(sizeof(header) + block_offsets.size() * sizeof(uint64_t) + block_offsets.back());
+		uint8_t* ptr = dst.data();
+		std::memcpy(ptr, header, sizeof(header));
+		ptr += sizeof(header);
+		std::memcpy(ptr, block_offsets.data(), block_offsets.size() * sizeof(uint64_t));
+		ptr += block_offsets.size() * sizeof(uint64_t);
+		for (uint64_t i = 0; i < block_count; ++i)
+		{
+			const size_t compressed_size = size_t(block_offsets[i + 1] - block_offsets[i]);
+			std::memcpy(ptr, temp.data() + i * block_capacity, compressed_size);
+			ptr += compressed_size;
 		}
 	}
 
@@ -81,18 +286,55 @@ namespace wi
 			SaveFile(fileName);
 		}
 		DATA.clear();
+		if (mapped_file != nullptr)
+		{
+			mapped_file.reset();
+			data_ptr = nullptr;
+		}
 	}
 
 	bool Archive::SaveFile(const std::string& fileName)
 	{
+		if (compressed && version >= __archiveVersionHeaderFlags)
+		{
+			wi::vector<uint8_t> data;
+			Compress(data);
+			return wi::helper::FileWrite(fileName, data.data(), data.size());
+		}
 		return wi::helper::FileWrite(fileName, data_ptr, pos);
 	}
 
 	bool Archive::SaveHeaderFile(const std::string& fileName, const std::string& dataName)
 	{
+		if (compressed && version >= __archiveVersionHeaderFlags)
+		{
+			wi::vector<uint8_t> data;
+			Compress(data);
+			return wi::helper::Bin2H(data.data(), data.size(), fileName, dataName.c_str());
+		}
 		return wi::helper::Bin2H(data_ptr, pos, fileName, dataName.c_str());
 	}
 
+	Archive Archive::CreateSection() const
+	{
+		Archive section;
+		section.directory = directory;
+		return section;
+	}
+
+	void Archive::WriteSection(const Archive& section)
+	{
+		_write_bulk(section.data_ptr, section.pos);
+	}
+
+	Archive Archive::ReadSection(size_t size)
+	{
+		Archive section(data_ptr + pos, std::min(size, GetRemainingSize()));
+		section.directory = directory;
+		pos += size;
+		return section;
+	}
+
 	const std::string& Archive::GetSourceDirectory() const
 	{
 		return directory;
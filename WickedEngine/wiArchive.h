@@ -4,6 +4,9 @@
 #include "wiVector.h"
 
 #include <string>
+#include <memory>
+#include <cstring>
+#include <type_traits>
 
 namespace wi
 {
@@ -19,11 +22,16 @@ namespace wi
 		size_t pos = 0; // position of the next memory operation, relative to the data's beginning
 		wi::vector<uint8_t> DATA; // data suitable for read/write operations
 		const uint8_t* data_ptr = nullptr; // this can either be a memory mapped pointer (read only), or the DATA's pointer
+		size_t data_size = ~size_t(0); // the readable size of the data at data_ptr, if it's known
+		std::shared_ptr<void> mapped_file; // keeps the memory mapped file alive while data_ptr points into it
 
 		std::string fileName; // save to this file on closing if not empty
 		std::string directory; // the directory part from the fileName
+		bool compressed = false; // the saved file will be block compressed
 
 		void CreateEmpty(); // creates new archive in write mode
+		void Decompress(); // replaces the block compressed read only data with its decompressed contents
+		void Compress(wi::vector<uint8_t>& dst) const; // writes the block compressed container of the archive data into dst
 
 	public:
 		// Create empty arhive for writing
@@ -31,11 +39,12 @@ namespace wi
 		Archive(const Archive&) = default;
 		Archive(Archive&&) = default;
 		// Create archive from a file.
-		//	If readMode == true, the whole file will be loaded into the archive in read mode
+		//	If readMode == true, the file will be memory mapped in read mode, or loaded into the archive if it can't be mapped
 		//	If readMode == false, the file will be written when the archive is destroyed or Close() is called
 		Archive(const std::string& fileName, bool readMode = true);
 		// Creates a memory mapped archive in read mode
-		Archive(const uint8_t* data);
+		//	If the size of the data is known, it is used to validate the compressed archive and section headers
+		Archive(const uint8_t* data, size_t size = ~size_t(0));
 		~Archive() { Close(); }
 
 		Archive& operator=(const Archive&) = default;
@@ -44,10 +53,19 @@ namespace wi
 		const uint8_t* GetData() const { return data_ptr; }
 		constexpr uint64_t GetVersion() const { return version; }
 		constexpr bool IsReadMode() const { return readMode; }
+		// Returns the position of the next memory operation. In write mode, this is the size of the written data
+		constexpr size_t GetPos() const { return pos; }
+		// In read mode, returns how many bytes can still be read, or ~0 if the size of the data is unknown
+		size_t GetRemainingSize() const { return data_size == ~size_t(0) ? data_size : (pos < data_size ? data_size - pos : 0); }
 		// This can set the archive into either read or write mode, and it will reset it's position
 		void SetReadModeAndResetPos(bool isReadMode);
 		// Check if the archive has any data
 		bool IsOpen() const { return data_ptr != nullptr; };
+		// Enable compression of the file that is written by SaveFile(), SaveHeaderFile() or closing the archive
+		//	The data is compressed in independent blocks that are decompressed in parallel when the archive is opened
+		//	Archives that were opened from compressed files have this enabled
+		void SetCompressionEnabled(bool value) { compressed = value; }
+		constexpr bool IsCompressionEnabled() const { return compressed; }
 		// Close the archive.
 		//	If it was opened from a file in write mode, the file will be written at this point
 		//	The data will be deleted, the archive will be empty after this
@@ -58,6 +76,17 @@ namespace wi
 		// Write the archive contents into a C++ header file
 		//	dataName : it will be the name of the byte data array in the header, that can be memory mapped
 		bool SaveHeaderFile(const std::string& fileName, const std::string& dataName);
+		// Sections are archives that are embedded in an other archive, so that they can be read independently, for example in parallel
+		//	Create an empty archive in write mode for a section of this archive, it will have the same source directory as this archive
+		Archive CreateSection() const;
+		// Write the whole contents of a section archive into this archive
+		//	Its size (GetPos() of the section) must be serialized separately, before the section, to be able to read it
+		void WriteSection(const Archive& section);
+		// Open the section of the given size that starts at the current position in read mode, and skip over it in this archive
+		//	The returned archive references the data of this archive, so this archive must outlive it
+		Archive ReadSection(size_t size);
+		// Write raw data that was serialized into an other archive of the same version, so it can be read back as if it was serialized into this one
+		void WriteData(const uint8_t* data, size_t size) { _write_bulk(data, size); }
 		// If the archive was opened from a file, this will return the file's directory
 		const std::string& GetSourceDirectory() const;
 		// If the archive was opened from a file, this will return the file's name
@@ -172,20 +201,24 @@ namespace wi
 		inline Archive& operator<<(const std::string& data)
 		{
 			(*this) << data.length();
-			for (const auto& x : data)
-			{
-				(*this) << x;
-			}
+			_write_bulk(data.data(), data.length()); // same as writing chars one by one
 			return *this;
 		}
 		template<typename T>
 		inline Archive& operator<<(const wi::vector<T>& data)
 		{
-			// Here we will use the << operator so that non-specified types will have compile error!
 			(*this) << data.size();
-			for (const T& x : data)
+			if constexpr (is_bulk_type<T>() || is_widened_bulk_type<T>())
 			{
-				(*this) << x;
+				_write_bulk(data.data(), data.size() * sizeof(T));
+			}
+			else
+			{
+				// Here we will use the << operator so that non-specified types will have compile error!
+				for (const T& x : data)
+				{
+					(*this) << x;
+				}
 			}
 			return *this;
 		}
@@ -314,10 +347,7 @@ namespace wi
 			uint64_t len;
 			(*this) >> len;
 			data.resize(len);
-			for (size_t i = 0; i < len; ++i)
-			{
-				(*this) >> data[i];
-			}
+			_read_bulk(data.data(), len); // same as reading chars one by one
 			if (!data.empty() && GetVersion() < 73)
 			{
 				// earlier versions of archive saved the strings with 0 terminator
@@ -332,9 +362,32 @@ namespace wi
 			size_t count;
 			(*this) >> count;
 			data.resize(count);
-			for (size_t i = 0; i < count; ++i)
+			if constexpr (is_bulk_type<T>())
+			{
+				_read_bulk(data.data(), count * sizeof(T));
+			}
+			else if constexpr (is_widened_bulk_type<T>())
+			{
+				if (GetVersion() >= 84)
+				{
+					_read_bulk(data.data(), count * sizeof(T));
+				}
+				else
+				{
+					// earlier versions of archive saved the arrays element by element, widened to 64 bits
+					for (size_t i = 0; i < count; ++i)
+					{
+						(*this) >> data[i];
+					}
+				}
+			}
+			else
 			{
-				(*this) >> data[i];
+				// Here we will use the >> operator so that non-specified types will have compile error!
+				for (size_t i = 0; i < count; ++i)
+				{
+					(*this) >> data[i];
+				}
 			}
 			return *this;
 		}
@@ -372,5 +425,70 @@ namespace wi
 			data = *(const T*)(data_ptr + pos);
 			pos += (size_t)(sizeof(data));
 		}
+
+		// Write a block of memory at once
+		inline void _write_bulk(const void* data, size_t size)
+		{
+			assert(!readMode);
+			assert(!DATA.empty());
+			if (size == 0)
+				return;
+			const size_t _right = pos + size;
+			if (_right > DATA.size())
+			{
+				DATA.resize(_right * 2);
+				data_ptr = DATA.data();
+			}
+			std::memcpy(DATA.data() + pos, data, size);
+			pos = _right;
+		}
+
+		// Read a block of memory at once
+		inline void _read_bulk(void* data, size_t size)
+		{
+			assert(readMode);
+			assert(data_ptr != nullptr);
+			if (size == 0)
+				return;
+			std::memcpy(data, data_ptr + pos, size);
+			pos += size;
+		}
+
+		// Types that are serialized exactly as they are stored in memory, so arrays of them can be copied at once
+		//	long is excluded, because its size is different between platforms
+		template<typename T>
+		static constexpr bool is_bulk_type()
+		{
+			if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, long> || std::is_same_v<T, unsigned long>)
+			{
+				return false;
+			}
+			else if constexpr (std::is_integral_v<T>)
+			{
+				return sizeof(T) == 1 || sizeof(T) == 8;
+			}
+			else
+			{
+				return
+					std::is_same_v<T, float> ||
+					std::is_same_v<T, double> ||
+					std::is_same_v<T, XMFLOAT2> ||
+					std::is_same_v<T, XMFLOAT3> ||
+					std::is_same_v<T, XMFLOAT4> ||
+					std::is_same_v<T, XMFLOAT3X3> ||
+					std::is_same_v<T, XMFLOAT4X3> ||
+					std::is_same_v<T, XMFLOAT4X4> ||
+					std::is_same_v<T, XMUINT2> ||
+					std::is_same_v<T, XMUINT3> ||
+					std::is_same_v<T, XMUINT4>;
+			}
+		}
+
+		// 32-bit integers are widened to 64 bits when serialized one by one, but arrays of them are copied at once without widening since archive version 84
+		template<typename T>
+		static constexpr bool is_widened_bulk_type()
+		{
+			return std::is_same_v<T, int> || std::is_same_v<T, unsigned int>;
+		}
 	};
 }
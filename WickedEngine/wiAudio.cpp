@@ -340,6 +340,13 @@ namespace wi::audio
 
 		return true;
 	}
+	size_t GetSoundMemorySize(const Sound* sound)
+	{
+		if (sound == nullptr || !sound->IsValid())
+			return 0;
+		const auto& soundinternal = std::static_pointer_cast<SoundInternal>(sound->internal_state);
+		return soundinternal->audioData.size();
+	}
 	bool CreateSoundInstance(const Sound* sound, SoundInstance* instance)
 	{
 		HRESULT hr;
@@ -850,6 +857,12 @@ namespace wi::audio
 
 		return true;
 	}
+	size_t GetSoundMemorySize(const Sound* sound) {
+		if(sound == nullptr || !sound->IsValid())
+			return 0;
+		const auto& soundinternal = std::static_pointer_cast<SoundInternal>(sound->internal_state);
+		return soundinternal->audioData.size();
+	}
 	bool CreateSoundInstance(const Sound* sound, SoundInstance* instance) { 
 		uint32_t res;
 		const auto& soundinternal = std::static_pointer_cast<SoundInternal>(sound->internal_state);
@@ -1048,6 +1061,7 @@ namespace wi::audio
 	bool CreateSound(const std::string& filename, Sound* sound) { return false; }
 	bool CreateSound(const uint8_t* data, size_t size, Sound* sound) { return false; }
 	bool CreateSoundInstance(const Sound* sound, SoundInstance* instance) { return false; }
+	size_t GetSoundMemorySize(const Sound* sound) { return 0; }
 
 	void Play(SoundInstance* instance) {}
 	void Pause(SoundInstance* instance) {}
@@ -60,6 +60,8 @@ namespace wi::audio
 	bool CreateSound(SDL_RWops* data, Sound* sound);
 #endif
 	bool CreateSoundInstance(const Sound* sound, SoundInstance* instance);
+	// Returns the size of the decoded sound data in bytes
+	size_t GetSoundMemorySize(const Sound* sound);
 
 	void Play(SoundInstance* instance);
 	void Pause(SoundInstance* instance);
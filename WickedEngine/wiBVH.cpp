@@ -0,0 +1,154 @@
+#include "wiBVH.h"
+#include "wiMath.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace wi::primitive;
+
+namespace wi
+{
+	inline float SurfaceArea(const AABB& aabb)
+	{
+		const float x = aabb._max.x - aabb._min.x;
+		const float y = aabb._max.y - aabb._min.y;
+		const float z = aabb._max.z - aabb._min.z;
+		return 2 * (x * y + y * z + z * x);
+	}
+
+	void BVH::Build(const AABB* aabbs, uint32_t count, uint32_t max_leaf_size)
+	{
+		Clear();
+		item_count = count;
+		if (count == 0)
+			return;
+		max_leaf_size = std::max(1u, max_leaf_size);
+
+		leaf_indices.resize(count);
+		std::iota(leaf_indices.begin(), leaf_indices.end(), 0u);
+
+		wi::vector<XMFLOAT3> centers(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const AABB& aabb = aabbs[i];
+			centers[i] = aabb.IsValid() ? aabb.getCenter() : XMFLOAT3(0, 0, 0);
+		}
+
+		nodes.reserve(count * 2);
+		nodes.emplace_back();
+		nodes.back().offset = 0;
+		nodes.back().count = count;
+
+		// Top-down median split along the longest axis of the item centers:
+		struct Range
+		{
+			uint32_t node;
+			uint32_t offset;
+			uint32_t count;
+		};
+		wi::vector<Range> stack;
+		stack.push_back({ 0, 0, count });
+		while (!stack.empty())
+		{
+			const Range range = stack.back();
+			stack.pop_back();
+
+			if (range.count <= max_leaf_size)
+			{
+				nodes[range.node].offset = range.offset;
+				nodes[range.node].count = range.count;
+				continue;
+			}
+
+			XMFLOAT3 _min = XMFLOAT3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+			XMFLOAT3 _max = XMFLOAT3(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+			for (uint32_t i = range.offset; i < range.offset + range.count; ++i)
+			{
+				const XMFLOAT3& center = centers[leaf_indices[i]];
+				_min = wi::math::Min(_min, center);
+				_max = wi::math::Max(_max, center);
+			}
+			const XMFLOAT3 extent = XMFLOAT3(_max.x - _min.x, _max.y - _min.y, _max.z - _min.z);
+			const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+			const uint32_t half = range.count / 2;
+			auto first = leaf_indices.begin() + range.offset;
+			std::nth_element(first, first + half, first + range.count, [&](uint32_t a, uint32_t b) {
+				return (&centers[a].x)[axis] < (&centers[b].x)[axis];
+			});
+
+			const uint32_t left = (uint32_t)nodes.size();
+			nodes.emplace_back();
+			nodes.emplace_back();
+			nodes[range.node].left = left;
+			nodes[range.node].count = 0;
+
+			stack.push_back({ left + 1, range.offset + half, range.count - half });
+			stack.push_back({ left, range.offset, half });
+		}
+
+		Refit(aabbs);
+		build_cost = cost;
+	}
+
+	void BVH::Refit(const AABB* aabbs)
+	{
+		// Children are always placed after their parents, so reverse order visits them first:
+		cost = 0;
+		for (size_t i = nodes.size(); i > 0; --i)
+		{
+			Node& node = nodes[i - 1];
+			AABB aabb;
+			aabb.layerMask = 0;
+			if (node.IsLeaf())
+			{
+				for (uint32_t j = 0; j < node.count; ++j)
+				{
+					const AABB& item = aabbs[leaf_indices[node.offset + j]];
+					aabb._min = wi::math::Min(aabb._min, item._min);
+					aabb._max = wi::math::Max(aabb._max, item._max);
+					aabb.layerMask |= item.layerMask;
+				}
+			}
+			else
+			{
+				const AABB& left = nodes[node.left].aabb;
+				const AABB& right = nodes[node.left + 1].aabb;
+				aabb._min = wi::math::Min(left._min, right._min);
+				aabb._max = wi::math::Max(left._max, right._max);
+				aabb.layerMask = left.layerMask | right.layerMask;
+			}
+			node.aabb = aabb;
+			if (aabb.IsValid())
+			{
+				cost += SurfaceArea(aabb);
+			}
+		}
+	}
+
+	bool BVH::Update(const AABB* aabbs, uint32_t count, uint32_t max_leaf_size)
+	{
+		if (count != item_count)
+		{
+			Build(aabbs, count, max_leaf_size);
+			return true;
+		}
+		Refit(aabbs);
+		if (cost > build_cost * 2)
+		{
+			// Items moved so much that the hierarchy became too loose:
+			Build(aabbs, count, max_leaf_size);
+			return true;
+		}
+		return false;
+	}
+
+	void BVH::Clear()
+	{
+		nodes.clear();
+		leaf_indices.clear();
+		item_count = 0;
+		build_cost = 0;
+		cost = 0;
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiPrimitive.h"
+#include "wiVector.h"
+
+#include <cassert>
+#include <algorithm>
+
+namespace wi
+{
+	// Bounding volume hierarchy of AABBs on the CPU
+	//	Items are referenced by their index in the AABB array that the hierarchy was built from
+	//	When items are moving, the hierarchy can be refitted without rebuilding it
+	struct BVH
+	{
+		struct Node
+		{
+			wi::primitive::AABB aabb; // aabb.layerMask is the combined layerMask of all items in the subtree
+			uint32_t left = 0; // for internal nodes: index of the left child, the right child is left + 1
+			uint32_t offset = 0; // for leaf nodes: first item in leaf_indices
+			uint32_t count = 0; // for leaf nodes: number of items, zero for internal nodes
+
+			constexpr bool IsLeaf() const { return count > 0; }
+		};
+		wi::vector<Node> nodes;
+		wi::vector<uint32_t> leaf_indices;
+		uint32_t item_count = 0;
+		float build_cost = 0; // sum of node surface areas after build
+		float cost = 0; // sum of node surface areas after last refit
+
+		// Build the hierarchy from scratch
+		void Build(const wi::primitive::AABB* aabbs, uint32_t count, uint32_t max_leaf_size = 4);
+
+		// Update the bounds of the existing hierarchy. The AABB array must have the same item count that the hierarchy was built with
+		void Refit(const wi::primitive::AABB* aabbs);
+
+		// Refit if possible, rebuild if the item count changed or refitting degraded the hierarchy too much
+		//	returns true if the hierarchy was rebuilt
+		bool Update(const wi::primitive::AABB* aabbs, uint32_t count, uint32_t max_leaf_size = 4);
+
+		void Clear();
+
+		constexpr bool IsValid() const { return item_count > 0; }
+
+		// Traverse the hierarchy
+		//	node_intersects	: bool(const wi::primitive::AABB& aabb) that decides whether a subtree needs to be visited
+		//	callback		: void(uint32_t item_index) that is called for items in intersecting leaf nodes.
+		//						Only the leaf bounds are tested, so the callback still needs to test the item itself
+		//	root			: the node to start from, to only traverse a subtree (see GetSubtrees())
+		template<typename NodeIntersects, typename Callback>
+		void Intersects(const NodeIntersects& node_intersects, const Callback& callback, uint32_t root = 0) const
+		{
+			if (nodes.empty())
+				return;
+			uint32_t stack[64];
+			uint32_t stack_size = 0;
+			stack[stack_size++] = root;
+			while (stack_size > 0)
+			{
+				const Node& node = nodes[stack[--stack_size]];
+				if (!node_intersects(node.aabb))
+					continue;
+				if (node.IsLeaf())
+				{
+					for (uint32_t i = 0; i < node.count; ++i)
+					{
+						callback(leaf_indices[node.offset + i]);
+					}
+				}
+				else
+				{
+					assert(stack_size + 2 <= arraysize(stack));
+					stack[stack_size++] = node.left + 1;
+					stack[stack_size++] = node.left;
+				}
+			}
+		}
+
+		// Split the intersecting part of the hierarchy into independent subtrees, so that they can be traversed in parallel with Intersects()
+		//	node_intersects	: bool(const wi::primitive::AABB& aabb) that decides whether a subtree needs to be visited
+		//	subtrees		: receives the root nodes of the subtrees, it must have room for max_count nodes
+		//	returns the number of subtrees, which can be less than max_count if the intersecting part has less nodes
+		template<typename NodeIntersects>
+		uint32_t GetSubtrees(const NodeIntersects& node_intersects, uint32_t* subtrees, uint32_t max_count) const
+		{
+			if (nodes.empty() || max_count == 0)
+				return 0;
+			// The subtrees are split breadth first in a ring buffer, so they end up at similar depths.
+			//	Leaves can't be split, so the splitting stops when the buffer is full or it only contains leaves:
+			uint32_t head = 0;
+			uint32_t count = 0;
+			uint32_t leaves_in_row = 0;
+			subtrees[count++] = 0;
+			while (leaves_in_row < count)
+			{
+				const Node& node = nodes[subtrees[head]];
+				if (!node_intersects(node.aabb))
+				{
+					head = (head + 1) % max_count;
+					count--;
+				}
+				else if (node.IsLeaf())
+				{
+					subtrees[(head + count) % max_count] = subtrees[head];
+					head = (head + 1) % max_count;
+					leaves_in_row++;
+				}
+				else if (count < max_count)
+				{
+					head = (head + 1) % max_count;
+					subtrees[(head + count - 1) % max_count] = node.left;
+					subtrees[(head + count) % max_count] = node.left + 1;
+					count++;
+					leaves_in_row = 0;
+				}
+				else
+				{
+					break;
+				}
+			}
+			std::rotate(subtrees, subtrees + head, subtrees + max_count);
+			return count;
+		}
+
+		// Query items that intersect, by traversing the hierarchy if it is up to date with the AABB array, or by testing every item otherwise
+		//	aabbs			: the AABB array that the hierarchy was built from
+		//	aabb_intersects	: bool(const wi::primitive::AABB& aabb) that is used to test both subtrees and items
+		//	callback		: void(uint32_t item_index) that is called for intersecting items
+		template<typename AABBIntersects, typename Callback>
+		void Query(const wi::primitive::AABB* aabbs, uint32_t count, const AABBIntersects& aabb_intersects, const Callback& callback) const
+		{
+			if (IsValid() && item_count == count)
+			{
+				Intersects(aabb_intersects, [&](uint32_t index) {
+					if (aabb_intersects(aabbs[index]))
+					{
+						callback(index);
+					}
+				});
+				return;
+			}
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				if (aabb_intersects(aabbs[i]))
+				{
+					callback(i);
+				}
+			}
+		}
+	};
+}
@@ -9,6 +9,10 @@
 #include <cstdint>
 #include <cassert>
 #include <atomic>
+#include <mutex>
+#include <memory>
+#include <deque>
+#include <algorithm>
 
 // Entity-Component System
 namespace wi::ecs
@@ -19,19 +23,136 @@ namespace wi::ecs
 	//	It must be only serialized with the SerializeEntity() function. It will ensure that entities still match with their components correctly after serialization
 	using Entity = uint32_t;
 	static const Entity INVALID_ENTITY = 0;
+
+	// Generational entities (optional, disabled by default):
+	//	By default entities are allocated from a monotonically increasing counter and they are never reused
+	//	When generational entities are enabled, the entity is packed from an index (lower bits) and a generation (upper bits)
+	//	The index of a destroyed entity will be reused with an incremented generation, so indices stay dense for the live entities
+	//	Stale entities can be detected with IsEntityValid(), because their generation won't match the current generation of the index
+	static const uint32_t ENTITY_INDEX_BITS = 24;
+	static const uint32_t ENTITY_GENERATION_BITS = 32 - ENTITY_INDEX_BITS;
+	static const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+	static const uint32_t ENTITY_GENERATION_MASK = (1u << ENTITY_GENERATION_BITS) - 1;
+	static const uint32_t ENTITY_MINIMUM_FREE_INDICES = 1024; // destroyed indices are reused in FIFO order only after this many are free, to delay the wrap around of generations
+	static const uint32_t ENTITY_GENERATION_PAGE_SIZE = 4096; // generations are allocated in pages of this many indices
+	static_assert(ENTITY_GENERATION_BITS <= 8, "generations are stored as uint8_t");
+
+	namespace entity_internal
+	{
+		inline std::atomic<Entity> next{ INVALID_ENTITY + 1 };
+		inline bool generational = false;
+		inline Entity index_mask = ~0u; // ENTITY_INDEX_MASK in generational mode, so non-generational entities are used as indices unchanged
+		inline std::mutex locker; // protects the free indices and the allocation of generation pages
+		inline std::deque<uint32_t> free_indices;
+
+		// The current generation of every index is stored in pages that are never moved, so they can be read without locking:
+		inline std::atomic<std::atomic<uint8_t>*> generation_pages[(ENTITY_INDEX_MASK + 1) / ENTITY_GENERATION_PAGE_SIZE];
+		inline wi::vector<std::unique_ptr<std::atomic<uint8_t>[]>> generation_page_allocations; // owns the pages, protected by locker
+
+		// Returns the generation of an index that is below next
+		inline std::atomic<uint8_t>& generation(uint32_t index)
+		{
+			return generation_pages[index / ENTITY_GENERATION_PAGE_SIZE].load(std::memory_order_acquire)[index % ENTITY_GENERATION_PAGE_SIZE];
+		}
+	}
+
+	// Enable or disable generational entities. It must be set before any entity is created, for example at application startup
+	inline void SetGenerationalEntitiesEnabled(bool value)
+	{
+		assert(entity_internal::next.load() == INVALID_ENTITY + 1); // entities were already created
+		entity_internal::generational = value;
+		entity_internal::index_mask = value ? ENTITY_INDEX_MASK : ~0u;
+	}
+	inline bool IsGenerationalEntitiesEnabled() { return entity_internal::generational; }
+
+	// Returns the index part of the entity that can be used to index dense arrays
+	//	When generational entities are disabled, this is the entity itself
+	inline uint32_t GetEntityIndex(Entity entity) { return entity & entity_internal::index_mask; }
+	// Returns the generation part of the entity. When generational entities are disabled, this is always zero
+	inline uint32_t GetEntityGeneration(Entity entity) { return entity_internal::generational ? (entity >> ENTITY_INDEX_BITS) : 0; }
+
 	// Runtime can create a new entity with this
 	inline Entity CreateEntity()
 	{
-		static std::atomic<Entity> next{ INVALID_ENTITY + 1 };
-		return next.fetch_add(1);
+		if (!entity_internal::generational)
+		{
+			return entity_internal::next.fetch_add(1);
+		}
+		std::scoped_lock lock(entity_internal::locker);
+		uint32_t index;
+		if (entity_internal::free_indices.size() > ENTITY_MINIMUM_FREE_INDICES)
+		{
+			index = entity_internal::free_indices.front();
+			entity_internal::free_indices.pop_front();
+		}
+		else
+		{
+			index = entity_internal::next.load();
+			assert(index <= ENTITY_INDEX_MASK); // ran out of entity indices
+			std::atomic<std::atomic<uint8_t>*>& page = entity_internal::generation_pages[index / ENTITY_GENERATION_PAGE_SIZE];
+			if (page.load(std::memory_order_relaxed) == nullptr)
+			{
+				auto& allocation = entity_internal::generation_page_allocations.emplace_back(new std::atomic<uint8_t>[ENTITY_GENERATION_PAGE_SIZE]);
+				for (uint32_t i = 0; i < ENTITY_GENERATION_PAGE_SIZE; ++i)
+				{
+					allocation[i].store(0, std::memory_order_relaxed);
+				}
+				page.store(allocation.get(), std::memory_order_release);
+			}
+			entity_internal::next.store(index + 1, std::memory_order_release); // the page is published before the index becomes valid
+		}
+		return Entity(entity_internal::generation(index).load(std::memory_order_relaxed)) << ENTITY_INDEX_BITS | index;
+	}
+
+	// Check whether the entity was created and not destroyed yet
+	//	When generational entities are disabled, entities are never destroyed, so this only checks that it was created
+	//	This doesn't lock, so it can be called from multiple threads, while entities are created or destroyed
+	inline bool IsEntityValid(Entity entity)
+	{
+		if (entity == INVALID_ENTITY)
+			return false;
+		if (!entity_internal::generational)
+			return entity < entity_internal::next.load();
+		const uint32_t index = entity & ENTITY_INDEX_MASK;
+		return index < entity_internal::next.load(std::memory_order_acquire) && entity_internal::generation(index).load(std::memory_order_acquire) == (entity >> ENTITY_INDEX_BITS);
+	}
+
+	// Release the entity, so that its index can be reused by a new entity later
+	//	Components must not be associated with the entity anymore, and the entity handle must not be used after this
+	//	When generational entities are disabled, this does nothing
+	inline void DestroyEntity(Entity entity)
+	{
+		if (!entity_internal::generational || entity == INVALID_ENTITY)
+			return;
+		const uint32_t index = entity & ENTITY_INDEX_MASK;
+		std::scoped_lock lock(entity_internal::locker);
+		if (index >= entity_internal::next.load() || entity_internal::generation(index).load(std::memory_order_relaxed) != (entity >> ENTITY_INDEX_BITS))
+			return; // already destroyed
+		entity_internal::generation(index).store(uint8_t(((entity >> ENTITY_INDEX_BITS) + 1) & ENTITY_GENERATION_MASK), std::memory_order_release);
+		entity_internal::free_indices.push_back(index);
 	}
 
+	// Returns the upper bound of entity indices that are in use, which can be used to size dense arrays indexed by GetEntityIndex()
+	//	In generational mode this only grows with the peak count of live entities, otherwise with every entity that was ever created
+	inline uint32_t GetEntityIndexCapacity() { return entity_internal::next.load(); }
+
 	struct EntitySerializer
 	{
 		wi::jobsystem::context ctx; // allow components to spawn serialization subtasks
 		wi::unordered_map<uint64_t, Entity> remap;
 		bool allow_remap = true;
 
+		// In write mode, the serialized entities can be collected without duplicates, in the order they were first written
+		//	In read mode, creating the remap up front from such a list means that deserialization only reads the remap,
+		//	so components can be deserialized on multiple threads with the same EntitySerializer
+		bool collect_entities = false;
+		wi::vector<uint64_t> entities;
+
+		// In read mode, the remap can be made read only, so that multiple threads can use it. Entities that are not found in it
+		//	are deserialized as INVALID_ENTITY and counted, because that means that the archive doesn't match its entity list
+		bool remap_readonly = false;
+		std::atomic<uint32_t> missing_entities{ 0 };
+
 		~EntitySerializer()
 		{
 			wi::jobsystem::Wait(ctx); // automatically wait for all subtasks after serialization
@@ -46,10 +167,16 @@ namespace wi::ecs
 			uint64_t mem;
 			archive >> mem;
 
-			if (mem != INVALID_ENTITY && seri.allow_remap)
+			// Generational entities can only be kept if they are still alive, otherwise the index could belong to a different entity:
+			if (mem != INVALID_ENTITY && (seri.allow_remap || (IsGenerationalEntitiesEnabled() && !IsEntityValid((Entity)mem))))
 			{
 				auto it = seri.remap.find(mem);
-				if (it == seri.remap.end())
+				if (it == seri.remap.end() && seri.remap_readonly)
+				{
+					entity = INVALID_ENTITY;
+					seri.missing_entities.fetch_add(1, std::memory_order_relaxed);
+				}
+				else if (it == seri.remap.end())
 				{
 					entity = CreateEntity();
 					seri.remap[mem] = entity;
@@ -67,11 +194,134 @@ namespace wi::ecs
 		else
 		{
 			archive << entity;
+
+			if (seri.collect_entities && entity != INVALID_ENTITY && seri.remap.emplace(entity, entity).second)
+			{
+				seri.entities.push_back(entity);
+			}
 		}
 	}
 
+	// Entity -> component index lookup table using a hash map
+	class HashEntityLookup
+	{
+	public:
+		inline void reserve(size_t count) { lookup.reserve(count); }
+		inline void clear() { lookup.clear(); }
+		inline size_t size() const { return lookup.size(); }
+
+		// Returns the index that belongs to the entity, or ~0ull if it doesn't exist
+		inline size_t find(Entity entity) const
+		{
+			const auto it = lookup.find(entity);
+			if (it != lookup.end())
+			{
+				return it->second;
+			}
+			return ~0ull;
+		}
+		inline void set(Entity entity, size_t index) { lookup[entity] = index; }
+		inline void erase(Entity entity) { lookup.erase(entity); }
+
+	private:
+		wi::unordered_map<Entity, size_t> lookup;
+	};
+
+	// Entity -> component index lookup table using a sparse set
+	//	The sparse array is directly indexed by entity indices (see GetEntityIndex()), so lookups don't need hashing
+	//	It is divided into pages, and only pages containing entities that have components are allocated
+	//	The full entity is stored in the slot too, so stale generational entities that share the index are not found
+	//	The page table grows up to the largest entity index that has a component, and a page is allocated even for a single entity in it,
+	//	so this is only worth it for ComponentManagers that most entities have components in. It can be selected per ComponentManager
+	class SparseEntityLookup
+	{
+	public:
+		static constexpr uint32_t page_size_log2 = 10;
+		static constexpr uint32_t page_size = 1u << page_size_log2;
+		static constexpr uint32_t page_mask = page_size - 1;
+
+		// The component count doesn't tell which entity indices will have components, so no pages are allocated here
+		//	If components are expected (count > 0), only the page table is reserved, for the entity indices that were created so far
+		inline void reserve(size_t count)
+		{
+			if (count > 0)
+			{
+				pages.reserve((size_t(GetEntityIndexCapacity()) + page_mask) >> page_size_log2);
+			}
+		}
+		inline void clear()
+		{
+			pages.clear();
+			count = 0;
+		}
+		inline size_t size() const { return count; }
+
+		// Returns the index that belongs to the entity, or ~0ull if it doesn't exist
+		inline size_t find(Entity entity) const
+		{
+			const uint32_t entity_index = GetEntityIndex(entity);
+			const size_t page = entity_index >> page_size_log2;
+			if (page < pages.size() && !pages[page].empty())
+			{
+				const Slot& slot = pages[page][entity_index & page_mask];
+				if (slot.entity == entity && entity != INVALID_ENTITY)
+				{
+					return slot.index;
+				}
+			}
+			return ~0ull;
+		}
+		inline void set(Entity entity, size_t index)
+		{
+			assert(index < ~0u);
+			assert(entity != INVALID_ENTITY);
+			const uint32_t entity_index = GetEntityIndex(entity);
+			const size_t page = entity_index >> page_size_log2;
+			if (page >= pages.size())
+			{
+				pages.resize(page + 1);
+			}
+			if (pages[page].empty())
+			{
+				pages[page].resize(page_size);
+			}
+			Slot& slot = pages[page][entity_index & page_mask];
+			assert(slot.entity == INVALID_ENTITY || slot.entity == entity); // a destroyed entity still has a component
+			if (slot.entity == INVALID_ENTITY)
+			{
+				count++;
+			}
+			slot.entity = entity;
+			slot.index = (uint32_t)index;
+		}
+		inline void erase(Entity entity)
+		{
+			const uint32_t entity_index = GetEntityIndex(entity);
+			const size_t page = entity_index >> page_size_log2;
+			if (page < pages.size() && !pages[page].empty())
+			{
+				Slot& slot = pages[page][entity_index & page_mask];
+				if (slot.entity == entity && entity != INVALID_ENTITY)
+				{
+					slot.entity = INVALID_ENTITY;
+					count--;
+				}
+			}
+		}
+
+	private:
+		struct Slot
+		{
+			Entity entity = INVALID_ENTITY;
+			uint32_t index = ~0u;
+		};
+		wi::vector<wi::vector<Slot>> pages;
+		size_t count = 0;
+	};
+
 	// The ComponentManager is a container that stores components and matches them with entities
-	template<typename Component>
+	//	EntityLookup : the entity -> component index lookup table implementation (HashEntityLookup or SparseEntityLookup)
+	template<typename Component, typename EntityLookup = HashEntityLookup>
 	class ComponentManager
 	{
 	public:
@@ -90,21 +340,23 @@ namespace wi::ecs
 			components.clear();
 			entities.clear();
 			lookup.clear();
+			version++;
 		}
 
 		// Perform deep copy of all the contents of "other" into this
-		inline void Copy(const ComponentManager<Component>& other)
+		inline void Copy(const ComponentManager<Component, EntityLookup>& other)
 		{
 			Clear();
 			components = other.components;
 			entities = other.entities;
 			lookup = other.lookup;
+			version++;
 		}
 
 		// Merge in an other component manager of the same type to this. 
 		//	The other component manager MUST NOT contain any of the same entities!
 		//	The other component manager is not retained after this operation!
-		inline void Merge(ComponentManager<Component>& other)
+		inline void Merge(ComponentManager<Component, EntityLookup>& other)
 		{
 			components.reserve(GetCount() + other.GetCount());
 			entities.reserve(GetCount() + other.GetCount());
@@ -115,11 +367,12 @@ namespace wi::ecs
 				Entity entity = other.entities[i];
 				assert(!Contains(entity));
 				entities.push_back(entity);
-				lookup[entity] = components.size();
+				lookup.set(entity, components.size());
 				components.push_back(std::move(other.components[i]));
 			}
 
 			other.Clear();
+			version++;
 		}
 
 		// Read/Write everything to an archive depending on the archive state
@@ -139,13 +392,24 @@ namespace wi::ecs
 				}
 
 				entities.resize(count);
+				size_t valid_count = 0;
 				for (size_t i = 0; i < count; ++i)
 				{
 					Entity entity;
 					SerializeEntity(archive, entity, seri);
-					entities[i] = entity;
-					lookup[entity] = i;
+					if (entity == INVALID_ENTITY)
+						continue; // the entity couldn't be remapped (see EntitySerializer::remap_readonly), so its component is dropped
+					if (valid_count != i)
+					{
+						components[valid_count] = std::move(components[i]);
+					}
+					entities[valid_count] = entity;
+					lookup.set(entity, valid_count);
+					valid_count++;
 				}
+				components.resize(valid_count);
+				entities.resize(valid_count);
+				version++;
 			}
 			else
 			{
@@ -168,14 +432,14 @@ namespace wi::ecs
 			assert(entity != INVALID_ENTITY);
 
 			// Only one of this component type per entity is allowed!
-			assert(lookup.find(entity) == lookup.end());
+			assert(lookup.find(entity) == ~0ull);
 
 			// Entity count must always be the same as the number of coponents!
 			assert(entities.size() == components.size());
 			assert(lookup.size() == components.size());
 
 			// Update the entity lookup table:
-			lookup[entity] = components.size();
+			lookup.set(entity, components.size());
 
 			// New components are always pushed to the end:
 			components.emplace_back();
@@ -183,18 +447,18 @@ namespace wi::ecs
 			// Also push corresponding entity:
 			entities.push_back(entity);
 
+			version++;
+
 			return components.back();
 		}
 
 		// Remove a component of a certain entity if it exists
 		inline void Remove(Entity entity)
 		{
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.find(entity);
+			if (index != ~0ull)
 			{
 				// Directly index into components and entities array:
-				const size_t index = it->second;
-				const Entity entity = entities[index];
 
 				if (index < components.size() - 1)
 				{
@@ -203,25 +467,24 @@ namespace wi::ecs
 					entities[index] = entities.back();
 
 					// Update the lookup table:
-					lookup[entities[index]] = index;
+					lookup.set(entities[index], index);
 				}
 
 				// Shrink the container:
 				components.pop_back();
 				entities.pop_back();
 				lookup.erase(entity);
+				version++;
 			}
 		}
 
 		// Remove a component of a certain entity if it exists while keeping the current ordering
 		inline void Remove_KeepSorted(Entity entity)
 		{
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.find(entity);
+			if (index != ~0ull)
 			{
 				// Directly index into components and entities array:
-				const size_t index = it->second;
-				const Entity entity = entities[index];
 
 				if (index < components.size() - 1)
 				{
@@ -234,7 +497,7 @@ namespace wi::ecs
 					for (size_t i = index + 1; i < entities.size(); ++i)
 					{
 						entities[i - 1] = entities[i];
-						lookup[entities[i - 1]] = i - 1;
+						lookup.set(entities[i - 1], i - 1);
 					}
 				}
 
@@ -242,7 +505,51 @@ namespace wi::ecs
 				components.pop_back();
 				entities.pop_back();
 				lookup.erase(entity);
+				version++;
+			}
+		}
+
+		// Remove the components of multiple entities (if they exist) while keeping the current ordering
+		//	The containers are compacted only once, instead of moving elements for every removed entity
+		inline void Remove_Many(const wi::vector<Entity>& entities_to_remove)
+		{
+			wi::vector<size_t> indices;
+			indices.reserve(entities_to_remove.size());
+			for (Entity entity : entities_to_remove)
+			{
+				const size_t index = lookup.find(entity);
+				if (index != ~0ull)
+				{
+					indices.push_back(index);
+					lookup.erase(entity);
+				}
+			}
+			if (indices.empty())
+			{
+				return;
+			}
+			std::sort(indices.begin(), indices.end());
+
+			// Elements before the first removed one stay in place, the rest are moved left over the removed ones:
+			size_t write = indices.front();
+			size_t next_removed = 0;
+			for (size_t read = indices.front(); read < components.size(); ++read)
+			{
+				if (next_removed < indices.size() && indices[next_removed] == read)
+				{
+					next_removed++;
+					continue;
+				}
+				components[write] = std::move(components[read]);
+				entities[write] = entities[read];
+				lookup.set(entities[write], write);
+				write++;
 			}
+
+			// Shrink the container:
+			components.erase(components.begin() + write, components.end());
+			entities.erase(entities.begin() + write, entities.end());
+			version++;
 		}
 
 		// Place an entity-component to the specified index position while keeping the ordering intact
@@ -266,28 +573,29 @@ namespace wi::ecs
 				const size_t next = i + direction;
 				components[i] = std::move(components[next]);
 				entities[i] = entities[next];
-				lookup[entities[i]] = i;
+				lookup.set(entities[i], i);
 			}
 
 			// Saved entity-component moved to the required position:
 			components[index_to] = std::move(component);
 			entities[index_to] = entity;
-			lookup[entity] = index_to;
+			lookup.set(entity, index_to);
+			version++;
 		}
 
 		// Check if a component exists for a given entity or not
 		inline bool Contains(Entity entity) const
 		{
-			return lookup.find(entity) != lookup.end();
+			return lookup.find(entity) != ~0ull;
 		}
 
 		// Retrieve a [read/write] component specified by an entity (if it exists, otherwise nullptr)
 		inline Component* GetComponent(Entity entity)
 		{
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.find(entity);
+			if (index != ~0ull)
 			{
-				return &components[it->second];
+				return &components[index];
 			}
 			return nullptr;
 		}
@@ -295,10 +603,10 @@ namespace wi::ecs
 		// Retrieve a [read only] component specified by an entity (if it exists, otherwise nullptr)
 		inline const Component* GetComponent(Entity entity) const
 		{
-			const auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.find(entity);
+			if (index != ~0ull)
 			{
-				return &components[it->second];
+				return &components[index];
 			}
 			return nullptr;
 		}
@@ -306,12 +614,7 @@ namespace wi::ecs
 		// Retrieve component index by entity handle (if not exists, returns ~0ull value)
 		inline size_t GetIndex(Entity entity) const 
 		{
-			const auto it = lookup.find(entity);
-			if (it != lookup.end())
-			{
-				return it->second;
-			}
-			return ~0ull;
+			return lookup.find(entity);
 		}
 
 		// Retrieve the number of existing entries
@@ -335,13 +638,21 @@ namespace wi::ecs
 		// Returns the tightly packed [read only] component array
 		inline const wi::vector<Component>& GetComponentArray() const { return components; }
 
+		// Returns a counter that changes whenever entity-components are added, removed or reordered
+		//	This can be used to invalidate data that was derived from component indices
+		inline uint64_t GetVersion() const { return version; }
+		// Increment the version after components were replaced in place, so that data derived from them is rebuilt too
+		inline void IncrementVersion() { version++; }
+
 	private:
 		// This is a linear array of alive components
 		wi::vector<Component> components;
 		// This is a linear array of entities corresponding to each alive component
 		wi::vector<Entity> entities;
 		// This is a lookup table for entities
-		wi::unordered_map<Entity, size_t> lookup;
+		EntityLookup lookup;
+		// Incremented on every structural change
+		uint64_t version = 0;
 
 		// Disallow this to be copied by mistake
 		ComponentManager(const ComponentManager&) = delete;
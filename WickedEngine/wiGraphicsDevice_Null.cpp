@@ -0,0 +1,388 @@
+#include "wiGraphicsDevice_Null.h"
+#include "wiHelper.h"
+#include "wiBacklog.h"
+#include "wiTimer.h"
+
+#include <cmath>
+#include <string>
+
+namespace wi::graphics
+{
+	namespace null_internal
+	{
+		struct Resource_Null
+		{
+			std::shared_ptr<std::atomic<uint64_t>> memory_usage;
+			uint64_t size = 0;
+			std::unique_ptr<uint8_t[]> memory; // only for resources with CPU access
+			wi::vector<SubresourceData> mapped_subresources;
+			int descriptors[4] = { -1, -1, -1, -1 }; // indexed by SubresourceType
+			wi::vector<int> subresources[4]; // descriptor indices of subresources, indexed by SubresourceType
+
+			~Resource_Null()
+			{
+				if (memory_usage != nullptr)
+				{
+					memory_usage->fetch_sub(size);
+				}
+			}
+		};
+		struct Sampler_Null
+		{
+			int index = -1;
+		};
+		struct Shader_Null {};
+		struct QueryHeap_Null {};
+		struct PipelineState_Null {};
+		struct RenderPass_Null {};
+		struct SwapChain_Null
+		{
+			Texture backbuffer;
+		};
+
+		Resource_Null* to_internal(const GPUResource* param)
+		{
+			return static_cast<Resource_Null*>(param->internal_state.get());
+		}
+		Sampler_Null* to_internal(const Sampler* param)
+		{
+			return static_cast<Sampler_Null*>(param->internal_state.get());
+		}
+		SwapChain_Null* to_internal(const SwapChain* param)
+		{
+			return static_cast<SwapChain_Null*>(param->internal_state.get());
+		}
+
+		// Computes the linear memory layout of every subresource of a texture, returns the full size of the texture
+		uint64_t compute_texture_layout(const TextureDesc& desc, wi::vector<SubresourceData>* subresources, uint8_t* data)
+		{
+			const uint32_t block_size = GetFormatBlockSize(desc.format);
+			const uint32_t stride = GetFormatStride(desc.format);
+			uint64_t size = 0;
+			for (uint32_t slice = 0; slice < desc.array_size; ++slice)
+			{
+				for (uint32_t mip = 0; mip < desc.mip_levels; ++mip)
+				{
+					const uint32_t width = std::max(1u, desc.width >> mip);
+					const uint32_t height = std::max(1u, desc.height >> mip);
+					const uint32_t depth = std::max(1u, desc.depth >> mip);
+					const uint32_t num_blocks_x = (width + block_size - 1) / block_size;
+					const uint32_t num_blocks_y = (height + block_size - 1) / block_size;
+					if (subresources != nullptr)
+					{
+						SubresourceData& subresource = subresources->emplace_back();
+						subresource.data_ptr = data + size;
+						subresource.row_pitch = num_blocks_x * stride;
+						subresource.slice_pitch = subresource.row_pitch * num_blocks_y;
+					}
+					size += uint64_t(num_blocks_x) * num_blocks_y * depth * stride;
+				}
+			}
+			return size * std::max(1u, desc.sample_count);
+		}
+	}
+	using namespace null_internal;
+
+	void GraphicsDevice_Null::Statistics::Add(const Statistics& other)
+	{
+		command_lists += other.command_lists;
+		render_passes += other.render_passes;
+		draws += other.draws;
+		dispatches += other.dispatches;
+		copies += other.copies;
+		barriers += other.barriers;
+		pipeline_binds += other.pipeline_binds;
+		resource_binds += other.resource_binds;
+		bytes_uploaded += other.bytes_uploaded;
+		buffers_created += other.buffers_created;
+		textures_created += other.textures_created;
+	}
+
+	GraphicsDevice_Null::GraphicsDevice_Null(uint64_t memory_budget) : memory_budget(memory_budget)
+	{
+		wi::Timer timer;
+
+		capabilities = GraphicsDeviceCapability::NONE;
+		TIMESTAMP_FREQUENCY = 1000000000ull; // nanoseconds, it must not be zero because the profiler divides by it
+
+		wi::backlog::post("Created GraphicsDevice_Null (" + std::to_string((int)std::round(timer.elapsed())) + " ms)");
+	}
+
+	int GraphicsDevice_Null::allocate_descriptor() const
+	{
+		// The descriptor indices are never read by a GPU, they only need to be valid (non-negative) and different:
+		return int(next_descriptor.fetch_add(1, std::memory_order_relaxed) & 0x7FFFFFFF);
+	}
+
+	bool GraphicsDevice_Null::CreateSwapChain(const SwapChainDesc* desc, wi::platform::window_type window, SwapChain* swapchain) const
+	{
+		auto internal_state = std::static_pointer_cast<SwapChain_Null>(swapchain->internal_state);
+		if (internal_state == nullptr)
+		{
+			internal_state = std::make_shared<SwapChain_Null>();
+		}
+		swapchain->internal_state = internal_state;
+		swapchain->desc = *desc;
+
+		TextureDesc backbuffer_desc;
+		backbuffer_desc.width = desc->width;
+		backbuffer_desc.height = desc->height;
+		backbuffer_desc.format = desc->format;
+		backbuffer_desc.bind_flags = BindFlag::RENDER_TARGET;
+		backbuffer_desc.layout = ResourceState::RENDERTARGET;
+		return CreateTexture(&backbuffer_desc, nullptr, &internal_state->backbuffer);
+	}
+	bool GraphicsDevice_Null::CreateBuffer(const GPUBufferDesc* desc, const void* initial_data, GPUBuffer* buffer) const
+	{
+		auto internal_state = std::make_shared<Resource_Null>();
+		internal_state->memory_usage = memory_usage;
+		internal_state->size = desc->size;
+		memory_usage->fetch_add(desc->size);
+
+		buffer->internal_state = internal_state;
+		buffer->type = GPUResource::Type::BUFFER;
+		buffer->mapped_data = nullptr;
+		buffer->mapped_size = 0;
+		buffer->desc = *desc;
+
+		if (desc->usage == Usage::UPLOAD || desc->usage == Usage::READBACK)
+		{
+			internal_state->memory.reset(new uint8_t[desc->size]());
+			buffer->mapped_data = internal_state->memory.get();
+			buffer->mapped_size = desc->size;
+			if (initial_data != nullptr)
+			{
+				std::memcpy(buffer->mapped_data, initial_data, desc->size);
+			}
+		}
+
+		if (has_flag(desc->bind_flags, BindFlag::SHADER_RESOURCE))
+		{
+			internal_state->descriptors[(int)SubresourceType::SRV] = allocate_descriptor();
+		}
+		if (has_flag(desc->bind_flags, BindFlag::UNORDERED_ACCESS))
+		{
+			internal_state->descriptors[(int)SubresourceType::UAV] = allocate_descriptor();
+		}
+
+		if (statistics_enabled)
+		{
+			buffers_created.fetch_add(1, std::memory_order_relaxed);
+			if (initial_data != nullptr)
+			{
+				bytes_uploaded.fetch_add(desc->size, std::memory_order_relaxed);
+			}
+		}
+		return true;
+	}
+	bool GraphicsDevice_Null::CreateTexture(const TextureDesc* desc, const SubresourceData* initial_data, Texture* texture) const
+	{
+		auto internal_state = std::make_shared<Resource_Null>();
+		internal_state->memory_usage = memory_usage;
+
+		texture->internal_state = internal_state;
+		texture->type = GPUResource::Type::TEXTURE;
+		texture->mapped_data = nullptr;
+		texture->mapped_size = 0;
+		texture->mapped_subresources = nullptr;
+		texture->mapped_subresource_count = 0;
+		texture->desc = *desc;
+
+		if (texture->desc.mip_levels == 0)
+		{
+			texture->desc.mip_levels = (uint32_t)log2(std::max(texture->desc.width, texture->desc.height)) + 1;
+		}
+
+		internal_state->size = compute_texture_layout(texture->desc, nullptr, nullptr);
+		memory_usage->fetch_add(internal_state->size);
+
+		if (desc->usage == Usage::UPLOAD || desc->usage == Usage::READBACK)
+		{
+			internal_state->memory.reset(new uint8_t[internal_state->size]());
+			compute_texture_layout(texture->desc, &internal_state->mapped_subresources, internal_state->memory.get());
+			texture->mapped_data = internal_state->memory.get();
+			texture->mapped_size = internal_state->size;
+			texture->mapped_subresources = internal_state->mapped_subresources.data();
+			texture->mapped_subresource_count = internal_state->mapped_subresources.size();
+		}
+
+		if (has_flag(desc->bind_flags, BindFlag::SHADER_RESOURCE))
+		{
+			internal_state->descriptors[(int)SubresourceType::SRV] = allocate_descriptor();
+		}
+		if (has_flag(desc->bind_flags, BindFlag::UNORDERED_ACCESS))
+		{
+			internal_state->descriptors[(int)SubresourceType::UAV] = allocate_descriptor();
+		}
+
+		if (statistics_enabled)
+		{
+			textures_created.fetch_add(1, std::memory_order_relaxed);
+			if (initial_data != nullptr)
+			{
+				bytes_uploaded.fetch_add(internal_state->size, std::memory_order_relaxed);
+			}
+		}
+		return true;
+	}
+	bool GraphicsDevice_Null::CreateShader(ShaderStage stage, const void* shadercode, size_t shadercode_size, Shader* shader) const
+	{
+		shader->internal_state = std::make_shared<Shader_Null>();
+		shader->stage = stage;
+		return true;
+	}
+	bool GraphicsDevice_Null::CreateSampler(const SamplerDesc* desc, Sampler* sampler) const
+	{
+		auto internal_state = std::make_shared<Sampler_Null>();
+		internal_state->index = allocate_descriptor();
+		sampler->internal_state = internal_state;
+		sampler->desc = *desc;
+		return true;
+	}
+	bool GraphicsDevice_Null::CreateQueryHeap(const GPUQueryHeapDesc* desc, GPUQueryHeap* queryheap) const
+	{
+		queryheap->internal_state = std::make_shared<QueryHeap_Null>();
+		queryheap->desc = *desc;
+		return true;
+	}
+	bool GraphicsDevice_Null::CreatePipelineState(const PipelineStateDesc* desc, PipelineState* pso) const
+	{
+		pso->internal_state = std::make_shared<PipelineState_Null>();
+		pso->desc = *desc;
+
+		pso->hash = 0;
+		wi::helper::hash_combine(pso->hash, desc->ms);
+		wi::helper::hash_combine(pso->hash, desc->as);
+		wi::helper::hash_combine(pso->hash, desc->vs);
+		wi::helper::hash_combine(pso->hash, desc->ps);
+		wi::helper::hash_combine(pso->hash, desc->hs);
+		wi::helper::hash_combine(pso->hash, desc->ds);
+		wi::helper::hash_combine(pso->hash, desc->gs);
+		wi::helper::hash_combine(pso->hash, desc->il);
+		wi::helper::hash_combine(pso->hash, desc->rs);
+		wi::helper::hash_combine(pso->hash, desc->bs);
+		wi::helper::hash_combine(pso->hash, desc->dss);
+		wi::helper::hash_combine(pso->hash, desc->pt);
+		wi::helper::hash_combine(pso->hash, desc->sample_mask);
+		return true;
+	}
+	bool GraphicsDevice_Null::CreateRenderPass(const RenderPassDesc* desc, RenderPass* renderpass) const
+	{
+		renderpass->internal_state = std::make_shared<RenderPass_Null>();
+		renderpass->desc = *desc;
+
+		renderpass->hash = 0;
+		wi::helper::hash_combine(renderpass->hash, desc->attachments.size());
+		for (auto& attachment : desc->attachments)
+		{
+			if (attachment.type == RenderPassAttachment::Type::RENDERTARGET || attachment.type == RenderPassAttachment::Type::DEPTH_STENCIL)
+			{
+				wi::helper::hash_combine(renderpass->hash, attachment.texture->desc.format);
+				wi::helper::hash_combine(renderpass->hash, attachment.texture->desc.sample_count);
+			}
+		}
+		return true;
+	}
+
+	int GraphicsDevice_Null::CreateSubresource(Texture* texture, SubresourceType type, uint32_t firstSlice, uint32_t sliceCount, uint32_t firstMip, uint32_t mipCount, const Format* format_change) const
+	{
+		Resource_Null* internal_state = to_internal(texture);
+		wi::vector<int>& subresources = internal_state->subresources[(int)type];
+		subresources.push_back(allocate_descriptor());
+		return int(subresources.size() - 1);
+	}
+	int GraphicsDevice_Null::CreateSubresource(GPUBuffer* buffer, SubresourceType type, uint64_t offset, uint64_t size, const Format* format_change) const
+	{
+		Resource_Null* internal_state = to_internal(buffer);
+		wi::vector<int>& subresources = internal_state->subresources[(int)type];
+		subresources.push_back(allocate_descriptor());
+		return int(subresources.size() - 1);
+	}
+
+	int GraphicsDevice_Null::GetDescriptorIndex(const GPUResource* resource, SubresourceType type, int subresource) const
+	{
+		if (resource == nullptr || !resource->IsValid())
+			return -1;
+
+		const Resource_Null* internal_state = to_internal(resource);
+		if (subresource < 0)
+		{
+			return internal_state->descriptors[(int)type];
+		}
+		const wi::vector<int>& subresources = internal_state->subresources[(int)type];
+		if (subresource < (int)subresources.size())
+		{
+			return subresources[subresource];
+		}
+		return -1;
+	}
+	int GraphicsDevice_Null::GetDescriptorIndex(const Sampler* sampler) const
+	{
+		if (sampler == nullptr || !sampler->IsValid())
+			return -1;
+
+		return to_internal(sampler)->index;
+	}
+
+	CommandList GraphicsDevice_Null::BeginCommandList(QUEUE_TYPE queue)
+	{
+		cmd_locker.lock();
+		uint32_t cmd_current = cmd_count++;
+		if (cmd_current >= commandlists.size())
+		{
+			commandlists.push_back(std::make_unique<CommandList_Null>());
+		}
+		CommandList cmd;
+		cmd.internal_state = commandlists[cmd_current].get();
+		cmd_locker.unlock();
+
+		CommandList_Null& commandlist = GetCommandList(cmd);
+		commandlist.frame_allocators[GetBufferIndex()].reset();
+		commandlist.queue = queue;
+		commandlist.statistics = {};
+		commandlist.statistics.command_lists = 1;
+
+		return cmd;
+	}
+	void GraphicsDevice_Null::SubmitCommandLists()
+	{
+		Statistics statistics;
+		if (statistics_enabled)
+		{
+			for (uint32_t cmd = 0; cmd < cmd_count; ++cmd)
+			{
+				CommandList_Null& commandlist = *commandlists[cmd];
+				statistics.Add(commandlist.statistics);
+				statistics.bytes_uploaded += commandlist.frame_allocators[GetBufferIndex()].offset;
+			}
+			statistics.buffers_created += buffers_created.exchange(0, std::memory_order_relaxed);
+			statistics.textures_created += textures_created.exchange(0, std::memory_order_relaxed);
+			statistics.bytes_uploaded += bytes_uploaded.exchange(0, std::memory_order_relaxed);
+		}
+		frame_statistics = statistics;
+		total_statistics.Add(statistics);
+
+		cmd_count = 0;
+		FRAMECOUNT++;
+	}
+
+	Texture GraphicsDevice_Null::GetBackBuffer(const SwapChain* swapchain) const
+	{
+		return to_internal(swapchain)->backbuffer;
+	}
+
+	void GraphicsDevice_Null::QueryResolve(const GPUQueryHeap* heap, uint32_t index, uint32_t count, const GPUBuffer* dest, uint64_t dest_offset, CommandList cmd)
+	{
+		if (dest == nullptr || dest->mapped_data == nullptr || dest_offset >= dest->desc.size)
+			return;
+		count = (uint32_t)std::min(uint64_t(count), (dest->desc.size - dest_offset) / sizeof(uint64_t));
+
+		// Timestamps are zero, occlusion queries report every object as visible, so culling doesn't depend on results that were never computed:
+		const uint64_t value = heap->desc.type == GpuQueryType::TIMESTAMP ? 0ull : 1ull;
+		uint64_t* results = (uint64_t*)((uint8_t*)dest->mapped_data + dest_offset);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			results[i] = value;
+		}
+	}
+}
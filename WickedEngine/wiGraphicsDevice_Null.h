@@ -0,0 +1,189 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiGraphicsDevice.h"
+#include "wiVector.h"
+#include "wiSpinLock.h"
+
+#include <atomic>
+#include <memory>
+
+namespace wi::graphics
+{
+	// Graphics device without GPU, it can be used for headless simulation and to benchmark the CPU side of the engine
+	//	Resources that the CPU can access (Usage::UPLOAD and Usage::READBACK) are backed by CPU memory, so their mapped_data is valid
+	//	Other resources are not backed by memory, but they are accounted in GetMemoryUsage()
+	//	Draws, dispatches, copies and every other GPU command are not executed, but they can be counted
+	//	Shaders are not loaded, because the device doesn't consume shader binaries (ShaderFormat::NONE)
+	class GraphicsDevice_Null final : public GraphicsDevice
+	{
+	public:
+		struct Statistics
+		{
+			uint64_t command_lists = 0;
+			uint64_t render_passes = 0;
+			uint64_t draws = 0;				// all draw calls, including indirect and mesh shader draws
+			uint64_t dispatches = 0;		// all dispatches, including indirect dispatches and ray dispatches
+			uint64_t copies = 0;			// CopyResource, CopyBuffer, ClearUAV
+			uint64_t barriers = 0;
+			uint64_t pipeline_binds = 0;	// BindPipelineState, BindComputeShader, BindRaytracingPipelineState
+			uint64_t resource_binds = 0;	// shader resources, UAVs, samplers, constant buffers, vertex and index buffers
+			uint64_t bytes_uploaded = 0;	// initial data of created resources and GPU allocations (UpdateBuffer, dynamic constant buffers...)
+			uint64_t buffers_created = 0;
+			uint64_t textures_created = 0;
+
+			void Add(const Statistics& other);
+		};
+
+	protected:
+		struct CommandList_Null
+		{
+			GPULinearAllocator frame_allocators[BUFFERCOUNT];
+			QUEUE_TYPE queue = QUEUE_GRAPHICS;
+			Statistics statistics;
+		};
+		wi::vector<std::unique_ptr<CommandList_Null>> commandlists;
+		uint32_t cmd_count = 0;
+		wi::SpinLock cmd_locker;
+
+		constexpr CommandList_Null& GetCommandList(CommandList cmd) const
+		{
+			assert(cmd.IsValid());
+			return *(CommandList_Null*)cmd.internal_state;
+		}
+
+		bool statistics_enabled = true;
+		Statistics frame_statistics;
+		Statistics total_statistics;
+		mutable std::atomic<uint64_t> buffers_created{ 0 };
+		mutable std::atomic<uint64_t> textures_created{ 0 };
+		mutable std::atomic<uint64_t> bytes_uploaded{ 0 };
+
+		uint64_t memory_budget = 0;
+		std::shared_ptr<std::atomic<uint64_t>> memory_usage = std::make_shared<std::atomic<uint64_t>>(0); // resources can outlive the device
+		mutable std::atomic<uint32_t> next_descriptor{ 0 };
+
+		int allocate_descriptor() const;
+
+		inline void count(CommandList cmd, uint64_t Statistics::*counter, uint64_t value = 1)
+		{
+			if (statistics_enabled)
+			{
+				GetCommandList(cmd).statistics.*counter += value;
+			}
+		}
+
+	public:
+		// memory_budget: the video memory budget that GetMemoryUsage() reports (in bytes)
+		GraphicsDevice_Null(uint64_t memory_budget = 4ull * 1024ull * 1024ull * 1024ull);
+
+		bool CreateSwapChain(const SwapChainDesc* desc, wi::platform::window_type window, SwapChain* swapchain) const override;
+		bool CreateBuffer(const GPUBufferDesc* desc, const void* initial_data, GPUBuffer* buffer) const override;
+		bool CreateTexture(const TextureDesc* desc, const SubresourceData* initial_data, Texture* texture) const override;
+		bool CreateShader(ShaderStage stage, const void* shadercode, size_t shadercode_size, Shader* shader) const override;
+		bool CreateSampler(const SamplerDesc* desc, Sampler* sampler) const override;
+		bool CreateQueryHeap(const GPUQueryHeapDesc* desc, GPUQueryHeap* queryheap) const override;
+		bool CreatePipelineState(const PipelineStateDesc* desc, PipelineState* pso) const override;
+		bool CreateRenderPass(const RenderPassDesc* desc, RenderPass* renderpass) const override;
+
+		int CreateSubresource(Texture* texture, SubresourceType type, uint32_t firstSlice, uint32_t sliceCount, uint32_t firstMip, uint32_t mipCount, const Format* format_change = nullptr) const override;
+		int CreateSubresource(GPUBuffer* buffer, SubresourceType type, uint64_t offset, uint64_t size = ~0, const Format* format_change = nullptr) const override;
+
+		int GetDescriptorIndex(const GPUResource* resource, SubresourceType type, int subresource = -1) const override;
+		int GetDescriptorIndex(const Sampler* sampler) const override;
+
+		void SetName(GPUResource* pResource, const char* name) override {}
+
+		CommandList BeginCommandList(QUEUE_TYPE queue = QUEUE_GRAPHICS) override;
+		void SubmitCommandLists() override;
+
+		void WaitForGPU() const override {}
+		void ClearPipelineStateCache() override {}
+		size_t GetActivePipelineCount() const override { return 0; }
+
+		ShaderFormat GetShaderFormat() const override { return ShaderFormat::NONE; }
+
+		Texture GetBackBuffer(const SwapChain* swapchain) const override;
+
+		ColorSpace GetSwapChainColorSpace(const SwapChain* swapchain) const override { return ColorSpace::SRGB; }
+		bool IsSwapChainSupportsHDR(const SwapChain* swapchain) const override { return false; }
+
+		uint64_t GetMinOffsetAlignment(const GPUBufferDesc* desc) const override { return 256; }
+
+		MemoryUsage GetMemoryUsage() const override
+		{
+			MemoryUsage retval;
+			retval.budget = memory_budget;
+			retval.usage = memory_usage->load();
+			return retval;
+		}
+
+		uint32_t GetMaxViewportCount() const override { return 16; };
+
+		// Enable/disable counting of commands and uploads (enabled by default)
+		void SetStatisticsEnabled(bool value) { statistics_enabled = value; }
+		bool IsStatisticsEnabled() const { return statistics_enabled; }
+
+		// Returns the statistics of the last SubmitCommandLists()
+		const Statistics& GetFrameStatistics() const { return frame_statistics; }
+
+		// Returns the statistics accumulated since the device was created
+		const Statistics& GetTotalStatistics() const { return total_statistics; }
+
+		///////////////Thread-sensitive////////////////////////
+
+		void WaitCommandList(CommandList cmd, CommandList wait_for) override {}
+		void RenderPassBegin(const SwapChain* swapchain, CommandList cmd) override { count(cmd, &Statistics::render_passes); }
+		void RenderPassBegin(const RenderPass* renderpass, CommandList cmd) override { count(cmd, &Statistics::render_passes); }
+		void RenderPassEnd(CommandList cmd) override {}
+		void BindScissorRects(uint32_t numRects, const Rect* rects, CommandList cmd) override {}
+		void BindViewports(uint32_t NumViewports, const Viewport* pViewports, CommandList cmd) override {}
+		void BindResource(const GPUResource* resource, uint32_t slot, CommandList cmd, int subresource = -1) override { count(cmd, &Statistics::resource_binds); }
+		void BindResources(const GPUResource* const* resources, uint32_t slot, uint32_t count, CommandList cmd) override { this->count(cmd, &Statistics::resource_binds, count); }
+		void BindUAV(const GPUResource* resource, uint32_t slot, CommandList cmd, int subresource = -1) override { count(cmd, &Statistics::resource_binds); }
+		void BindUAVs(const GPUResource* const* resources, uint32_t slot, uint32_t count, CommandList cmd) override { this->count(cmd, &Statistics::resource_binds, count); }
+		void BindSampler(const Sampler* sampler, uint32_t slot, CommandList cmd) override { count(cmd, &Statistics::resource_binds); }
+		void BindConstantBuffer(const GPUBuffer* buffer, uint32_t slot, CommandList cmd, uint64_t offset = 0ull) override { count(cmd, &Statistics::resource_binds); }
+		void BindVertexBuffers(const GPUBuffer* const* vertexBuffers, uint32_t slot, uint32_t count, const uint32_t* strides, const uint64_t* offsets, CommandList cmd) override { this->count(cmd, &Statistics::resource_binds, count); }
+		void BindIndexBuffer(const GPUBuffer* indexBuffer, const IndexBufferFormat format, uint64_t offset, CommandList cmd) override { count(cmd, &Statistics::resource_binds); }
+		void BindStencilRef(uint32_t value, CommandList cmd) override {}
+		void BindBlendFactor(float r, float g, float b, float a, CommandList cmd) override {}
+		void BindShadingRate(ShadingRate rate, CommandList cmd) override {}
+		void BindPipelineState(const PipelineState* pso, CommandList cmd) override { count(cmd, &Statistics::pipeline_binds); }
+		void BindComputeShader(const Shader* cs, CommandList cmd) override { count(cmd, &Statistics::pipeline_binds); }
+		void BindDepthBounds(float min_bounds, float max_bounds, CommandList cmd) override {}
+		void Draw(uint32_t vertexCount, uint32_t startVertexLocation, CommandList cmd) override { count(cmd, &Statistics::draws); }
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndexLocation, int32_t baseVertexLocation, CommandList cmd) override { count(cmd, &Statistics::draws); }
+		void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation, CommandList cmd) override { count(cmd, &Statistics::draws); }
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndexLocation, int32_t baseVertexLocation, uint32_t startInstanceLocation, CommandList cmd) override { count(cmd, &Statistics::draws); }
+		void DrawInstancedIndirect(const GPUBuffer* args, uint64_t args_offset, CommandList cmd) override { count(cmd, &Statistics::draws); }
+		void DrawIndexedInstancedIndirect(const GPUBuffer* args, uint64_t args_offset, CommandList cmd) override { count(cmd, &Statistics::draws); }
+		void DrawInstancedIndirectCount(const GPUBuffer* args, uint64_t args_offset, const GPUBuffer* count, uint64_t count_offset, uint32_t max_count, CommandList cmd) override { this->count(cmd, &Statistics::draws); }
+		void DrawIndexedInstancedIndirectCount(const GPUBuffer* args, uint64_t args_offset, const GPUBuffer* count, uint64_t count_offset, uint32_t max_count, CommandList cmd) override { this->count(cmd, &Statistics::draws); }
+		void Dispatch(uint32_t threadGroupCountX, uint32_t threadGroupCountY, uint32_t threadGroupCountZ, CommandList cmd) override { count(cmd, &Statistics::dispatches); }
+		void DispatchIndirect(const GPUBuffer* args, uint64_t args_offset, CommandList cmd) override { count(cmd, &Statistics::dispatches); }
+		void DispatchMesh(uint32_t threadGroupCountX, uint32_t threadGroupCountY, uint32_t threadGroupCountZ, CommandList cmd) override { count(cmd, &Statistics::draws); }
+		void DispatchMeshIndirect(const GPUBuffer* args, uint64_t args_offset, CommandList cmd) override { count(cmd, &Statistics::draws); }
+		void CopyResource(const GPUResource* pDst, const GPUResource* pSrc, CommandList cmd) override { count(cmd, &Statistics::copies); }
+		void CopyBuffer(const GPUBuffer* pDst, uint64_t dst_offset, const GPUBuffer* pSrc, uint64_t src_offset, uint64_t size, CommandList cmd) override { count(cmd, &Statistics::copies); }
+		void QueryBegin(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override {}
+		void QueryEnd(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override {}
+		void QueryResolve(const GPUQueryHeap* heap, uint32_t index, uint32_t count, const GPUBuffer* dest, uint64_t dest_offset, CommandList cmd) override;
+		void QueryReset(const GPUQueryHeap* heap, uint32_t index, uint32_t count, CommandList cmd) override {}
+		void Barrier(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override { count(cmd, &Statistics::barriers, numBarriers); }
+		void BindRaytracingPipelineState(const RaytracingPipelineState* rtpso, CommandList cmd) override { count(cmd, &Statistics::pipeline_binds); }
+		void DispatchRays(const DispatchRaysDesc* desc, CommandList cmd) override { count(cmd, &Statistics::dispatches); }
+		void PushConstants(const void* data, uint32_t size, CommandList cmd, uint32_t offset = 0) override {}
+		void PredicationBegin(const GPUBuffer* buffer, uint64_t offset, PredicationOp op, CommandList cmd) override {}
+		void PredicationEnd(CommandList cmd) override {}
+		void ClearUAV(const GPUResource* resource, uint32_t value, CommandList cmd) override { count(cmd, &Statistics::copies); }
+
+		void EventBegin(const char* name, CommandList cmd) override {}
+		void EventEnd(CommandList cmd) override {}
+		void SetMarker(const char* name, CommandList cmd) override {}
+
+		GPULinearAllocator& GetFrameAllocator(CommandList cmd) override
+		{
+			return GetCommandList(cmd).frame_allocators[GetBufferIndex()];
+		}
+	};
+}
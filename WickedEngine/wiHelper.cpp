@@ -35,6 +35,10 @@ extern basist::etc1_global_selector_codebook g_basis_global_codebook;
 #endif // PLATFORM_UWP
 #else
 #include "Utility/portable-file-dialogs.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif // _WIN32
 
 
@@ -749,6 +753,63 @@ namespace wi::helper
 	}
 #endif // WI_VECTOR_TYPE
 
+	bool FileMap(const std::string& fileName, MappedFile& mapped_file)
+	{
+		mapped_file = {};
+
+#if defined(_WIN32) && !defined(PLATFORM_UWP)
+		std::wstring wstr;
+		StringConvert(fileName, wstr);
+		HANDLE file = CreateFileW(wstr.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER file_size = {};
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file); // the mapping keeps the file open
+		if (mapping == nullptr)
+			return false;
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping); // the view keeps the mapping alive
+		if (data == nullptr)
+			return false;
+
+		mapped_file.handle = std::shared_ptr<void>(data, [](void* data) { UnmapViewOfFile(data); });
+		mapped_file.data = (const uint8_t*)data;
+		mapped_file.size = (size_t)file_size.QuadPart;
+		return true;
+#elif !defined(_WIN32)
+		std::string filepath = fileName;
+		std::replace(filepath.begin(), filepath.end(), '\\', '/');
+		int file = open(filepath.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+		struct stat file_stat = {};
+		if (fstat(file, &file_stat) != 0 || file_stat.st_size <= 0)
+		{
+			close(file);
+			return false;
+		}
+		const size_t size = (size_t)file_stat.st_size;
+		void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file); // the mapping keeps the file open
+		if (data == MAP_FAILED)
+			return false;
+		madvise(data, size, MADV_SEQUENTIAL);
+
+		mapped_file.handle = std::shared_ptr<void>(data, [size](void* data) { munmap(data, size); });
+		mapped_file.data = (const uint8_t*)data;
+		mapped_file.size = size;
+		return true;
+#else
+		return false;
+#endif // _WIN32
+	}
+
 	bool FileWrite(const std::string& fileName, const uint8_t* data, size_t size)
 	{
 		if (size <= 0)
@@ -5,6 +5,7 @@
 
 #include <string>
 #include <functional>
+#include <memory>
 
 #if WI_VECTOR_TYPE
 namespace std
@@ -88,6 +89,19 @@ namespace wi::helper
 	bool FileRead(const std::string& fileName, std::vector<uint8_t>& data);
 #endif // WI_VECTOR_TYPE
 
+	// Read only view of a file that is mapped into memory instead of being copied
+	//	The mapping is released when the last copy of the MappedFile is destroyed
+	struct MappedFile
+	{
+		std::shared_ptr<void> handle;
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+
+		constexpr bool IsValid() const { return data != nullptr; }
+	};
+	// Map a file into memory for reading. Returns false if the file can't be mapped on this platform, in this case use FileRead() instead
+	bool FileMap(const std::string& fileName, MappedFile& mapped_file);
+
 	bool FileWrite(const std::string& fileName, const uint8_t* data, size_t size);
 
 	bool FileExists(const std::string& fileName);
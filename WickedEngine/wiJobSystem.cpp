@@ -3,14 +3,16 @@
 #include "wiBacklog.h"
 #include "wiPlatform.h"
 #include "wiTimer.h"
+#include "wiTrace.h"
 
 #include <memory>
 #include <algorithm>
-#include <deque>
+#include <cstring>
 #include <string>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <cassert>
 
 #ifdef PLATFORM_LINUX
 #include <pthread.h>
@@ -20,40 +22,137 @@ namespace wi::jobsystem
 {
 	struct Job
 	{
-		std::function<void(JobArgs)> task;
+		JobFunction task;
 		context* ctx;
 		uint32_t groupID;
 		uint32_t groupJobOffset;
 		uint32_t groupJobEnd;
 		uint32_t sharedmemory_size;
+		uint64_t enqueue_time; // nonzero only when tracing
+		const char* trace_label;
 	};
-	struct JobQueue
+
+	// Raw memory of a Job. Jobs are relocated bytewise in and out of the queues,
+	//	so ownership of a job is only taken by the thread that successfully removes it from a queue
+	struct alignas(Job) JobStorage
 	{
+		uint8_t data[sizeof(Job)];
+
+		inline Job& job() { return *std::launder(reinterpret_cast<Job*>(data)); }
+	};
+
+	// Lock-free work stealing deque (Chase-Lev)
+	//	Based on: Le, Pop, Cohen, Nardelli: Correct and Efficient Work-Stealing for Weak Memory Models
+	//	The owner thread pushes and pops at the bottom, any other thread can steal from the top
+	class JobQueue
+	{
+	public:
 		std::atomic_bool processing{ false };
-		std::deque<Job> queue;
-		wi::SpinLock locker;
 
-		inline void push_back(const Job& item)
+		JobQueue()
 		{
-			std::scoped_lock lock(locker);
-			queue.push_back(item);
+			rings.emplace_back(new Ring(256));
+			ring.store(rings.back().get(), std::memory_order_relaxed);
 		}
 
-		inline bool pop_front(Job& item)
+		// Only the owner thread can push
+		//	The job will be moved into the queue
+		inline void push_back(Job&& item)
 		{
-			std::scoped_lock lock(locker);
-			if (queue.empty())
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			Ring* r = ring.load(std::memory_order_relaxed);
+			if (b - t > r->capacity - 1)
 			{
-				processing.store(false);
-				return false;
+				r = grow(r, t, b);
 			}
-			item = std::move(queue.front());
-			queue.pop_front();
-			processing.store(true);
-			return true;
+			new (r->at(b).data) Job(std::move(item));
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		// Only the owner thread can pop, it takes the most recently pushed job
+		inline bool pop_back(JobStorage& item)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			Ring* r = ring.load(std::memory_order_relaxed);
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t <= b)
+			{
+				if (t == b)
+				{
+					// Last item, race against thieves:
+					const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+					bottom.store(b + 1, std::memory_order_relaxed);
+					if (!won)
+						return false;
+				}
+				std::memcpy(item.data, r->at(b).data, sizeof(Job));
+				return true;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
 		}
 
+		// Any thread can steal, it takes the oldest job
+		inline bool steal(JobStorage& item)
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+			if (t < b)
+			{
+				Ring* r = ring.load(std::memory_order_acquire);
+				JobStorage candidate;
+				std::memcpy(candidate.data, r->at(t).data, sizeof(Job));
+				if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					// The copy is only valid (and owned by this thread) if the top could be claimed:
+					std::memcpy(item.data, candidate.data, sizeof(Job));
+					return true;
+				}
+			}
+			return false;
+		}
+
+		inline bool empty() const
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_relaxed);
+			return b <= t;
+		}
+
+	private:
+		struct Ring
+		{
+			int64_t capacity;
+			std::unique_ptr<JobStorage[]> items;
+
+			Ring(int64_t capacity) : capacity(capacity), items(new JobStorage[capacity]) {}
+			inline JobStorage& at(int64_t index) { return items[index & (capacity - 1)]; }
+		};
+
+		inline Ring* grow(Ring* r, int64_t t, int64_t b)
+		{
+			Ring* bigger = new Ring(r->capacity * 2);
+			for (int64_t i = t; i < b; ++i)
+			{
+				std::memcpy(bigger->at(i).data, r->at(i).data, sizeof(Job));
+			}
+			// The old ring is retired but not freed, because thieves might still be reading from it:
+			rings.emplace_back(bigger);
+			ring.store(bigger, std::memory_order_release);
+			return bigger;
+		}
+
+		alignas(64) std::atomic<int64_t> top{ 0 };
+		alignas(64) std::atomic<int64_t> bottom{ 0 };
+		alignas(64) std::atomic<Ring*> ring{ nullptr };
+		wi::vector<std::unique_ptr<Ring>> rings; // only accessed by owner
 	};
+
 	struct WorkerState
 	{
 		std::atomic_bool alive{ true };
@@ -61,13 +160,25 @@ namespace wi::jobsystem
 		std::mutex wakeMutex;
 	};
 
+	// Threads that are not worker threads but submit jobs will get their own queue, up to this amount.
+	//	Any further submitter threads share the overflow queue, which is protected by a lock
+	static constexpr uint32_t MAX_EXTERNAL_QUEUES = 32;
+	static constexpr uint32_t INVALID_QUEUE = ~0u;
+	static constexpr uint32_t OVERFLOW_QUEUE = ~0u - 1;
+
 	// This structure is responsible to stop worker thread loops.
 	//	Once this is destroyed, worker threads will be woken up and end their loops.
 	struct InternalState
 	{
 		uint32_t numCores = 0;
 		uint32_t numThreads = 0;
-		std::unique_ptr<JobQueue[]> jobQueuePerThread;
+		uint32_t numQueues = 0; // worker queues first, then external queues
+		std::unique_ptr<JobQueue[]> jobQueues;
+		std::atomic<uint32_t> registeredQueues{ 0 };
+		wi::vector<uint32_t> freeExternalQueues; // queues of external threads that exited, they can be reused by new threads
+		wi::SpinLock freeExternalQueuesLocker;
+		JobQueue overflowQueue;
+		wi::SpinLock overflowLocker;
 		std::shared_ptr<WorkerState> worker_state = std::make_shared<WorkerState>(); // kept alive by both threads and internal_state
 		std::atomic<uint32_t> nextQueue{ 0 };
 		~InternalState()
@@ -77,7 +188,7 @@ namespace wi::jobsystem
 			// wait until all currently running jobs finish:
 			for (uint32_t i = 0; i < numThreads; ++i)
 			{
-				while (jobQueuePerThread[i].processing.load())
+				while (jobQueues[i].processing.load())
 				{
 					std::this_thread::yield();
 				}
@@ -85,41 +196,152 @@ namespace wi::jobsystem
 		}
 	} static internal_state;
 
-	// Start working on a job queue
-	//	After the job queue is finished, it can switch to an other queue and steal jobs from there
-	inline void work(uint32_t startingQueue)
+	// The queue that is owned by the current thread
+	thread_local uint32_t current_queue = INVALID_QUEUE;
+
+	// Gives back the queue of an external thread when the thread exits. Jobs that are still in the queue can be stolen,
+	//	and the thread that gets the queue next takes over the ownership of them
+	struct ExternalQueueRelease
 	{
-		Job job;
-		for (uint32_t i = 0; i < internal_state.numThreads; ++i)
+		uint32_t queue = INVALID_QUEUE;
+		~ExternalQueueRelease()
 		{
-			JobQueue& job_queue = internal_state.jobQueuePerThread[startingQueue % internal_state.numThreads];
-			while (job_queue.pop_front(job))
+			if (queue != INVALID_QUEUE)
 			{
-				JobArgs args;
-				args.groupID = job.groupID;
-				if (job.sharedmemory_size > 0)
-				{
-					thread_local static wi::vector<uint8_t> shared_allocation_data;
-					shared_allocation_data.reserve(job.sharedmemory_size);
-					args.sharedmemory = shared_allocation_data.data();
-				}
-				else
-				{
-					args.sharedmemory = nullptr;
-				}
+				std::scoped_lock lock(internal_state.freeExternalQueuesLocker);
+				internal_state.freeExternalQueues.push_back(queue);
+			}
+		}
+	};
+	thread_local ExternalQueueRelease external_queue_release;
 
-				for (uint32_t i = job.groupJobOffset; i < job.groupJobEnd; ++i)
-				{
-					args.jobIndex = i;
-					args.groupIndex = i - job.groupJobOffset;
-					args.isFirstJobInGroup = (i == job.groupJobOffset);
-					args.isLastJobInGroup = (i == job.groupJobEnd - 1);
-					job.task(args);
-				}
+	// Returns the queue that the current thread can push into, registers a new one for external threads if needed
+	inline uint32_t get_submission_queue()
+	{
+		if (current_queue == INVALID_QUEUE)
+		{
+			uint32_t index = INVALID_QUEUE;
+			internal_state.freeExternalQueuesLocker.lock();
+			if (!internal_state.freeExternalQueues.empty())
+			{
+				index = internal_state.freeExternalQueues.back();
+				internal_state.freeExternalQueues.pop_back();
+			}
+			internal_state.freeExternalQueuesLocker.unlock();
+			if (index == INVALID_QUEUE)
+			{
+				index = internal_state.registeredQueues.fetch_add(1);
+			}
+			if (index < internal_state.numQueues)
+			{
+				current_queue = index;
+				external_queue_release.queue = index;
+			}
+			else
+			{
+				current_queue = OVERFLOW_QUEUE;
+			}
+		}
+		return current_queue;
+	}
+
+	inline void submit(Job&& job)
+	{
+		const uint32_t queue = get_submission_queue();
+		if (queue == OVERFLOW_QUEUE)
+		{
+			std::scoped_lock lock(internal_state.overflowLocker);
+			internal_state.overflowQueue.push_back(std::move(job));
+		}
+		else
+		{
+			internal_state.jobQueues[queue].push_back(std::move(job));
+		}
+	}
+
+	// Executes a job that the current thread took ownership of
+	inline void execute(JobStorage& storage)
+	{
+		Job& job = storage.job();
+
+		JobArgs args;
+		args.groupID = job.groupID;
+		if (job.sharedmemory_size > 0)
+		{
+			thread_local static wi::vector<uint8_t> shared_allocation_data;
+			shared_allocation_data.reserve(job.sharedmemory_size);
+			args.sharedmemory = shared_allocation_data.data();
+		}
+		else
+		{
+			args.sharedmemory = nullptr;
+		}
+
+		const bool traced = job.enqueue_time > 0;
+		uint64_t trace_begin = 0;
+		const char* prev_trace_label = nullptr;
+		if (traced)
+		{
+			// Jobs submitted from this job will inherit its label:
+			prev_trace_label = wi::trace::SetThreadLabel(job.trace_label);
+			trace_begin = wi::trace::Now();
+		}
+
+		for (uint32_t i = job.groupJobOffset; i < job.groupJobEnd; ++i)
+		{
+			args.jobIndex = i;
+			args.groupIndex = i - job.groupJobOffset;
+			args.isFirstJobInGroup = (i == job.groupJobOffset);
+			args.isLastJobInGroup = (i == job.groupJobEnd - 1);
+			job.task(args);
+		}
+
+		if (traced)
+		{
+			wi::trace::RecordJob(job.trace_label, job.enqueue_time, trace_begin, wi::trace::Now(), job.groupID);
+			wi::trace::SetThreadLabel(prev_trace_label);
+		}
+
+		// The context can be destroyed by its waiter as soon as its counter reaches zero, so the callback is read before that:
+		context* ctx = job.ctx;
+		job.~Job();
+		auto on_jobs_finished = ctx->on_jobs_finished;
+		void* user_data = ctx->user_data;
+		if (ctx->counter.fetch_sub(1) == 1 && on_jobs_finished != nullptr)
+		{
+			on_jobs_finished(user_data);
+		}
+	}
 
-				job.ctx->counter.fetch_sub(1);
+	// Try to take one job: first from the own queue (newest), then steal from other queues (oldest)
+	//	startingQueue: the queue where stealing starts from, this is used to spread out thieves
+	inline bool try_take(uint32_t startingQueue, JobStorage& storage)
+	{
+		const uint32_t own = current_queue;
+		if (own < internal_state.numQueues && internal_state.jobQueues[own].pop_back(storage))
+		{
+			return true;
+		}
+		const uint32_t count = std::min(internal_state.registeredQueues.load(std::memory_order_relaxed), internal_state.numQueues);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint32_t victim = (startingQueue + i) % count;
+			if (victim != own && internal_state.jobQueues[victim].steal(storage))
+			{
+				return true;
 			}
-			startingQueue++; // go to next queue
+		}
+		return internal_state.overflowQueue.steal(storage);
+	}
+
+	// Start working on job queues
+	//	It will keep taking jobs from its own queue and stealing from others until no more jobs can be found
+	inline void work(uint32_t startingQueue)
+	{
+		JobStorage storage;
+		while (try_take(startingQueue, storage))
+		{
+			execute(storage);
 		}
 	}
 
@@ -136,17 +358,24 @@ namespace wi::jobsystem
 
 		// Calculate the actual number of worker threads we want (-1 main thread):
 		internal_state.numThreads = std::min(maxThreadCount, std::max(1u, internal_state.numCores - 1));
-		internal_state.jobQueuePerThread.reset(new JobQueue[internal_state.numThreads]);
+		internal_state.numQueues = internal_state.numThreads + MAX_EXTERNAL_QUEUES;
+		internal_state.jobQueues.reset(new JobQueue[internal_state.numQueues]);
+		internal_state.registeredQueues.store(internal_state.numThreads); // worker queues are reserved up front
 
 		for (uint32_t threadID = 0; threadID < internal_state.numThreads; ++threadID)
 		{
 			std::thread worker([threadID] {
 
 				std::shared_ptr<WorkerState> worker_state = internal_state.worker_state; // this is a copy of shared_ptr<WorkerState>, so it will remain alive for the thread's lifetime
+				current_queue = threadID;
+				wi::trace::SetThreadName("wi::jobsystem_" + std::to_string(threadID));
+				JobQueue& own_queue = internal_state.jobQueues[threadID];
 
 				while (worker_state->alive.load())
 				{
-					work(threadID);
+					own_queue.processing.store(true);
+					work(threadID + 1);
+					own_queue.processing.store(false);
 
 					// finished with jobs, put to sleep
 					std::unique_lock<std::mutex> lock(worker_state->wakeMutex);
@@ -205,7 +434,7 @@ namespace wi::jobsystem
 		return internal_state.numThreads;
 	}
 
-	void Execute(context& ctx, const std::function<void(JobArgs)>& task)
+	void Execute(context& ctx, const JobFunction& task)
 	{
 		// Context state is updated:
 		ctx.counter.fetch_add(1);
@@ -217,12 +446,22 @@ namespace wi::jobsystem
 		job.groupJobOffset = 0;
 		job.groupJobEnd = 1;
 		job.sharedmemory_size = 0;
+		if (wi::trace::IsEnabled())
+		{
+			job.enqueue_time = wi::trace::Now();
+			job.trace_label = wi::trace::GetThreadLabel();
+		}
+		else
+		{
+			job.enqueue_time = 0;
+			job.trace_label = nullptr;
+		}
 
-		internal_state.jobQueuePerThread[internal_state.nextQueue.fetch_add(1) % internal_state.numThreads].push_back(job);
+		submit(std::move(job));
 		internal_state.worker_state->wakeCondition.notify_one();
 	}
 
-	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& task, size_t sharedmemory_size)
+	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const JobFunction& task, size_t sharedmemory_size)
 	{
 		if (jobCount == 0 || groupSize == 0)
 		{
@@ -234,19 +473,28 @@ namespace wi::jobsystem
 		// Context state is updated:
 		ctx.counter.fetch_add(groupCount);
 
-		Job job;
-		job.ctx = &ctx;
-		job.task = task;
-		job.sharedmemory_size = (uint32_t)sharedmemory_size;
+		uint64_t enqueue_time = 0;
+		const char* trace_label = nullptr;
+		if (wi::trace::IsEnabled())
+		{
+			enqueue_time = wi::trace::Now();
+			trace_label = wi::trace::GetThreadLabel();
+		}
 
 		for (uint32_t groupID = 0; groupID < groupCount; ++groupID)
 		{
 			// For each group, generate one real job:
+			Job job;
+			job.ctx = &ctx;
+			job.task = task;
+			job.sharedmemory_size = (uint32_t)sharedmemory_size;
 			job.groupID = groupID;
 			job.groupJobOffset = groupID * groupSize;
 			job.groupJobEnd = std::min(job.groupJobOffset + groupSize, jobCount);
+			job.enqueue_time = enqueue_time;
+			job.trace_label = trace_label;
 
-			internal_state.jobQueuePerThread[internal_state.nextQueue.fetch_add(1) % internal_state.numThreads].push_back(job);
+			submit(std::move(job));
 		}
 
 		internal_state.worker_state->wakeCondition.notify_all();
@@ -271,16 +519,228 @@ namespace wi::jobsystem
 			// Wake any threads that might be sleeping:
 			internal_state.worker_state->wakeCondition.notify_all();
 
-			// work() will pick up any jobs that are on stand by and execute them on this thread:
-			work(internal_state.nextQueue.fetch_add(1) % internal_state.numThreads);
-
+			// Pick up any jobs that are on stand by and execute them on this thread until the context is finished:
+			const uint32_t startingQueue = internal_state.nextQueue.fetch_add(1);
+			JobStorage storage;
+			uint64_t stall_begin = 0; // when tracing, the start of the current period without any job to execute
 			while (IsBusy(ctx))
 			{
-				// If we are here, then there are still remaining jobs that work() couldn't pick up.
-				//	In this case those jobs are not standing by on a queue but currently executing
-				//	on other threads, so they cannot be picked up by this thread.
-				//	Allow to swap out this thread by OS to not spin endlessly for nothing
-				std::this_thread::yield();
+				if (try_take(startingQueue, storage))
+				{
+					if (stall_begin > 0)
+					{
+						wi::trace::RecordWait(stall_begin, wi::trace::Now());
+						stall_begin = 0;
+					}
+					execute(storage);
+				}
+				else
+				{
+					if (stall_begin == 0 && wi::trace::IsEnabled())
+					{
+						stall_begin = wi::trace::Now();
+					}
+					// If we are here, then there are still remaining jobs that couldn't be picked up.
+					//	In this case those jobs are not standing by on a queue but currently executing
+					//	on other threads, so they cannot be picked up by this thread.
+					//	Allow to swap out this thread by OS to not spin endlessly for nothing
+					std::this_thread::yield();
+				}
+			}
+			if (stall_begin > 0)
+			{
+				wi::trace::RecordWait(stall_begin, wi::trace::Now());
+			}
+		}
+	}
+
+	TaskGraph::Task TaskGraph::Add(const JobFunction& task, std::initializer_list<Task> predecessors)
+	{
+		const Task index = (Task)nodes.size();
+		Node& node = nodes.emplace_back();
+		node.task = task;
+		for (Task predecessor : predecessors)
+		{
+			Precede(predecessor, index);
+		}
+		return index;
+	}
+
+	TaskGraph::Task TaskGraph::AddDispatch(uint32_t jobCount, uint32_t groupSize, const JobFunction& task, size_t sharedmemory_size, std::initializer_list<Task> predecessors)
+	{
+		const Task index = Add(task, predecessors);
+		Node& node = nodes[index];
+		node.dispatch = true;
+		node.jobCount = jobCount;
+		node.groupSize = std::max(1u, groupSize);
+		node.sharedmemory_size = (uint32_t)sharedmemory_size;
+		return index;
+	}
+
+	TaskGraph::Task TaskGraph::AddSpawn(const std::function<void(context& ctx)>& task, std::initializer_list<Task> predecessors)
+	{
+		const Task index = Add(JobFunction(), predecessors);
+		nodes[index].spawn = task;
+		return index;
+	}
+
+	void TaskGraph::Precede(Task before, Task after)
+	{
+		assert(before < nodes.size());
+		assert(after < nodes.size());
+		assert(before != after);
+		nodes[before].successors.push_back(after);
+		nodes[after].predecessor_count++;
+	}
+
+	void TaskGraph::Submit(context& ctx)
+	{
+		if (nodes.empty())
+			return;
+
+		if (state_capacity < nodes.size())
+		{
+			state_capacity = nodes.size() * 2;
+			pending.reset(new std::atomic<uint32_t>[state_capacity]);
+			remaining_groups.reset(new std::atomic<uint32_t>[state_capacity]);
+			spawn_states.reset(new SpawnState[state_capacity]);
+		}
+
+#ifdef _DEBUG
+		// Check that the graph has no cycles, otherwise some tasks would never start:
+		{
+			wi::vector<uint32_t> counts(nodes.size());
+			wi::vector<Task> ready;
+			for (size_t i = 0; i < nodes.size(); ++i)
+			{
+				counts[i] = nodes[i].predecessor_count;
+				if (counts[i] == 0)
+				{
+					ready.push_back((Task)i);
+				}
+			}
+			size_t visited = 0;
+			while (!ready.empty())
+			{
+				Task task = ready.back();
+				ready.pop_back();
+				visited++;
+				for (Task successor : nodes[task].successors)
+				{
+					if (--counts[successor] == 0)
+					{
+						ready.push_back(successor);
+					}
+				}
+			}
+			assert(visited == nodes.size());
+		}
+#endif // _DEBUG
+
+		this->ctx = &ctx;
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			const Node& node = nodes[i];
+			pending[i].store(node.predecessor_count, std::memory_order_relaxed);
+			remaining_groups[i].store(node.dispatch ? DispatchGroupCount(node.jobCount, node.groupSize) : 1, std::memory_order_relaxed);
+			if (node.spawn != nullptr)
+			{
+				SpawnState& state = spawn_states[i];
+				state.ctx.on_jobs_finished = spawned_jobs_finished;
+				state.ctx.user_data = &state;
+				state.returned.store(false, std::memory_order_relaxed);
+				state.finished.store(false, std::memory_order_relaxed);
+				state.graph = this;
+				state.task = (Task)i;
+			}
+		}
+
+		// The graph itself holds a reference on the context until all root tasks are launched,
+		//	so that the context can't appear finished while tasks are still being submitted:
+		ctx.counter.fetch_add(1);
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			if (nodes[i].predecessor_count == 0)
+			{
+				launch((Task)i);
+			}
+		}
+		ctx.counter.fetch_sub(1);
+	}
+
+	void TaskGraph::Clear()
+	{
+		nodes.clear();
+	}
+
+	void TaskGraph::launch(Task task)
+	{
+		Node& node = nodes[task];
+		if (node.dispatch)
+		{
+			if (node.jobCount == 0)
+			{
+				finish(task);
+				return;
+			}
+			Dispatch(*ctx, node.jobCount, node.groupSize, [this, task](JobArgs args) {
+				nodes[task].task(args);
+				if (args.isLastJobInGroup && remaining_groups[task].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					finish(task);
+				}
+			}, node.sharedmemory_size);
+		}
+		else if (node.spawn != nullptr)
+		{
+			Execute(*ctx, [this, task](JobArgs args) {
+				// The graph's context is kept busy until the spawned jobs finished, because they are tracked by a different context:
+				ctx->counter.fetch_add(1);
+				SpawnState& state = spawn_states[task];
+				nodes[task].spawn(state.ctx);
+				state.returned.store(true);
+				if (!IsBusy(state.ctx))
+				{
+					finish_spawn(task);
+				}
+			});
+		}
+		else
+		{
+			Execute(*ctx, [this, task](JobArgs args) {
+				nodes[task].task(args);
+				finish(task);
+			});
+		}
+	}
+
+	void TaskGraph::finish_spawn(Task task)
+	{
+		// Both the returning task and the last spawned job can get here, but only one of them finishes it:
+		if (!spawn_states[task].finished.exchange(true))
+		{
+			finish(task);
+			ctx->counter.fetch_sub(1);
+		}
+	}
+
+	void TaskGraph::spawned_jobs_finished(void* user_data)
+	{
+		SpawnState* state = (SpawnState*)user_data;
+		if (state->returned.load())
+		{
+			state->graph->finish_spawn(state->task);
+		}
+	}
+
+	void TaskGraph::finish(Task task)
+	{
+		// Successors are launched while the finishing job still holds its reference on the context:
+		for (Task successor : nodes[task].successors)
+		{
+			if (pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				launch(successor);
 			}
 		}
 	}
@@ -1,7 +1,16 @@
 #pragma once
+#include "wiVector.h"
 
 #include <functional>
 #include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <memory>
+#include <initializer_list>
 
 namespace wi::jobsystem
 {
@@ -17,22 +26,153 @@ namespace wi::jobsystem
 		void* sharedmemory;		// stack memory shared within the current group (jobs within a group execute serially)
 	};
 
+	// Callable that is stored by jobs
+	//	Small trivially copyable callables (for example lambdas capturing by reference or capturing pointers) are stored inline without heap allocation
+	//	Other callables (for example std::function or lambdas capturing containers by value) are stored in a reference counted heap allocation
+	//	Copies of a heap stored callable share the same instance, so the jobs of a Dispatch() call it concurrently from multiple threads
+	class JobFunction
+	{
+	public:
+		static constexpr size_t inline_capacity = 48;
+
+		JobFunction() = default;
+
+		template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, JobFunction>>>
+		JobFunction(F&& func)
+		{
+			using T = std::decay_t<F>;
+			if constexpr (
+				sizeof(T) <= inline_capacity &&
+				alignof(T) <= alignof(std::max_align_t) &&
+				std::is_trivially_copyable_v<T> &&
+				std::is_trivially_destructible_v<T>
+				)
+			{
+				new (storage) T(std::forward<F>(func));
+				invoker = [](void* storage, const JobArgs& args) { (*std::launder(reinterpret_cast<T*>(storage)))(args); };
+			}
+			else
+			{
+				heap = new HeapFunction<T>(std::forward<F>(func));
+			}
+		}
+		JobFunction(const JobFunction& other)
+		{
+			copy_from(other);
+		}
+		JobFunction(JobFunction&& other) noexcept
+		{
+			std::memcpy(storage, other.storage, sizeof(storage));
+			invoker = other.invoker;
+			heap = other.heap;
+			other.invoker = nullptr;
+			other.heap = nullptr;
+		}
+		JobFunction& operator=(const JobFunction& other)
+		{
+			if (this != &other)
+			{
+				release();
+				copy_from(other);
+			}
+			return *this;
+		}
+		JobFunction& operator=(JobFunction&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				std::memcpy(storage, other.storage, sizeof(storage));
+				invoker = other.invoker;
+				heap = other.heap;
+				other.invoker = nullptr;
+				other.heap = nullptr;
+			}
+			return *this;
+		}
+		~JobFunction()
+		{
+			release();
+		}
+
+		inline void operator()(const JobArgs& args)
+		{
+			if (heap != nullptr)
+			{
+				heap->invoke(args);
+			}
+			else
+			{
+				invoker(storage, args);
+			}
+		}
+		inline bool IsValid() const { return invoker != nullptr || heap != nullptr; }
+		inline bool IsInline() const { return invoker != nullptr; }
+
+	private:
+		struct HeapFunctionBase
+		{
+			std::atomic<uint32_t> refcount{ 1 };
+			virtual ~HeapFunctionBase() = default;
+			virtual void invoke(const JobArgs& args) = 0;
+		};
+		template<typename T>
+		struct HeapFunction final : public HeapFunctionBase
+		{
+			T func;
+			template<typename F>
+			HeapFunction(F&& func) : func(std::forward<F>(func)) {}
+			void invoke(const JobArgs& args) override { func(args); }
+		};
+
+		alignas(std::max_align_t) uint8_t storage[inline_capacity];
+		void(*invoker)(void* storage, const JobArgs& args) = nullptr;
+		HeapFunctionBase* heap = nullptr;
+
+		inline void copy_from(const JobFunction& other)
+		{
+			std::memcpy(storage, other.storage, sizeof(storage));
+			invoker = other.invoker;
+			heap = other.heap;
+			if (heap != nullptr)
+			{
+				heap->refcount.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		inline void release()
+		{
+			if (heap != nullptr && heap->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				delete heap;
+			}
+			heap = nullptr;
+			invoker = nullptr;
+		}
+	};
+
 	uint32_t GetThreadCount();
 
 	// Defines a state of execution, can be waited on
 	struct context
 	{
 		std::atomic<uint32_t> counter{ 0 };
+
+		// Optional, it is called by the thread that finished the last job of the context
+		//	The context must stay alive after its jobs finished, so this can't be used with contexts that are waited on the stack
+		void(*on_jobs_finished)(void* user_data) = nullptr;
+		void* user_data = nullptr;
 	};
 
 	// Add a task to execute asynchronously. Any idle thread will execute this.
-	void Execute(context& ctx, const std::function<void(JobArgs)>& task);
+	void Execute(context& ctx, const JobFunction& task);
 
 	// Divide a task onto multiple jobs and execute in parallel.
 	//	jobCount	: how many jobs to generate for this task.
 	//	groupSize	: how many jobs to execute per thread. Jobs inside a group execute serially. It might be worth to increase for small jobs
 	//	task		: receives a JobArgs as parameter
-	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& task, size_t sharedmemory_size = 0);
+	//				  The task is shared by every job group. If it's stored on the heap (see JobFunction), the groups call the same instance,
+	//				  so its captured state must not be modified by the jobs (for example by a mutable lambda), unless it is synchronized
+	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const JobFunction& task, size_t sharedmemory_size = 0);
 
 	// Returns the amount of job groups that will be created for a set number of jobs and group size
 	uint32_t DispatchGroupCount(uint32_t jobCount, uint32_t groupSize);
@@ -43,4 +183,69 @@ namespace wi::jobsystem
 	// Wait until all threads become idle
 	//	Current thread will become a worker thread, executing jobs
 	void Wait(const context& ctx);
+
+	// Set of tasks with dependencies between them that can be submitted to the job system at once
+	//	A task starts as soon as all of its predecessors finished, so independent chains of tasks overlap instead of waiting on each other
+	//	The graph can be built once and submitted any number of times, but it must be kept alive and unmodified while it is executing
+	class TaskGraph
+	{
+	public:
+		using Task = uint32_t;
+
+		// Add a task that executes as one job
+		//	predecessors	: tasks that must finish before this task can start
+		Task Add(const JobFunction& task, std::initializer_list<Task> predecessors = {});
+
+		// Add a task that is divided onto multiple jobs like with Dispatch(). Successors can start after all jobs of this task finished
+		Task AddDispatch(uint32_t jobCount, uint32_t groupSize, const JobFunction& task, size_t sharedmemory_size = 0, std::initializer_list<Task> predecessors = {});
+
+		// Add a task that spawns its own jobs into the context that it receives, for example with a job count that is only known when it runs
+		//	Successors can start after the task returned and all of its spawned jobs finished, so the task doesn't need to wait for them
+		//	The task can still Wait() on the context, if its jobs need to finish in multiple phases
+		Task AddSpawn(const std::function<void(context& ctx)>& task, std::initializer_list<Task> predecessors = {});
+
+		// Declare that task "after" can only start when task "before" finished
+		void Precede(Task before, Task after);
+
+		// Start executing the graph. Use Wait(ctx) to wait until all tasks finished
+		void Submit(context& ctx);
+
+		// Remove all tasks. The graph must not be executing
+		void Clear();
+
+		inline size_t GetTaskCount() const { return nodes.size(); }
+		inline bool IsEmpty() const { return nodes.empty(); }
+
+	private:
+		struct Node
+		{
+			JobFunction task;
+			std::function<void(context& ctx)> spawn;
+			uint32_t jobCount = 1;
+			uint32_t groupSize = 1;
+			uint32_t sharedmemory_size = 0;
+			bool dispatch = false;
+			uint32_t predecessor_count = 0;
+			wi::vector<Task> successors;
+		};
+		struct SpawnState
+		{
+			context ctx; // the jobs that the task spawned
+			std::atomic_bool returned{ false };
+			std::atomic_bool finished{ false };
+			TaskGraph* graph = nullptr;
+			Task task = 0;
+		};
+		wi::vector<Node> nodes;
+		std::unique_ptr<std::atomic<uint32_t>[]> pending; // remaining predecessors per task while executing
+		std::unique_ptr<std::atomic<uint32_t>[]> remaining_groups; // remaining job groups per task while executing
+		std::unique_ptr<SpawnState[]> spawn_states; // per task while executing, only used by spawning tasks
+		size_t state_capacity = 0;
+		context* ctx = nullptr;
+
+		void launch(Task task);
+		void finish(Task task);
+		void finish_spawn(Task task);
+		static void spawned_jobs_finished(void* user_data);
+	};
 }
@@ -437,3 +437,222 @@ namespace wi::math
 	}
 
 }
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WI_COMPOSE_TRANSFORMS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define WI_TARGET_AVX2
+#else
+#define WI_TARGET_AVX2 __attribute__((target("avx2")))
+#endif // _MSC_VER
+#endif // x86
+
+namespace wi::math
+{
+	// One element of ComposeTransforms(), it is used for the remainder elements that don't fill a SIMD batch:
+	static inline void ComposeTransform(const TransformArrays& transforms, XMFLOAT4X4& matrix, size_t i)
+	{
+		const float x = transforms.rotation_x[i];
+		const float y = transforms.rotation_y[i];
+		const float z = transforms.rotation_z[i];
+		const float w = transforms.rotation_w[i];
+		const float sx = transforms.scale_x[i];
+		const float sy = transforms.scale_y[i];
+		const float sz = transforms.scale_z[i];
+		const float xx = x * x, yy = y * y, zz = z * z;
+		const float xy = x * y, xz = x * z, yz = y * z;
+		const float wx = w * x, wy = w * y, wz = w * z;
+		matrix = XMFLOAT4X4(
+			sx * (1 - 2 * (yy + zz)), sx * (2 * (xy + wz)), sx * (2 * (xz - wy)), 0,
+			sy * (2 * (xy - wz)), sy * (1 - 2 * (xx + zz)), sy * (2 * (yz + wx)), 0,
+			sz * (2 * (xz + wy)), sz * (2 * (yz - wx)), sz * (1 - 2 * (xx + yy)), 0,
+			transforms.translation_x[i], transforms.translation_y[i], transforms.translation_z[i], 1
+		);
+	}
+
+#ifdef WI_COMPOSE_TRANSFORMS_X86
+	// The matrix elements are computed for 4 transforms in every register, then transposed to rows of the output matrices
+	static size_t ComposeTransforms_SSE(const TransformArrays& transforms, XMFLOAT4X4* const* matrices, size_t count)
+	{
+		const __m128 one = _mm_set1_ps(1);
+		const __m128 two = _mm_set1_ps(2);
+		const __m128 zero = _mm_setzero_ps();
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(transforms.rotation_x + i);
+			const __m128 y = _mm_loadu_ps(transforms.rotation_y + i);
+			const __m128 z = _mm_loadu_ps(transforms.rotation_z + i);
+			const __m128 w = _mm_loadu_ps(transforms.rotation_w + i);
+			const __m128 sx = _mm_loadu_ps(transforms.scale_x + i);
+			const __m128 sy = _mm_loadu_ps(transforms.scale_y + i);
+			const __m128 sz = _mm_loadu_ps(transforms.scale_z + i);
+			const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+			__m128 rows[4][4] = {
+				{
+					_mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)))),
+					_mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, wz))),
+					_mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, wy))),
+					zero,
+				},
+				{
+					_mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, wz))),
+					_mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)))),
+					_mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, wx))),
+					zero,
+				},
+				{
+					_mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, wy))),
+					_mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, wx))),
+					_mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)))),
+					zero,
+				},
+				{
+					_mm_loadu_ps(transforms.translation_x + i),
+					_mm_loadu_ps(transforms.translation_y + i),
+					_mm_loadu_ps(transforms.translation_z + i),
+					one,
+				},
+			};
+
+			for (int row = 0; row < 4; ++row)
+			{
+				__m128* r = rows[row];
+				_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					_mm_storeu_ps(&matrices[i + lane]->m[row][0], r[lane]);
+				}
+			}
+		}
+		return i;
+	}
+
+	// Same as the SSE version, but with 8 transforms in every register
+	WI_TARGET_AVX2 static size_t ComposeTransforms_AVX2(const TransformArrays& transforms, XMFLOAT4X4* const* matrices, size_t count)
+	{
+		const __m256 one = _mm256_set1_ps(1);
+		const __m256 two = _mm256_set1_ps(2);
+		const __m256 zero = _mm256_setzero_ps();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(transforms.rotation_x + i);
+			const __m256 y = _mm256_loadu_ps(transforms.rotation_y + i);
+			const __m256 z = _mm256_loadu_ps(transforms.rotation_z + i);
+			const __m256 w = _mm256_loadu_ps(transforms.rotation_w + i);
+			const __m256 sx = _mm256_loadu_ps(transforms.scale_x + i);
+			const __m256 sy = _mm256_loadu_ps(transforms.scale_y + i);
+			const __m256 sz = _mm256_loadu_ps(transforms.scale_z + i);
+			const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+			const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+			const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+			const __m256 rows[4][4] = {
+				{
+					_mm256_mul_ps(sx, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)))),
+					_mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_add_ps(xy, wz))),
+					_mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_sub_ps(xz, wy))),
+					zero,
+				},
+				{
+					_mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_sub_ps(xy, wz))),
+					_mm256_mul_ps(sy, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)))),
+					_mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_add_ps(yz, wx))),
+					zero,
+				},
+				{
+					_mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_add_ps(xz, wy))),
+					_mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_sub_ps(yz, wx))),
+					_mm256_mul_ps(sz, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)))),
+					zero,
+				},
+				{
+					_mm256_loadu_ps(transforms.translation_x + i),
+					_mm256_loadu_ps(transforms.translation_y + i),
+					_mm256_loadu_ps(transforms.translation_z + i),
+					one,
+				},
+			};
+
+			for (int row = 0; row < 4; ++row)
+			{
+				// Transpose within the 128-bit halves, the low halves are rows of the first 4 matrices, the high halves are rows of the last 4:
+				const __m256* r = rows[row];
+				const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+				const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+				const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+				const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+				const __m256 lanes[4] = {
+					_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+					_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+					_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+					_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+				};
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					_mm_storeu_ps(&matrices[i + lane]->m[row][0], _mm256_castps256_ps128(lanes[lane]));
+					_mm_storeu_ps(&matrices[i + lane + 4]->m[row][0], _mm256_extractf128_ps(lanes[lane], 1));
+				}
+			}
+		}
+		return i;
+	}
+
+	static bool CheckAVX2Support()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx)
+			return false;
+		if ((_xgetbv(0) & 0x6) != 0x6)
+			return false; // the OS doesn't save the YMM registers
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif // _MSC_VER
+	}
+	static const bool avx2_supported = CheckAVX2Support();
+#endif // WI_COMPOSE_TRANSFORMS_X86
+
+	void ComposeTransforms(const TransformArrays& transforms, XMFLOAT4X4* const* matrices, size_t count)
+	{
+		size_t i = 0;
+#ifdef WI_COMPOSE_TRANSFORMS_X86
+		if (avx2_supported)
+		{
+			i = ComposeTransforms_AVX2(transforms, matrices, count);
+		}
+		else
+		{
+			i = ComposeTransforms_SSE(transforms, matrices, count);
+		}
+#endif // WI_COMPOSE_TRANSFORMS_X86
+		for (; i < count; ++i)
+		{
+			ComposeTransform(transforms, *matrices[i], i);
+		}
+	}
+
+	bool IsComposeTransformsAVX2()
+	{
+#ifdef WI_COMPOSE_TRANSFORMS_X86
+		return avx2_supported;
+#else
+		return false;
+#endif // WI_COMPOSE_TRANSFORMS_X86
+	}
+}
@@ -261,6 +261,27 @@ namespace wi::math
 	// Returns an element of a precomputed halton sequence. Specify which iteration to get with idx >= 0
 	const XMFLOAT4& GetHaltonSequence(int idx);
 
+	// Scale, rotation quaternion and translation arrays in structure of arrays layout
+	struct TransformArrays
+	{
+		const float* scale_x = nullptr;
+		const float* scale_y = nullptr;
+		const float* scale_z = nullptr;
+		const float* rotation_x = nullptr;
+		const float* rotation_y = nullptr;
+		const float* rotation_z = nullptr;
+		const float* rotation_w = nullptr;
+		const float* translation_x = nullptr;
+		const float* translation_y = nullptr;
+		const float* translation_z = nullptr;
+	};
+	// Compose matrices from structure of arrays transforms, like XMMatrixScalingFromVector(S) * XMMatrixRotationQuaternion(R) * XMMatrixTranslationFromVector(T)
+	//	matrices	: matrices[i] receives the matrix of element i
+	//	It is computing 8 matrices at once with AVX2 or 4 matrices at once with SSE, selected by the CPU at runtime
+	void ComposeTransforms(const TransformArrays& transforms, XMFLOAT4X4* const* matrices, size_t count);
+	// Returns true if ComposeTransforms() is using AVX2
+	bool IsComposeTransformsAVX2();
+
 	inline uint32_t CompressNormal(const XMFLOAT3& normal)
 	{
 		uint32_t retval = 0;
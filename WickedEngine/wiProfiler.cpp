@@ -7,6 +7,7 @@
 #include "wiHelper.h"
 #include "wiUnorderedMap.h"
 #include "wiBacklog.h"
+#include "wiTrace.h"
 
 #if __has_include("Superluminal/PerformanceAPI_capi.h")
 #include "Superluminal/PerformanceAPI_capi.h"
@@ -18,6 +19,12 @@
 #include <mutex>
 #include <atomic>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <unordered_set>
+#include <functional>
+#include <cmath>
 
 using namespace wi::graphics;
 
@@ -25,7 +32,7 @@ namespace wi::profiler
 {
 	bool ENABLED = false;
 	bool ENABLED_REQUEST = false;
-	bool initialized = false;
+	bool initialized = false; // GPU resources
 	std::mutex lock;
 	range_id cpu_frame;
 	range_id gpu_frame;
@@ -34,11 +41,19 @@ namespace wi::profiler
 	std::atomic<uint32_t> nextQuery{ 0 };
 	int queryheap_idx = 0;
 
+	// Returned for CPU ranges that are only recorded by wi::trace because the profiler is disabled
+	static constexpr range_id trace_range = ~0ull;
+
+	// CPU range ids have this bit set, and contain the thread index and the nesting depth of the range
+	static constexpr range_id cpu_range_tag = 1ull << 63;
+
 #if PERFORMANCEAPI_ENABLED
 	PerformanceAPI_ModuleHandle superluminal_handle = {};
 	PerformanceAPI_Functions superluminal_functions = {};
+	bool superluminal_loaded = false;
 #endif // PERFORMANCEAPI_ENABLED
 
+	// GPU range
 	struct Range
 	{
 		bool in_use = false;
@@ -48,34 +63,285 @@ namespace wi::profiler
 		float time = 0;
 		CommandList cmd;
 
-		wi::Timer cpuTimer;
-
 		int gpuBegin[arraysize(queryResultBuffer)];
 		int gpuEnd[arraysize(queryResultBuffer)];
-
-		bool IsCPURange() const { return !cmd.IsValid(); }
 	};
 	wi::unordered_map<size_t, Range> ranges;
 
+	// CPU ranges are recorded by each thread into its own buffer without locking,
+	//	and the buffers are collected into the statistics at the end of the frame
+	namespace cpu_internal
+	{
+		// A finished CPU range
+		struct Record
+		{
+			const char* name;
+			size_t path; // hash of the names of the range and its enclosing ranges on the same thread
+			size_t parent_path;
+			uint64_t duration; // nanoseconds
+			uint32_t depth;
+		};
+
+		// Single producer (the owner thread), single consumer (EndFrame) ring buffer
+		struct RecordQueue
+		{
+			static constexpr uint32_t capacity = 4096;
+			Record records[capacity];
+			alignas(64) std::atomic<uint32_t> head{ 0 }; // written by producer
+			alignas(64) std::atomic<uint32_t> tail{ 0 }; // written by consumer
+			std::atomic<uint32_t> dropped{ 0 };
+
+			inline void push(const Record& record)
+			{
+				const uint32_t h = head.load(std::memory_order_relaxed);
+				const uint32_t t = tail.load(std::memory_order_acquire);
+				if (h - t >= capacity)
+				{
+					dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				records[h % capacity] = record;
+				head.store(h + 1, std::memory_order_release);
+			}
+
+			template<typename F>
+			inline void consume(F&& func)
+			{
+				const uint32_t t = tail.load(std::memory_order_relaxed);
+				const uint32_t h = head.load(std::memory_order_acquire);
+				for (uint32_t i = t; i != h; ++i)
+				{
+					func(records[i % capacity]);
+				}
+				tail.store(h, std::memory_order_release);
+			}
+		};
+
+		// Statistics of the ranges with the same path, collected from every thread
+		struct RangeData
+		{
+			const char* name = nullptr;
+			size_t parent_path = 0;
+			uint32_t depth = 0;
+			float frame_time = 0; // sum of the current frame
+			uint32_t frame_hits = 0;
+			struct Sample
+			{
+				uint64_t frame;
+				float time;
+				uint32_t hits;
+			};
+			wi::vector<Sample> samples; // ring buffer indexed by frame, the size is the statistics window
+		};
+		std::mutex stats_locker;
+		wi::unordered_map<size_t, RangeData> stats;
+		uint32_t window = 120;
+		uint64_t frame_index = 0;
+		uint32_t dropped_records = 0;
+
+		// Adds a finished range to the current frame of the statistics, stats_locker must be locked
+		void accumulate(const Record& record)
+		{
+			RangeData& data = stats[record.path];
+			data.name = record.name;
+			data.parent_path = record.parent_path;
+			data.depth = record.depth;
+			data.frame_time += float(double(record.duration) / 1000000.0);
+			data.frame_hits++;
+		}
+
+		struct ThreadState;
+		std::mutex threads_locker; // only locked when threads start/exit and when collecting
+		wi::vector<ThreadState*> threads;
+		std::atomic<uint32_t> next_thread_index{ 0 };
+
+		// Names are copied, so that the records don't depend on the lifetime of the strings that were given
+		//	The set is node based, so the copies don't move
+		std::mutex names_locker;
+		std::unordered_set<std::string> names;
+
+		struct ThreadState
+		{
+			struct Name
+			{
+				const char* name;
+				size_t hash;
+			};
+			struct ActiveRange
+			{
+				Name name;
+				size_t path;
+				uint64_t begin;
+				bool traced;
+			};
+			wi::vector<ActiveRange> stack;
+			wi::unordered_map<const char*, Name> name_cache;
+			std::unique_ptr<RecordQueue> queue = std::make_unique<RecordQueue>();
+			uint32_t index = 0;
+
+			ThreadState()
+			{
+				index = next_thread_index.fetch_add(1);
+				std::scoped_lock lck(threads_locker);
+				threads.push_back(this);
+			}
+			~ThreadState()
+			{
+				// Ranges that were not collected yet are added to the current frame, so that short lived threads are also measured:
+				std::scoped_lock lck(threads_locker, stats_locker);
+				queue->consume(accumulate);
+				for (auto& x : threads)
+				{
+					if (x == this)
+					{
+						x = threads.back();
+						threads.pop_back();
+						break;
+					}
+				}
+			}
+
+			// Only locks the first time that a name is seen from an address by this thread
+			Name intern(const char* str)
+			{
+				auto it = name_cache.find(str);
+				if (it != name_cache.end() && std::strcmp(it->second.name, str) == 0)
+				{
+					return it->second;
+				}
+				Name result;
+				{
+					std::scoped_lock lck(names_locker);
+					result.name = names.insert(str).first->c_str();
+				}
+				result.hash = wi::helper::string_hash(result.name);
+				name_cache[str] = result;
+				return result;
+			}
+		};
+		thread_local ThreadState thread_state;
+
+		std::string export_filename;
+		uint32_t export_interval = 0;
+
+		// Moves the finished ranges of every thread into the statistics of the current frame
+		void collect()
+		{
+			std::scoped_lock lck(threads_locker, stats_locker);
+			for (auto& thread : threads)
+			{
+				thread->queue->consume(accumulate);
+				dropped_records += thread->queue->dropped.exchange(0, std::memory_order_relaxed);
+			}
+			for (auto& x : stats)
+			{
+				RangeData& data = x.second;
+				if (data.frame_hits == 0)
+					continue;
+				if (data.samples.size() != window)
+				{
+					data.samples.clear();
+					data.samples.resize(window, { ~0ull, 0, 0 });
+				}
+				data.samples[frame_index % window] = { frame_index, data.frame_time, data.frame_hits };
+				data.frame_time = 0;
+				data.frame_hits = 0;
+			}
+			frame_index++;
+		}
+
+		void clear()
+		{
+			std::scoped_lock lck(threads_locker, stats_locker);
+			for (auto& thread : threads)
+			{
+				thread->queue->consume([](const Record&) {});
+				thread->queue->dropped.store(0);
+			}
+			stats.clear();
+			dropped_records = 0;
+		}
+
+		// JSON strings escape quotes, backslashes and control characters:
+		void write_json_escaped(std::string& out, const std::string& str)
+		{
+			for (char c : str)
+			{
+				switch (c)
+				{
+				case '"': out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\t': out += "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20)
+					{
+						char buf[8];
+						snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+						out += buf;
+					}
+					else
+					{
+						out += c;
+					}
+					break;
+				}
+			}
+		}
+		// CSV fields are quoted, and quotes inside them are doubled (RFC 4180):
+		void write_csv_escaped(std::string& out, const std::string& str)
+		{
+			out += '"';
+			for (char c : str)
+			{
+				if (c == '"')
+				{
+					out += '"';
+				}
+				out += c;
+			}
+			out += '"';
+		}
+	}
+	using namespace cpu_internal;
+
 	void BeginFrame()
 	{
 		if (ENABLED_REQUEST != ENABLED)
 		{
 			ranges.clear();
+			cpu_internal::clear();
 			ENABLED = ENABLED_REQUEST;
 		}
 
 		if (!ENABLED)
 			return;
 
+#if PERFORMANCEAPI_ENABLED
+		if (!superluminal_loaded)
+		{
+			superluminal_loaded = true;
+			superluminal_handle = PerformanceAPI_LoadFrom(L"PerformanceAPI.dll", &superluminal_functions);
+			if (superluminal_handle)
+			{
+				wi::backlog::post("[wi::profiler] Superluminal Performance API loaded");
+			}
+		}
+#endif // PERFORMANCEAPI_ENABLED
+
+		cpu_frame = BeginRangeCPU("CPU Frame");
+
+		// Without graphics device, only CPU ranges are profiled:
+		GraphicsDevice* device = wi::graphics::GetDevice();
+		if (device == nullptr)
+			return;
+
 		if (!initialized)
 		{
 			initialized = true;
 
 			ranges.reserve(100);
 
-			GraphicsDevice* device = wi::graphics::GetDevice();
-
 			GPUQueryHeapDesc desc;
 			desc.type = GpuQueryType::TIMESTAMP;
 			desc.query_count = 1024;
@@ -91,19 +357,8 @@ namespace wi::profiler
 				success = device->CreateBuffer(&bd, nullptr, &queryResultBuffer[i]);
 				assert(success);
 			}
-
-#if PERFORMANCEAPI_ENABLED
-			superluminal_handle = PerformanceAPI_LoadFrom(L"PerformanceAPI.dll", &superluminal_functions);
-			if (superluminal_handle)
-			{
-				wi::backlog::post("[wi::profiler] Superluminal Performance API loaded");
-			}
-#endif // PERFORMANCEAPI_ENABLED
 		}
 
-		cpu_frame = BeginRangeCPU("CPU Frame");
-
-		GraphicsDevice* device = wi::graphics::GetDevice();
 		CommandList cmd = device->BeginCommandList();
 
 		device->QueryReset(
@@ -117,7 +372,18 @@ namespace wi::profiler
 	}
 	void EndFrame(CommandList cmd)
 	{
-		if (!ENABLED || !initialized)
+		if (!ENABLED)
+			return;
+
+		EndRange(cpu_frame);
+		collect();
+
+		if (export_interval > 0 && frame_index % export_interval == 0)
+		{
+			ExportStatistics(export_filename);
+		}
+
+		if (!initialized || !cmd.IsValid())
 			return;
 
 		GraphicsDevice* device = wi::graphics::GetDevice();
@@ -127,8 +393,6 @@ namespace wi::profiler
 		gpu_range.gpuEnd[queryheap_idx] = nextQuery.fetch_add(1);
 		device->QueryEnd(&queryHeap, gpu_range.gpuEnd[queryheap_idx], cmd);
 
-		EndRange(cpu_frame);
-
 		double gpu_frequency = (double)device->GetTimestampFrequency() / 1000.0;
 
 		device->QueryResolve(
@@ -148,19 +412,16 @@ namespace wi::profiler
 		{
 			auto& range = x.second;
 
-			if (!range.IsCPURange())
+			int begin_query = range.gpuBegin[queryheap_idx];
+			int end_query = range.gpuEnd[queryheap_idx];
+			if (queryResultBuffer[queryheap_idx].mapped_data != nullptr && begin_query >= 0 && end_query >= 0)
 			{
-				int begin_query = range.gpuBegin[queryheap_idx];
-				int end_query = range.gpuEnd[queryheap_idx];
-				if (queryResultBuffer[queryheap_idx].mapped_data != nullptr && begin_query >= 0 && end_query >= 0)
-				{
-					uint64_t begin_result = queryResults[begin_query];
-					uint64_t end_result = queryResults[end_query];
-					range.time = (float)abs((double)(end_result - begin_result) / gpu_frequency);
-				}
-				range.gpuBegin[queryheap_idx] = -1;
-				range.gpuEnd[queryheap_idx] = -1;
+				uint64_t begin_result = queryResults[begin_query];
+				uint64_t end_result = queryResults[end_query];
+				range.time = (float)abs((double)(end_result - begin_result) / gpu_frequency);
 			}
+			range.gpuBegin[queryheap_idx] = -1;
+			range.gpuEnd[queryheap_idx] = -1;
 			range.times[range.avg_counter++ % arraysize(range.times)] = range.time;
 
 			if (range.avg_counter > arraysize(range.times))
@@ -179,8 +440,10 @@ namespace wi::profiler
 
 	range_id BeginRangeCPU(const char* name)
 	{
-		if (!ENABLED || !initialized)
-			return 0;
+		const bool traced = wi::trace::BeginRange(name);
+
+		if (!ENABLED)
+			return traced ? trace_range : 0;
 
 #if PERFORMANCEAPI_ENABLED
 		if (superluminal_handle)
@@ -189,22 +452,15 @@ namespace wi::profiler
 		}
 #endif // PERFORMANCEAPI_ENABLED
 
-		range_id id = wi::helper::string_hash(name);
-
-		lock.lock();
-
-		// If one range name is hit multiple times, differentiate between them!
-		size_t differentiator = 0;
-		while (ranges[id].in_use)
-		{
-			wi::helper::hash_combine(id, differentiator++);
-		}
-		ranges[id].in_use = true;
-		ranges[id].name = name;
-		ranges[id].cpuTimer.record();
-
-		lock.unlock();
-
+		ThreadState& state = thread_state;
+		ThreadState::ActiveRange range;
+		range.name = state.intern(name);
+		range.path = state.stack.empty() ? 0 : state.stack.back().path;
+		wi::helper::hash_combine(range.path, range.name.hash);
+		range.traced = traced;
+		range.begin = wi::trace::Now();
+		const range_id id = cpu_range_tag | (range_id(state.index) << 32) | range_id(state.stack.size());
+		state.stack.push_back(range);
 		return id;
 	}
 	range_id BeginRangeGPU(const char* name, CommandList cmd)
@@ -212,7 +468,7 @@ namespace wi::profiler
 		if (!ENABLED || !initialized)
 			return 0;
 
-		range_id id = wi::helper::string_hash(name);
+		range_id id = wi::helper::string_hash(name) & ~cpu_range_tag;
 
 		lock.lock();
 
@@ -221,6 +477,7 @@ namespace wi::profiler
 		while (ranges[id].in_use)
 		{
 			wi::helper::hash_combine(id, differentiator++);
+			id &= ~cpu_range_tag;
 		}
 		ranges[id].in_use = true;
 		ranges[id].name = name;
@@ -235,6 +492,48 @@ namespace wi::profiler
 	}
 	void EndRange(range_id id)
 	{
+		if (id == trace_range)
+		{
+			wi::trace::EndRange();
+			return;
+		}
+
+		if (id & cpu_range_tag)
+		{
+			const uint64_t end = wi::trace::Now();
+			ThreadState& state = thread_state;
+
+			// CPU ranges must be ended on the same thread that started them, in reverse order:
+			assert(uint32_t((id >> 32) & 0x7FFFFFFF) == state.index);
+			assert(uint32_t(id) + 1 == state.stack.size());
+			if (state.stack.empty())
+				return;
+
+			const ThreadState::ActiveRange range = state.stack.back();
+			state.stack.pop_back();
+
+			Record record;
+			record.name = range.name.name;
+			record.path = range.path;
+			record.parent_path = state.stack.empty() ? 0 : state.stack.back().path;
+			record.duration = end - range.begin;
+			record.depth = (uint32_t)state.stack.size();
+			state.queue->push(record);
+
+			if (range.traced)
+			{
+				wi::trace::EndRange();
+			}
+
+#if PERFORMANCEAPI_ENABLED
+			if (superluminal_handle)
+			{
+				superluminal_functions.EndEvent();
+			}
+#endif // PERFORMANCEAPI_ENABLED
+			return;
+		}
+
 		if (!ENABLED || !initialized)
 			return;
 
@@ -243,29 +542,148 @@ namespace wi::profiler
 		auto it = ranges.find(id);
 		if (it != ranges.end())
 		{
-			if (it->second.IsCPURange())
-			{
-				it->second.time = (float)it->second.cpuTimer.elapsed();
+			ranges[id].gpuEnd[queryheap_idx] = nextQuery.fetch_add(1);
+			wi::graphics::GetDevice()->QueryEnd(&queryHeap, it->second.gpuEnd[queryheap_idx], it->second.cmd);
+		}
+		else
+		{
+			assert(0);
+		}
 
-#if PERFORMANCEAPI_ENABLED
-				if (superluminal_handle)
+		lock.unlock();
+	}
+
+	wi::vector<RangeStatistics> GetStatistics()
+	{
+		wi::vector<RangeStatistics> result;
+		wi::unordered_map<size_t, std::string> paths;
+
+		std::scoped_lock lck(stats_locker);
+
+		// The path of a range is built from its parents, they are always visited before their children:
+		std::function<const std::string&(size_t)> get_path = [&](size_t path) -> const std::string& {
+			auto it = paths.find(path);
+			if (it != paths.end())
+				return it->second;
+			const RangeData& data = stats.find(path)->second;
+			std::string str = data.parent_path == 0 || stats.find(data.parent_path) == stats.end() ? std::string() : get_path(data.parent_path) + "/";
+			str += data.name == nullptr ? "" : data.name;
+			return paths[path] = std::move(str);
+		};
+
+		wi::vector<float> times;
+		for (auto& x : stats)
+		{
+			const RangeData& data = x.second;
+			times.clear();
+			uint32_t hits = 0;
+			for (auto& sample : data.samples)
+			{
+				if (sample.frame < frame_index && sample.frame + window >= frame_index)
 				{
-					superluminal_functions.EndEvent();
+					times.push_back(sample.time);
+					hits += sample.hits;
 				}
-#endif // PERFORMANCEAPI_ENABLED
 			}
-			else
+			if (times.empty())
+				continue;
+
+			RangeStatistics& stat = result.emplace_back();
+			stat.name = data.name;
+			stat.path = get_path(x.first);
+			stat.depth = data.depth;
+			stat.frame_count = (uint32_t)times.size();
+			stat.hits = float(hits) / float(times.size());
+			stat.min = times[0];
+			stat.max = times[0];
+			float sum = 0;
+			for (float time : times)
 			{
-				ranges[id].gpuEnd[queryheap_idx] = nextQuery.fetch_add(1);
-				wi::graphics::GetDevice()->QueryEnd(&queryHeap, it->second.gpuEnd[queryheap_idx], it->second.cmd);
+				stat.min = std::min(stat.min, time);
+				stat.max = std::max(stat.max, time);
+				sum += time;
 			}
+			stat.avg = sum / float(times.size());
+			const size_t p99 = std::min(times.size() - 1, size_t(std::ceil(times.size() * 0.99f)) - 1);
+			std::nth_element(times.begin(), times.begin() + p99, times.end());
+			stat.p99 = times[p99];
 		}
-		else
+
+		std::sort(result.begin(), result.end(), [](const RangeStatistics& a, const RangeStatistics& b) {
+			return a.path < b.path;
+		});
+		return result;
+	}
+
+	std::string GetStatisticsCSV()
+	{
+		std::stringstream ss;
+		ss.precision(4);
+		ss << "path,name,depth,frames,hits_per_frame,min_ms,avg_ms,max_ms,p99_ms\n";
+		for (auto& x : GetStatistics())
 		{
-			assert(0);
+			std::string path, name;
+			write_csv_escaped(path, x.path);
+			write_csv_escaped(name, x.name);
+			ss << path << "," << name << "," << x.depth << "," << x.frame_count << "," << std::fixed << x.hits << ",";
+			ss << x.min << "," << x.avg << "," << x.max << "," << x.p99 << "\n";
 		}
+		return ss.str();
+	}
 
-		lock.unlock();
+	std::string GetStatisticsJSON()
+	{
+		std::stringstream ss;
+		ss.precision(4);
+		ss << "{\n\"window\": " << window << ",\n\"ranges\": [";
+		bool first = true;
+		for (auto& x : GetStatistics())
+		{
+			std::string path, name;
+			write_json_escaped(path, x.path);
+			write_json_escaped(name, x.name);
+			ss << (first ? "\n" : ",\n");
+			ss << "{\"path\":\"" << path << "\",\"name\":\"" << name << "\",\"depth\":" << x.depth << ",\"frames\":" << x.frame_count;
+			ss << std::fixed << ",\"hits_per_frame\":" << x.hits << ",\"min_ms\":" << x.min << ",\"avg_ms\":" << x.avg << ",\"max_ms\":" << x.max << ",\"p99_ms\":" << x.p99 << "}";
+			first = false;
+		}
+		ss << "\n]\n}\n";
+		return ss.str();
+	}
+
+	bool ExportStatistics(const std::string& filename)
+	{
+		const std::string extension = wi::helper::toUpper(wi::helper::GetExtensionFromFileName(filename));
+		const std::string data = extension == "JSON" ? GetStatisticsJSON() : GetStatisticsCSV();
+		if (!wi::helper::FileWrite(filename, (const uint8_t*)data.data(), data.size()))
+		{
+			wi::backlog::post("wi::profiler::ExportStatistics failed to write file: " + filename, wi::backlog::LogLevel::Error);
+			return false;
+		}
+		return true;
+	}
+
+	void SetPeriodicExport(const std::string& filename, uint32_t frame_interval)
+	{
+		export_filename = filename;
+		export_interval = filename.empty() ? 0 : frame_interval;
+	}
+
+	void SetStatisticsWindow(uint32_t frame_count)
+	{
+		std::scoped_lock lck(stats_locker);
+		window = std::max(1u, frame_count);
+	}
+
+	uint32_t GetStatisticsWindow()
+	{
+		return window;
+	}
+
+	uint32_t GetDroppedRangeCount()
+	{
+		std::scoped_lock lck(stats_locker);
+		return dropped_records;
 	}
 
 	struct Hits
@@ -273,7 +691,6 @@ namespace wi::profiler
 		uint32_t num_hits = 0;
 		float total_time = 0;
 	};
-	wi::unordered_map<std::string, Hits> time_cache_cpu;
 	wi::unordered_map<std::string, Hits> time_cache_gpu;
 	void DrawData(
 		const wi::Canvas& canvas,
@@ -295,36 +712,25 @@ namespace wi::profiler
 
 		for (auto& x : ranges)
 		{
-			if (x.second.IsCPURange())
-			{
-				if (x.first == cpu_frame)
-					continue;
-				time_cache_cpu[x.second.name].num_hits++;
-				time_cache_cpu[x.second.name].total_time += x.second.time;
-			}
-			else
-			{
-				if (x.first == gpu_frame)
-					continue;
-				time_cache_gpu[x.second.name].num_hits++;
-				time_cache_gpu[x.second.name].total_time += x.second.time;
-			}
+			if (x.first == gpu_frame)
+				continue;
+			time_cache_gpu[x.second.name].num_hits++;
+			time_cache_gpu[x.second.name].total_time += x.second.time;
 		}
 
-		// Print CPU ranges:
-		ss << ranges[cpu_frame].name << ": " << std::fixed << ranges[cpu_frame].time << " ms" << std::endl;
-		for (auto& x : time_cache_cpu)
+		// Print CPU ranges, nested ranges are indented, the times are averaged over the statistics window:
+		for (auto& x : GetStatistics())
 		{
-			if (x.second.num_hits > 1)
+			for (uint32_t i = 0; i < x.depth; ++i)
 			{
-				ss << "\t" << x.first << " (" << x.second.num_hits << "x)" << ": " << std::fixed << x.second.total_time << " ms" << std::endl;
+				ss << "\t";
 			}
-			else
+			ss << x.name;
+			if (x.hits > 1)
 			{
-				ss << "\t" << x.first << ": " << std::fixed << x.second.total_time << " ms" << std::endl;
+				ss << " (" << std::fixed << x.hits << "x)";
 			}
-			x.second.num_hits = 0;
-			x.second.total_time = 0;
+			ss << ": " << std::fixed << x.avg << " ms" << std::endl;
 		}
 		ss << std::endl;
 
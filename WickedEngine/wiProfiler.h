@@ -1,18 +1,25 @@
 #pragma once
 #include "wiGraphicsDevice.h"
 #include "wiCanvas.h"
+#include "wiVector.h"
+
+#include <string>
 
 namespace wi::profiler
 {
 	typedef size_t range_id;
 
 	// Begin collecting profiling data for the current frame
+	//	Without graphics device, only CPU ranges are profiled
 	void BeginFrame();
 
 	// Finalize collecting profiling data for the current frame
+	//	cmd can be empty when there is no graphics device
 	void EndFrame(wi::graphics::CommandList cmd);
 
 	// Start a CPU profiling range
+	//	CPU ranges are recorded per thread without locking, they must be ended on the same thread in reverse order that they were started
+	//	Nested ranges are measured separately for each enclosing range
 	range_id BeginRangeCPU(const char* name);
 
 	// Start a GPU profiling range
@@ -34,5 +41,41 @@ namespace wi::profiler
 	void SetEnabled(bool value);
 
 	bool IsEnabled();
+
+	// Statistics of a CPU range over the statistics window. Times are in milliseconds, summed per frame if the range was hit multiple times in a frame
+	struct RangeStatistics
+	{
+		std::string name;
+		std::string path; // names of the enclosing ranges and this range, separated by '/'
+		uint32_t depth = 0; // number of enclosing ranges
+		uint32_t frame_count = 0; // number of frames in the window that the range was hit in
+		float hits = 0; // average number of hits per frame
+		float min = 0;
+		float avg = 0;
+		float max = 0;
+		float p99 = 0; // 99th percentile
+	};
+
+	// Returns the statistics of every CPU range that was hit within the statistics window, sorted by path
+	wi::vector<RangeStatistics> GetStatistics();
+
+	// Returns the statistics as CSV or JSON text
+	std::string GetStatisticsCSV();
+	std::string GetStatisticsJSON();
+
+	// Write the statistics to a file, JSON format if the file extension is .json, otherwise CSV
+	//	returns false if the file couldn't be written
+	bool ExportStatistics(const std::string& filename);
+
+	// Write the statistics to a file every frame_interval frames, while the profiler is enabled
+	//	Set an empty filename or zero interval to stop exporting
+	void SetPeriodicExport(const std::string& filename, uint32_t frame_interval);
+
+	// Set the number of most recent frames that the statistics are computed over (default: 120)
+	void SetStatisticsWindow(uint32_t frame_count);
+	uint32_t GetStatisticsWindow();
+
+	// Returns the number of CPU ranges that were lost because a thread recorded too many ranges in one frame
+	uint32_t GetDroppedRangeCount();
 };
 
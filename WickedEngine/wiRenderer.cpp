@@ -154,93 +154,6 @@ Texture texture_weatherMap;
 // See: https://github.com/turanszkij/WickedEngine/issues/450
 GPUBuffer luminance_dummy;
 
-// Direct reference to a renderable instance:
-struct RenderBatch
-{
-	uint64_t data;
-
-	inline void Create(uint32_t meshIndex, uint32_t instanceIndex, float distance)
-	{
-		// These asserts are a indicating if render queue limits are reached:
-		assert(meshIndex < 0x00FFFFFF);
-		assert(instanceIndex < 0x00FFFFFF);
-
-		data = 0;
-		data |= uint64_t(meshIndex & 0x00FFFFFF) << 40ull;
-		data |= uint64_t(XMConvertFloatToHalf(distance) & 0xFFFF) << 24ull;
-		data |= uint64_t(instanceIndex & 0x00FFFFFF) << 0ull;
-	}
-
-	inline float GetDistance() const
-	{
-		return XMConvertHalfToFloat(HALF((data >> 24ull) & 0xFFFF));
-	}
-	inline uint32_t GetMeshIndex() const
-	{
-		return (data >> 40ull) & 0x00FFFFFF;
-	}
-	inline uint32_t GetInstanceIndex() const
-	{
-		return (data >> 0ull) & 0x00FFFFFF;
-	}
-
-	// opaque sorting
-	//	Priority is set to mesh index to have more instancing
-	//	distance is second priority (front to back Z-buffering)
-	bool operator<(const RenderBatch& other) const
-	{
-		return data < other.data;
-	}
-	// transparent sorting
-	//	Priority is distance for correct alpha blending (back to front rendering)
-	//	mesh index is second priority for instancing
-	bool operator>(const RenderBatch& other) const
-	{
-		// Swap bits of meshIndex and distance to prioritize distance more
-		uint64_t a_data = 0ull;
-		a_data |= ((data >> 24ull) & 0xFFFF) << 48ull; // distance repack
-		a_data |= ((data >> 40ull) & 0x00FFFFFF) << 24ull; // meshIndex repack
-		a_data |= data & 0x00FFFFFF; // instanceIndex repack
-		uint64_t b_data = 0ull;
-		b_data |= ((other.data >> 24ull) & 0xFFFF) << 48ull; // distance repack
-		b_data |= ((other.data >> 40ull) & 0x00FFFFFF) << 24ull; // meshIndex repack
-		b_data |= other.data & 0x00FFFFFF; // instanceIndex repack
-		return a_data > b_data;
-	}
-};
-
-// This is a utility that points to a linear array of render batches:
-struct RenderQueue
-{
-	wi::vector<RenderBatch> batches;
-
-	inline void init()
-	{
-		batches.clear();
-	}
-	inline void add(uint32_t meshIndex, uint32_t instanceIndex, float distance)
-	{
-		batches.emplace_back().Create(meshIndex, instanceIndex, distance);
-	}
-	inline void sort_transparent()
-	{
-		std::sort(batches.begin(), batches.end(), std::greater<RenderBatch>());
-	}
-	inline void sort_opaque()
-	{
-		std::sort(batches.begin(), batches.end(), std::less<RenderBatch>());
-	}
-	inline bool empty() const
-	{
-		return batches.empty();
-	}
-	inline size_t size() const
-	{
-		return batches.size();
-	}
-};
-
-
 const Sampler* GetSampler(SAMPLERTYPES id)
 {
 	return &samplers[id];
@@ -670,6 +583,12 @@ bool LoadShader(
 		shaderbinaryfilename += "." + ext;
 	}
 
+	if (device != nullptr && device->GetShaderFormat() == ShaderFormat::NONE)
+	{
+		// The device doesn't consume shader binaries, for example GraphicsDevice_Null:
+		return device->CreateShader(stage, nullptr, 0, &shader);
+	}
+
 	if (device != nullptr)
 	{
 #ifdef SHADERDUMP_ENABLED
@@ -2448,9 +2367,202 @@ void Workaround(const int bug , CommandList cmd)
 	return;
 }
 
+// Least significant digit radix sort of 64-bit keys in ascending order:
+static constexpr uint32_t RADIX_BITS = 8;
+static constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+static constexpr uint32_t RADIX_MASK = RADIX_SIZE - 1;
+static constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+static constexpr size_t RADIX_PARALLEL_THRESHOLD = 32768; // below this, splitting the work onto threads doesn't pay off
+static constexpr size_t RADIX_PARALLEL_MIN_CHUNK = 8192;
+static void RadixSort(uint64_t* keys, uint64_t* temp, uint32_t count)
+{
+	// The histograms of every digit are counted in a single read:
+	uint32_t histograms[RADIX_PASSES][RADIX_SIZE] = {};
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint64_t key = keys[i];
+		for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+		{
+			histograms[pass][(key >> (pass * RADIX_BITS)) & RADIX_MASK]++;
+		}
+	}
+
+	uint64_t* src = keys;
+	uint64_t* dst = temp;
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		const uint32_t shift = pass * RADIX_BITS;
+		uint32_t* histogram = histograms[pass];
+		if (histogram[(src[0] >> shift) & RADIX_MASK] == count)
+			continue; // every key has the same digit, the pass wouldn't change the order
+
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+		{
+			const uint32_t digit_count = histogram[digit];
+			histogram[digit] = offset;
+			offset += digit_count;
+		}
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint64_t key = src[i];
+			dst[histogram[(key >> shift) & RADIX_MASK]++] = key;
+		}
+		std::swap(src, dst);
+	}
+	if (src != keys)
+	{
+		std::memcpy(keys, src, sizeof(uint64_t) * count);
+	}
+}
+static void RadixSort_Parallel(uint64_t* keys, uint64_t* temp, uint32_t count)
+{
+	// Every chunk of the keys is counted and scattered by a separate job
+	//	The output position of a digit in a chunk is after the same digit in previous chunks, so the sort remains stable
+	struct State
+	{
+		uint64_t* src;
+		uint64_t* dst;
+		uint32_t* histograms; // [chunk][pass][digit]
+		uint32_t count;
+		uint32_t chunk_size;
+		uint32_t pass;
+	} state;
+	const uint32_t chunk_count = std::max(1u, std::min(wi::jobsystem::GetThreadCount(), uint32_t(count / RADIX_PARALLEL_MIN_CHUNK)));
+	state.chunk_size = (count + chunk_count - 1) / chunk_count;
+	state.count = count;
+	state.src = keys;
+	state.dst = temp;
+	const size_t histograms_size = sizeof(uint32_t) * chunk_count * RADIX_PASSES * RADIX_SIZE;
+	state.histograms = (uint32_t*)wi::allocator::AllocateFrame(histograms_size, alignof(uint32_t));
+	std::memset(state.histograms, 0, histograms_size);
+
+	wi::jobsystem::context ctx;
+	wi::jobsystem::Dispatch(ctx, chunk_count, 1, [&state](wi::jobsystem::JobArgs args) {
+		const uint32_t begin = args.jobIndex * state.chunk_size;
+		const uint32_t end = std::min(begin + state.chunk_size, state.count);
+		uint32_t* histograms = state.histograms + args.jobIndex * RADIX_PASSES * RADIX_SIZE;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint64_t key = state.src[i];
+			for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+			{
+				histograms[pass * RADIX_SIZE + ((key >> (pass * RADIX_BITS)) & RADIX_MASK)]++;
+			}
+		}
+	});
+	wi::jobsystem::Wait(ctx);
+
+	// Digit counts of the whole array don't change between passes, so they can decide which passes can be skipped:
+	bool skip[RADIX_PASSES] = {};
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		const uint32_t digit = (keys[0] >> (pass * RADIX_BITS)) & RADIX_MASK;
+		uint32_t digit_count = 0;
+		for (uint32_t chunk = 0; chunk < chunk_count; ++chunk)
+		{
+			digit_count += state.histograms[(chunk * RADIX_PASSES + pass) * RADIX_SIZE + digit];
+		}
+		skip[pass] = digit_count == count;
+	}
+
+	bool histograms_valid = true; // chunk histograms of the first pass are valid, later they must be recounted because chunks contain different keys
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		if (skip[pass])
+			continue;
+		state.pass = pass;
+
+		if (!histograms_valid)
+		{
+			wi::jobsystem::Dispatch(ctx, chunk_count, 1, [&state](wi::jobsystem::JobArgs args) {
+				const uint32_t begin = args.jobIndex * state.chunk_size;
+				const uint32_t end = std::min(begin + state.chunk_size, state.count);
+				const uint32_t shift = state.pass * RADIX_BITS;
+				uint32_t* histogram = state.histograms + (args.jobIndex * RADIX_PASSES + state.pass) * RADIX_SIZE;
+				std::memset(histogram, 0, sizeof(uint32_t) * RADIX_SIZE);
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					histogram[(state.src[i] >> shift) & RADIX_MASK]++;
+				}
+			});
+			wi::jobsystem::Wait(ctx);
+		}
+		histograms_valid = false;
+
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+		{
+			for (uint32_t chunk = 0; chunk < chunk_count; ++chunk)
+			{
+				uint32_t& histogram = state.histograms[(chunk * RADIX_PASSES + pass) * RADIX_SIZE + digit];
+				const uint32_t digit_count = histogram;
+				histogram = offset;
+				offset += digit_count;
+			}
+		}
+
+		wi::jobsystem::Dispatch(ctx, chunk_count, 1, [&state](wi::jobsystem::JobArgs args) {
+			const uint32_t begin = args.jobIndex * state.chunk_size;
+			const uint32_t end = std::min(begin + state.chunk_size, state.count);
+			const uint32_t shift = state.pass * RADIX_BITS;
+			uint32_t* offsets = state.histograms + (args.jobIndex * RADIX_PASSES + state.pass) * RADIX_SIZE;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const uint64_t key = state.src[i];
+				state.dst[offsets[(key >> shift) & RADIX_MASK]++] = key;
+			}
+		});
+		wi::jobsystem::Wait(ctx);
+		std::swap(state.src, state.dst);
+	}
+	if (state.src != keys)
+	{
+		std::memcpy(keys, state.src, sizeof(uint64_t) * count);
+	}
+	wi::allocator::DeallocateFrame(state.histograms, histograms_size);
+}
+void SortRenderBatches(RenderBatch* batches, size_t count, bool transparent, bool allow_parallel)
+{
+	if (count < 2)
+		return;
+	static_assert(sizeof(RenderBatch) == sizeof(uint64_t), "RenderBatch is sorted as an array of its 64-bit data");
+	assert(count < ~0u);
+	uint64_t* keys = &batches[0].data;
+
+	if (transparent)
+	{
+		// Back to front order is the ascending order of the inverted transparent key:
+		for (size_t i = 0; i < count; ++i)
+		{
+			keys[i] = ~batches[i].GetTransparentSortKey();
+		}
+	}
+
+	uint64_t* temp = (uint64_t*)wi::allocator::AllocateFrame(sizeof(uint64_t) * count, alignof(uint64_t));
+	if (allow_parallel && count >= RADIX_PARALLEL_THRESHOLD && wi::jobsystem::GetThreadCount() > 1)
+	{
+		RadixSort_Parallel(keys, temp, (uint32_t)count);
+	}
+	else
+	{
+		RadixSort(keys, temp, (uint32_t)count);
+	}
+	wi::allocator::DeallocateFrame(temp, sizeof(uint64_t) * count);
+
+	if (transparent)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			batches[i].SetFromTransparentSortKey(~keys[i]);
+		}
+	}
+}
+
+template<typename RenderQueueType>
 void RenderMeshes(
 	const Visibility& vis,
-	const RenderQueue& renderQueue,
+	const RenderQueueType& renderQueue,
 	RENDERPASS renderPass,
 	uint32_t renderTypeFlags,
 	CommandList cmd,
@@ -2727,6 +2839,101 @@ void ProcessDeferredMipGenRequests(CommandList cmd)
 	deferredMIPGenLock.unlock();
 }
 
+// Frustum culls the AABBs of a scene component manager and appends the visible indices to the visible list
+//	on_visible	: void(uint32_t index) that is called for every visible item, possibly from multiple threads
+//	When the scene's bounding volume hierarchy is up to date, only the subtrees intersecting the frustum are visited in parallel,
+//	otherwise every AABB is tested
+template<typename OnVisible>
+void CullAABBs(
+	wi::jobsystem::context& ctx,
+	const Visibility& vis,
+	const wi::ecs::ComponentManager<AABB>& aabbs,
+	const wi::BVH& bvh,
+	wi::vector<uint32_t>& visible,
+	std::atomic<uint32_t>& counter,
+	const OnVisible& on_visible
+)
+{
+	static const uint32_t groupSize = 64;
+	const uint32_t count = (uint32_t)aabbs.GetCount();
+	visible.resize(count);
+
+	if (bvh.IsValid() && bvh.item_count == count)
+	{
+		// The visible part of the hierarchy is split into subtrees that are traversed in parallel,
+		//	each job collects its visible items locally and writes them out in batches to global memory:
+		auto node_intersects = [&vis](const AABB& aabb) {
+			return (aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb);
+		};
+		struct Subtrees
+		{
+			uint32_t nodes[64];
+			uint32_t count = 0;
+		} subtrees; // captured by value, because the jobs can outlive this function
+		subtrees.count = bvh.GetSubtrees(node_intersects, subtrees.nodes, arraysize(subtrees.nodes));
+		wi::jobsystem::Dispatch(ctx, subtrees.count, 1, [&aabbs, &bvh, &visible, &counter, on_visible, node_intersects, subtrees](wi::jobsystem::JobArgs args) {
+			uint32_t local_list[groupSize];
+			uint32_t local_count = 0;
+			auto flush = [&] {
+				const uint32_t prev_count = counter.fetch_add(local_count);
+				std::memcpy(visible.data() + prev_count, local_list, local_count * sizeof(uint32_t));
+				local_count = 0;
+			};
+			bvh.Intersects(node_intersects, [&](uint32_t index) {
+				if (node_intersects(aabbs[index]))
+				{
+					on_visible(index);
+					local_list[local_count++] = index;
+					if (local_count == arraysize(local_list))
+					{
+						flush();
+					}
+				}
+			}, subtrees.nodes[args.jobIndex]);
+			if (local_count > 0)
+			{
+				flush();
+			}
+		});
+		return;
+	}
+
+	// The parallel frustum culling is first performed in shared memory, 
+	//	then each group writes out it's local list to global memory
+	//	The shared memory approach reduces atomics and helps the list to remain
+	//	more coherent (less randomly organized compared to original order)
+	static const size_t sharedmemory_size = (groupSize + 1) * sizeof(uint32_t); // list + counter per group
+	wi::jobsystem::Dispatch(ctx, count, groupSize, [&vis, &aabbs, &visible, &counter, on_visible](wi::jobsystem::JobArgs args) {
+
+		// Setup stream compaction:
+		uint32_t& group_count = *(uint32_t*)args.sharedmemory;
+		uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
+		if (args.isFirstJobInGroup)
+		{
+			group_count = 0; // first thread initializes local counter
+		}
+
+		const AABB& aabb = aabbs[args.jobIndex];
+
+		if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+		{
+			// Local stream compaction:
+			group_list[group_count++] = args.jobIndex;
+			on_visible(args.jobIndex);
+		}
+
+		// Global stream compaction:
+		if (args.isLastJobInGroup && group_count > 0)
+		{
+			uint32_t prev_count = counter.fetch_add(group_count);
+			for (uint32_t i = 0; i < group_count; ++i)
+			{
+				visible[prev_count + i] = group_list[i];
+			}
+		}
+
+		}, sharedmemory_size);
+}
 void UpdateVisibility(Visibility& vis)
 {
 	// Perform parallel frustum culling and obtain closest reflector:
@@ -2736,13 +2943,6 @@ void UpdateVisibility(Visibility& vis)
 	assert(vis.scene != nullptr); // User must provide a scene!
 	assert(vis.camera != nullptr); // User must provide a camera!
 
-	// The parallel frustum culling is first performed in shared memory, 
-	//	then each group writes out it's local list to global memory
-	//	The shared memory approach reduces atomics and helps the list to remain
-	//	more coherent (less randomly organized compared to original order)
-	static const uint32_t groupSize = 64;
-	static const size_t sharedmemory_size = (groupSize + 1) * sizeof(uint32_t); // list + counter per group
-
 	// Initialize visible indices:
 	vis.Clear();
 
@@ -2759,162 +2959,77 @@ void UpdateVisibility(Visibility& vis)
 	if (vis.flags & Visibility::ALLOW_LIGHTS)
 	{
 		// Cull lights:
-		vis.visibleLights.resize(vis.scene->aabb_lights.GetCount());
-		wi::jobsystem::Dispatch(ctx, (uint32_t)vis.scene->aabb_lights.GetCount(), groupSize, [&](wi::jobsystem::JobArgs args) {
-
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
+		//	(also compute light distance for shadow priority sorting)
+		CullAABBs(ctx, vis, vis.scene->aabb_lights, vis.scene->light_bvh, vis.visibleLights, vis.light_counter, [&vis](uint32_t index) {
+			const AABB& aabb = vis.scene->aabb_lights[index];
+			const LightComponent& light = vis.scene->lights[index];
+			if (light.IsVolumetricsEnabled())
 			{
-				group_count = 0; // first thread initializes local counter
+				vis.volumetriclight_request.store(true);
 			}
 
-			const AABB& aabb = vis.scene->aabb_lights[args.jobIndex];
-
-			if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+			if (vis.flags & Visibility::ALLOW_OCCLUSION_CULLING)
 			{
-				// Local stream compaction:
-				//	(also compute light distance for shadow priority sorting)
-				group_list[group_count] = args.jobIndex;
-				const LightComponent& light = vis.scene->lights[args.jobIndex];
-				group_count++;
-				if (light.IsVolumetricsEnabled())
+				if (!light.IsStatic() && light.GetType() != LightComponent::DIRECTIONAL || light.occlusionquery < 0)
 				{
-					vis.volumetriclight_request.store(true);
-				}
-
-				if (vis.flags & Visibility::ALLOW_OCCLUSION_CULLING)
-				{
-					if (!light.IsStatic() && light.GetType() != LightComponent::DIRECTIONAL || light.occlusionquery < 0)
+					if (!aabb.intersects(vis.camera->Eye))
 					{
-						if (!aabb.intersects(vis.camera->Eye))
-						{
-							light.occlusionquery = vis.scene->queryAllocator.fetch_add(1); // allocate new occlusion query from heap
-						}
+						light.occlusionquery = vis.scene->queryAllocator.fetch_add(1); // allocate new occlusion query from heap
 					}
 				}
 			}
-
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
-			{
-				uint32_t prev_count = vis.light_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
-				{
-					vis.visibleLights[prev_count + i] = group_list[i];
-				}
-			}
-
-			}, sharedmemory_size);
+			});
 	}
 
 	if (vis.flags & Visibility::ALLOW_OBJECTS)
 	{
 		// Cull objects:
-		vis.visibleObjects.resize(vis.scene->aabb_objects.GetCount());
-		wi::jobsystem::Dispatch(ctx, (uint32_t)vis.scene->aabb_objects.GetCount(), groupSize, [&](wi::jobsystem::JobArgs args) {
+		CullAABBs(ctx, vis, vis.scene->aabb_objects, vis.scene->object_bvh, vis.visibleObjects, vis.object_counter, [&vis](uint32_t index) {
+			const AABB& aabb = vis.scene->aabb_objects[index];
+			const ObjectComponent& object = vis.scene->objects[index];
 
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
+			if (vis.flags & Visibility::ALLOW_REQUEST_REFLECTION)
 			{
-				group_count = 0; // first thread initializes local counter
-			}
-
-			const AABB& aabb = vis.scene->aabb_objects[args.jobIndex];
-
-			if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
-			{
-				// Local stream compaction:
-				group_list[group_count++] = args.jobIndex;
-
-				const ObjectComponent& object = vis.scene->objects[args.jobIndex];
-
-				if (vis.flags & Visibility::ALLOW_REQUEST_REFLECTION)
+				if (object.IsRequestPlanarReflection())
 				{
-					if (object.IsRequestPlanarReflection())
+					float dist = wi::math::DistanceEstimated(vis.camera->Eye, object.center);
+					vis.locker.lock();
+					if (dist < vis.closestRefPlane)
 					{
-						float dist = wi::math::DistanceEstimated(vis.camera->Eye, object.center);
-						vis.locker.lock();
-						if (dist < vis.closestRefPlane)
-						{
-							vis.closestRefPlane = dist;
-							XMVECTOR P = XMLoadFloat3(&object.center);
-							XMVECTOR N = XMVectorSet(0, 1, 0, 0);
-							N = XMVector3TransformNormal(N, XMLoadFloat4x4(&object.worldMatrix));
-							XMVECTOR _refPlane = XMPlaneFromPointNormal(P, N);
-							XMStoreFloat4(&vis.reflectionPlane, _refPlane);
-
-							vis.planar_reflection_visible = true;
-						}
-						vis.locker.unlock();
-					}
-				}
-
-				if (vis.flags & Visibility::ALLOW_OCCLUSION_CULLING)
-				{
-					if (object.IsRenderable() && object.occlusionQueries[vis.scene->queryheap_idx] < 0)
-					{
-						if (aabb.intersects(vis.camera->Eye))
-						{
-							// camera is inside the instance, mark it as visible in this frame:
-							object.occlusionHistory |= 1;
-						}
-						else
-						{
-							object.occlusionQueries[vis.scene->queryheap_idx] = vis.scene->queryAllocator.fetch_add(1); // allocate new occlusion query from heap
-						}
+						vis.closestRefPlane = dist;
+						XMVECTOR P = XMLoadFloat3(&object.center);
+						XMVECTOR N = XMVectorSet(0, 1, 0, 0);
+						N = XMVector3TransformNormal(N, XMLoadFloat4x4(&object.worldMatrix));
+						XMVECTOR _refPlane = XMPlaneFromPointNormal(P, N);
+						XMStoreFloat4(&vis.reflectionPlane, _refPlane);
+
+						vis.planar_reflection_visible = true;
 					}
+					vis.locker.unlock();
 				}
 			}
 
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
+			if (vis.flags & Visibility::ALLOW_OCCLUSION_CULLING)
 			{
-				uint32_t prev_count = vis.object_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
+				if (object.IsRenderable() && object.occlusionQueries[vis.scene->queryheap_idx] < 0)
 				{
-					vis.visibleObjects[prev_count + i] = group_list[i];
+					if (aabb.intersects(vis.camera->Eye))
+					{
+						// camera is inside the instance, mark it as visible in this frame:
+						object.occlusionHistory |= 1;
+					}
+					else
+					{
+						object.occlusionQueries[vis.scene->queryheap_idx] = vis.scene->queryAllocator.fetch_add(1); // allocate new occlusion query from heap
+					}
 				}
 			}
-
-			}, sharedmemory_size);
+			});
 	}
 
 	if (vis.flags & Visibility::ALLOW_DECALS)
 	{
-		vis.visibleDecals.resize(vis.scene->aabb_decals.GetCount());
-		wi::jobsystem::Dispatch(ctx, (uint32_t)vis.scene->aabb_decals.GetCount(), groupSize, [&](wi::jobsystem::JobArgs args) {
-
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
-			{
-				group_count = 0; // first thread initializes local counter
-			}
-
-			const AABB& aabb = vis.scene->aabb_decals[args.jobIndex];
-
-			if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
-			{
-				// Local stream compaction:
-				group_list[group_count++] = args.jobIndex;
-			}
-
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
-			{
-				uint32_t prev_count = vis.decal_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
-				{
-					vis.visibleDecals[prev_count + i] = group_list[i];
-				}
-			}
-
-			}, sharedmemory_size);
+		CullAABBs(ctx, vis, vis.scene->aabb_decals, vis.scene->decal_bvh, vis.visibleDecals, vis.decal_counter, [](uint32_t index) {});
 	}
 
 	if (vis.flags & Visibility::ALLOW_ENVPROBES)
@@ -2983,6 +3098,118 @@ void UpdateVisibility(Visibility& vis)
 	vis.visibleDecals.resize((size_t)vis.decal_counter.load());
 	vis.visibleLights.resize((size_t)vis.light_counter.load());
 
+	// Shadow caster culling for every shadow camera of the visible lights (depends on visible lights):
+	//	This is performed in parallel before rendering, so DrawShadowmaps() only needs to record the commands
+	uint32_t shadow_queue_count = 0;
+	if (vis.flags & Visibility::ALLOW_SHADOWS)
+	{
+		auto range_shadow = wi::profiler::BeginRangeCPU("Shadow Caster Culling");
+
+		BoundingFrustum cam_frustum;
+		BoundingFrustum::CreateFromMatrix(cam_frustum, vis.camera->GetProjection());
+		std::swap(cam_frustum.Near, cam_frustum.Far);
+		cam_frustum.Transform(cam_frustum, vis.camera->GetInvView());
+		XMStoreFloat4(&cam_frustum.Orientation, XMQuaternionNormalize(XMLoadFloat4(&cam_frustum.Orientation)));
+
+		auto add_shadow_queue = [&](uint32_t lightIndex, uint32_t cascade) {
+			if (vis.shadowQueues.size() <= shadow_queue_count)
+			{
+				vis.shadowQueues.emplace_back();
+			}
+			Visibility::ShadowQueue& queue = vis.shadowQueues[shadow_queue_count++];
+			queue.lightIndex = lightIndex;
+			queue.cascade = cascade;
+		};
+
+		for (uint32_t lightIndex : vis.visibleLights)
+		{
+			const LightComponent& light = vis.scene->lights[lightIndex];
+			if (!light.IsCastingShadow() || light.IsStatic())
+				continue;
+
+			switch (light.GetType())
+			{
+			case LightComponent::DIRECTIONAL:
+				for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+				{
+					add_shadow_queue(lightIndex, cascade);
+				}
+				break;
+			case LightComponent::SPOT:
+			{
+				SHCAM shcam;
+				CreateSpotLightShadowCam(light, shcam);
+				if (cam_frustum.Intersects(shcam.boundingfrustum))
+				{
+					add_shadow_queue(lightIndex, 0);
+				}
+			}
+			break;
+			case LightComponent::POINT:
+				add_shadow_queue(lightIndex, 0);
+				break;
+			}
+		}
+
+		wi::jobsystem::Dispatch(ctx, shadow_queue_count, 1, [&](wi::jobsystem::JobArgs args) {
+			Visibility::ShadowQueue& queue = vis.shadowQueues[args.jobIndex];
+			const LightComponent& light = vis.scene->lights[queue.lightIndex];
+			const bool directional = light.GetType() == LightComponent::DIRECTIONAL;
+			queue.renderQueue.init();
+			queue.transparentShadowsRequested = false;
+
+			auto add_caster = [&](uint32_t objectIndex) {
+				const ObjectComponent& object = vis.scene->objects[objectIndex];
+				if (object.IsRenderable() && object.IsCastingShadow() && (!directional || queue.cascade < (CASCADE_COUNT - object.cascadeMask)))
+				{
+					queue.renderQueue.add(object.mesh_index, objectIndex, 0);
+
+					if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
+					{
+						queue.transparentShadowsRequested = true;
+					}
+				}
+			};
+
+			const AABB* aabbs = vis.scene->aabb_objects.GetComponentArray().data();
+			const uint32_t aabb_count = (uint32_t)vis.scene->aabb_objects.GetCount();
+			switch (light.GetType())
+			{
+			case LightComponent::DIRECTIONAL:
+			{
+				SHCAM shcams[CASCADE_COUNT];
+				CreateDirLightShadowCams(light, *vis.camera, shcams, arraysize(shcams));
+				const Frustum& frustum = shcams[queue.cascade].frustum;
+				vis.scene->object_bvh.Query(aabbs, aabb_count, [&](const AABB& aabb) {
+					return (aabb.layerMask & vis.layerMask) && frustum.CheckBoxFast(aabb);
+				}, add_caster);
+			}
+			break;
+			case LightComponent::SPOT:
+			{
+				SHCAM shcam;
+				CreateSpotLightShadowCam(light, shcam);
+				vis.scene->object_bvh.Query(aabbs, aabb_count, [&](const AABB& aabb) {
+					return (aabb.layerMask & vis.layerMask) && shcam.frustum.CheckBoxFast(aabb);
+				}, add_caster);
+			}
+			break;
+			case LightComponent::POINT:
+			{
+				const Sphere boundingsphere(light.position, light.GetRange());
+				vis.scene->object_bvh.Query(aabbs, aabb_count, [&](const AABB& aabb) {
+					return (aabb.layerMask & vis.layerMask) && boundingsphere.intersects(aabb);
+				}, add_caster);
+			}
+			break;
+			}
+			});
+		wi::jobsystem::Wait(ctx);
+
+		wi::profiler::EndRange(range_shadow);
+	}
+	vis.shadowQueues.resize(shadow_queue_count);
+
 	if (vis.scene->weather.IsOceanEnabled())
 	{
 		bool occluded = false;
@@ -4416,7 +4643,7 @@ void DrawSoftParticles(
 
 	// Sort emitters based on distance:
 	assert(emitterCount < 0x0000FFFF); // watch out for sorting hash truncation!
-	static thread_local wi::vector<uint32_t> emitterSortingHashes;
+	wi::allocator::frame_vector<uint32_t> emitterSortingHashes;
 	emitterSortingHashes.resize(emitterCount);
 	for (size_t i = 0; i < emitterCount; ++i)
 	{
@@ -4737,19 +4964,17 @@ void DrawShadowmaps(
 		cam_frustum.Transform(cam_frustum, vis.camera->GetInvView());
 		XMStoreFloat4(&cam_frustum.Orientation, XMQuaternionNormalize(XMLoadFloat4(&cam_frustum.Orientation)));
 
-		static thread_local RenderQueue renderQueue;
-
 		device->RenderPassBegin(&renderpass_shadowMapAtlas, cmd);
 
-		for (uint32_t lightIndex : vis.visibleLights)
+		// Shadow casters were culled for each shadow camera by UpdateVisibility():
+		for (const Visibility::ShadowQueue& queue : vis.shadowQueues)
 		{
-			const LightComponent& light = vis.scene->lights[lightIndex];
-			
-			bool shadow = light.IsCastingShadow() && !light.IsStatic();
-			if (!shadow)
-			{
+			if (queue.renderQueue.empty())
 				continue;
-			}
+
+			const LightComponent& light = vis.scene->lights[queue.lightIndex];
+			const RenderQueue& renderQueue = queue.renderQueue;
+			const bool transparentShadowsRequested = queue.transparentShadowsRequested;
 
 			switch (light.GetType())
 			{
@@ -4757,53 +4982,25 @@ void DrawShadowmaps(
 			{
 				SHCAM shcams[CASCADE_COUNT];
 				CreateDirLightShadowCams(light, *vis.camera, shcams, arraysize(shcams));
+				const uint32_t cascade = queue.cascade;
 
-				for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
-				{
-					renderQueue.init();
-					bool transparentShadowsRequested = false;
-					for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
-					{
-						const AABB& aabb = vis.scene->aabb_objects[i];
-						if ((aabb.layerMask & vis.layerMask) && shcams[cascade].frustum.CheckBoxFast(aabb))
-						{
-							const ObjectComponent& object = vis.scene->objects[i];
-							if (object.IsRenderable() && object.IsCastingShadow() && (cascade < (CASCADE_COUNT - object.cascadeMask)))
-							{
-								Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
-
-								renderQueue.add(object.mesh_index, uint32_t(i), 0);
-
-								if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
-								{
-									transparentShadowsRequested = true;
-								}
-							}
-						}
-					}
+				CameraCB cb;
+				XMStoreFloat4x4(&cb.view_projection, shcams[cascade].view_projection);
+				device->BindDynamicConstantBuffer(cb, CBSLOT_RENDERER_CAMERA, cmd);
 
-					if (!renderQueue.empty())
-					{
-						CameraCB cb;
-						XMStoreFloat4x4(&cb.view_projection, shcams[cascade].view_projection);
-						device->BindDynamicConstantBuffer(cb, CBSLOT_RENDERER_CAMERA, cmd);
-
-						Viewport vp;
-						vp.top_left_x = float(light.shadow_rect.x + cascade * light.shadow_rect.w);
-						vp.top_left_y = float(light.shadow_rect.y);
-						vp.width = float(light.shadow_rect.w);
-						vp.height = float(light.shadow_rect.h);
-						vp.min_depth = 0.0f;
-						vp.max_depth = 1.0f;
-						device->BindViewports(1, &vp, cmd);
-
-						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
-						if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
-						{
-							RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
-						}
-					}
+				Viewport vp;
+				vp.top_left_x = float(light.shadow_rect.x + cascade * light.shadow_rect.w);
+				vp.top_left_y = float(light.shadow_rect.y);
+				vp.width = float(light.shadow_rect.w);
+				vp.height = float(light.shadow_rect.h);
+				vp.min_depth = 0.0f;
+				vp.max_depth = 1.0f;
+				device->BindViewports(1, &vp, cmd);
 
+				RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
+				if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+				{
+					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
 				}
 			}
 			break;
@@ -4811,138 +5008,84 @@ void DrawShadowmaps(
 			{
 				SHCAM shcam;
 				CreateSpotLightShadowCam(light, shcam);
-				if (!cam_frustum.Intersects(shcam.boundingfrustum))
-					break;
 
-				renderQueue.init();
-				bool transparentShadowsRequested = false;
-				for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
-				{
-					const AABB& aabb = vis.scene->aabb_objects[i];
-					if ((aabb.layerMask & vis.layerMask) && shcam.frustum.CheckBoxFast(aabb))
-					{
-						const ObjectComponent& object = vis.scene->objects[i];
-						if (object.IsRenderable() && object.IsCastingShadow())
-						{
-							Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
+				if (predicationRequest && light.occlusionquery >= 0)
+					device->PredicationBegin(
+						&vis.scene->queryPredicationBuffer,
+						(uint64_t)light.occlusionquery * sizeof(uint64_t),
+						PredicationOp::EQUAL_ZERO,
+						cmd
+					);
 
-							renderQueue.add(object.mesh_index, uint32_t(i), 0);
+				CameraCB cb;
+				XMStoreFloat4x4(&cb.view_projection, shcam.view_projection);
+				device->BindDynamicConstantBuffer(cb, CBSLOT_RENDERER_CAMERA, cmd);
 
-							if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
-							{
-								transparentShadowsRequested = true;
-							}
-						}
-					}
-				}
-				if (!renderQueue.empty())
-				{
-					if (predicationRequest && light.occlusionquery >= 0)
-						device->PredicationBegin(
-							&vis.scene->queryPredicationBuffer,
-							(uint64_t)light.occlusionquery * sizeof(uint64_t),
-							PredicationOp::EQUAL_ZERO,
-							cmd
-						);
-
-					CameraCB cb;
-					XMStoreFloat4x4(&cb.view_projection, shcam.view_projection);
-					device->BindDynamicConstantBuffer(cb, CBSLOT_RENDERER_CAMERA, cmd);
-
-					Viewport vp;
-					vp.top_left_x = float(light.shadow_rect.x);
-					vp.top_left_y = float(light.shadow_rect.y);
-					vp.width = float(light.shadow_rect.w);
-					vp.height = float(light.shadow_rect.h);
-					vp.min_depth = 0.0f;
-					vp.max_depth = 1.0f;
-					device->BindViewports(1, &vp, cmd);
-
-					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
-					if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
-					{
-						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
-					}
+				Viewport vp;
+				vp.top_left_x = float(light.shadow_rect.x);
+				vp.top_left_y = float(light.shadow_rect.y);
+				vp.width = float(light.shadow_rect.w);
+				vp.height = float(light.shadow_rect.h);
+				vp.min_depth = 0.0f;
+				vp.max_depth = 1.0f;
+				device->BindViewports(1, &vp, cmd);
 
-					if (predicationRequest && light.occlusionquery >= 0)
-						device->PredicationEnd(cmd);
+				RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
+				if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+				{
+					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
 				}
 
+				if (predicationRequest && light.occlusionquery >= 0)
+					device->PredicationEnd(cmd);
 			}
 			break;
 			case LightComponent::POINT:
 			{
-				Sphere boundingsphere(light.position, light.GetRange());
-
-				renderQueue.init();
-				bool transparentShadowsRequested = false;
-				for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
+				if (predicationRequest && light.occlusionquery >= 0)
+					device->PredicationBegin(
+						&vis.scene->queryPredicationBuffer,
+						(uint64_t)light.occlusionquery * sizeof(uint64_t),
+						PredicationOp::EQUAL_ZERO,
+						cmd
+					);
+
+				const float zNearP = 0.1f;
+				const float zFarP = std::max(1.0f, light.GetRange());
+				SHCAM cameras[6];
+				CreateCubemapCameras(light.position, zNearP, zFarP, cameras, arraysize(cameras));
+				Viewport vp[arraysize(cameras)];
+				Frustum frusta[arraysize(cameras)];
+				uint32_t frustum_count = 0;
+
+				CubemapRenderCB cb;
+				for (uint32_t shcam = 0; shcam < arraysize(cameras); ++shcam)
 				{
-					const AABB& aabb = vis.scene->aabb_objects[i];
-					if ((aabb.layerMask & vis.layerMask) && boundingsphere.intersects(aabb))
+					if (cam_frustum.Intersects(cameras[shcam].boundingfrustum))
 					{
-						const ObjectComponent& object = vis.scene->objects[i];
-						if (object.IsRenderable() && object.IsCastingShadow())
-						{
-							Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
-
-							renderQueue.add(object.mesh_index, uint32_t(i), 0);
-
-							if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
-							{
-								transparentShadowsRequested = true;
-							}
-						}
+						XMStoreFloat4x4(&cb.xCubemapRenderCams[frustum_count].view_projection, cameras[shcam].view_projection);
+						cb.xCubemapRenderCams[frustum_count].properties = uint4(shcam, 0, 0, 0);
+						frusta[frustum_count] = cameras[shcam].frustum;
+						frustum_count++;
 					}
+					vp[shcam].top_left_x = float(light.shadow_rect.x + shcam * light.shadow_rect.w);
+					vp[shcam].top_left_y = float(light.shadow_rect.y);
+					vp[shcam].width = float(light.shadow_rect.w);
+					vp[shcam].height = float(light.shadow_rect.h);
+					vp[shcam].min_depth = 0.0f;
+					vp[shcam].max_depth = 1.0f;
 				}
-				if (!renderQueue.empty())
-				{
-					if (predicationRequest && light.occlusionquery >= 0)
-						device->PredicationBegin(
-							&vis.scene->queryPredicationBuffer,
-							(uint64_t)light.occlusionquery * sizeof(uint64_t),
-							PredicationOp::EQUAL_ZERO,
-							cmd
-						);
+				device->BindDynamicConstantBuffer(cb, CB_GETBINDSLOT(CubemapRenderCB), cmd);
+				device->BindViewports(arraysize(vp), vp, cmd);
 
-					const float zNearP = 0.1f;
-					const float zFarP = std::max(1.0f, light.GetRange());
-					SHCAM cameras[6];
-					CreateCubemapCameras(light.position, zNearP, zFarP, cameras, arraysize(cameras));
-					Viewport vp[arraysize(cameras)];
-					Frustum frusta[arraysize(cameras)];
-					uint32_t frustum_count = 0;
-
-					CubemapRenderCB cb;
-					for (uint32_t shcam = 0; shcam < arraysize(cameras); ++shcam)
-					{
-						if (cam_frustum.Intersects(cameras[shcam].boundingfrustum))
-						{
-							XMStoreFloat4x4(&cb.xCubemapRenderCams[frustum_count].view_projection, cameras[shcam].view_projection);
-							cb.xCubemapRenderCams[frustum_count].properties = uint4(shcam, 0, 0, 0);
-							frusta[frustum_count] = cameras[shcam].frustum;
-							frustum_count++;
-						}
-						vp[shcam].top_left_x = float(light.shadow_rect.x + shcam * light.shadow_rect.w);
-						vp[shcam].top_left_y = float(light.shadow_rect.y);
-						vp[shcam].width = float(light.shadow_rect.w);
-						vp[shcam].height = float(light.shadow_rect.h);
-						vp[shcam].min_depth = 0.0f;
-						vp[shcam].max_depth = 1.0f;
-					}
-					device->BindDynamicConstantBuffer(cb, CB_GETBINDSLOT(CubemapRenderCB), cmd);
-					device->BindViewports(arraysize(vp), vp, cmd);
-
-					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOWCUBE, RENDERTYPE_OPAQUE, cmd, false, frusta, frustum_count);
-					if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
-					{
-						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOWCUBE, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd, false, frusta, frustum_count);
-					}
-
-					if (predicationRequest && light.occlusionquery >= 0)
-						device->PredicationEnd(cmd);
+				RenderMeshes(vis, renderQueue, RENDERPASS_SHADOWCUBE, RENDERTYPE_OPAQUE, cmd, false, frusta, frustum_count);
+				if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+				{
+					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOWCUBE, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd, false, frusta, frustum_count);
 				}
 
+				if (predicationRequest && light.occlusionquery >= 0)
+					device->PredicationEnd(cmd);
 			}
 			break;
 			} // terminate switch
@@ -5014,8 +5157,8 @@ void DrawScene(
 		}
 	}
 
-	static thread_local RenderQueue renderQueue;
-	renderQueue.init();
+	FrameRenderQueue renderQueue;
+	renderQueue.batches.reserve(vis.visibleObjects.size());
 	for (uint32_t instanceIndex : vis.visibleObjects)
 	{
 		const ObjectComponent& object = vis.scene->objects[instanceIndex];
@@ -6146,8 +6289,7 @@ void DrawDebugWorld(
 			DebugTextParams params;
 			float distance;
 		};
-		static thread_local wi::vector<DebugTextSorter> sorted_texts;
-		sorted_texts.clear();
+		wi::allocator::frame_vector<DebugTextSorter> sorted_texts;
 		size_t offset = 0;
 		while(offset < debugTextStorage.size())
 		{
@@ -6455,8 +6597,7 @@ void RefreshEnvProbes(const Visibility& vis, CommandList cmd)
 		{
 			Sphere culler(probe.position, zFarP);
 
-			static thread_local RenderQueue renderQueue;
-			renderQueue.init();
+			FrameRenderQueue renderQueue;
 			for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
 			{
 				const AABB& aabb = vis.scene->aabb_objects[i];
@@ -6710,8 +6851,7 @@ void VoxelRadiance(const Visibility& vis, CommandList cmd)
 	bbox.createFromHalfWidth(center, extents);
 
 
-	static thread_local RenderQueue renderQueue;
-	renderQueue.init();
+	FrameRenderQueue renderQueue;
 	for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
 	{
 		const AABB& aabb = vis.scene->aabb_objects[i];
@@ -10,9 +10,11 @@
 #include "shaders/ShaderInterop_Renderer.h"
 #include "shaders/ShaderInterop_SurfelGI.h"
 #include "wiVector.h"
+#include "wiAllocator.h"
 
 #include <memory>
 #include <limits>
+#include <algorithm>
 
 namespace wi::renderer
 {
@@ -78,6 +80,109 @@ namespace wi::renderer
 	);
 
 
+	// Direct reference to a renderable instance:
+	struct RenderBatch
+	{
+		uint64_t data;
+
+		inline void Create(uint32_t meshIndex, uint32_t instanceIndex, float distance)
+		{
+			// These asserts are a indicating if render queue limits are reached:
+			assert(meshIndex < 0x00FFFFFF);
+			assert(instanceIndex < 0x00FFFFFF);
+
+			data = 0;
+			data |= uint64_t(meshIndex & 0x00FFFFFF) << 40ull;
+			data |= uint64_t(XMConvertFloatToHalf(distance) & 0xFFFF) << 24ull;
+			data |= uint64_t(instanceIndex & 0x00FFFFFF) << 0ull;
+		}
+
+		inline float GetDistance() const
+		{
+			return XMConvertHalfToFloat(HALF((data >> 24ull) & 0xFFFF));
+		}
+		inline uint32_t GetMeshIndex() const
+		{
+			return (data >> 40ull) & 0x00FFFFFF;
+		}
+		inline uint32_t GetInstanceIndex() const
+		{
+			return (data >> 0ull) & 0x00FFFFFF;
+		}
+
+		// opaque sorting
+		//	Priority is set to mesh index to have more instancing
+		//	distance is second priority (front to back Z-buffering)
+		bool operator<(const RenderBatch& other) const
+		{
+			return data < other.data;
+		}
+		// transparent sorting
+		//	Priority is distance for correct alpha blending (back to front rendering)
+		//	mesh index is second priority for instancing
+		bool operator>(const RenderBatch& other) const
+		{
+			return GetTransparentSortKey() > other.GetTransparentSortKey();
+		}
+
+		// Swap bits of meshIndex and distance to prioritize distance more, the transparent order is the descending order of this key
+		inline uint64_t GetTransparentSortKey() const
+		{
+			uint64_t key = 0ull;
+			key |= ((data >> 24ull) & 0xFFFF) << 48ull; // distance repack
+			key |= ((data >> 40ull) & 0x00FFFFFF) << 24ull; // meshIndex repack
+			key |= data & 0x00FFFFFF; // instanceIndex repack
+			return key;
+		}
+		inline void SetFromTransparentSortKey(uint64_t key)
+		{
+			data = 0ull;
+			data |= ((key >> 24ull) & 0x00FFFFFF) << 40ull; // meshIndex unpack
+			data |= ((key >> 48ull) & 0xFFFF) << 24ull; // distance unpack
+			data |= key & 0x00FFFFFF; // instanceIndex unpack
+		}
+	};
+
+	// Sort render batches with radix sort
+	//	transparent		: if true, the order is the same as sorting with operator> (back to front), otherwise the same as with operator< (by mesh, then front to back)
+	//	allow_parallel	: large arrays can be sorted by multiple job system threads. It must not be used by jobs that the job system can't wait for
+	void SortRenderBatches(RenderBatch* batches, size_t count, bool transparent, bool allow_parallel = true);
+
+	// This is a utility that points to a linear array of render batches:
+	template<typename Allocator = std::allocator<RenderBatch>>
+	struct RenderQueueT
+	{
+		wi::vector<RenderBatch, Allocator> batches;
+
+		inline void init()
+		{
+			batches.clear();
+		}
+		inline void add(uint32_t meshIndex, uint32_t instanceIndex, float distance)
+		{
+			batches.emplace_back().Create(meshIndex, instanceIndex, distance);
+		}
+		inline void sort_transparent()
+		{
+			SortRenderBatches(batches.data(), batches.size(), true);
+		}
+		inline void sort_opaque()
+		{
+			SortRenderBatches(batches.data(), batches.size(), false);
+		}
+		inline bool empty() const
+		{
+			return batches.empty();
+		}
+		inline size_t size() const
+		{
+			return batches.size();
+		}
+	};
+	using RenderQueue = RenderQueueT<>;
+	// Render queue that allocates from the per thread frame allocator, it must not be kept after the frame ended
+	using FrameRenderQueue = RenderQueueT<wi::allocator::FrameAllocator<RenderBatch>>;
+
 	struct Visibility
 	{
 		// User fills these:
@@ -95,6 +200,7 @@ namespace wi::renderer
 			ALLOW_HAIRS = 1 << 5,
 			ALLOW_REQUEST_REFLECTION = 1 << 6,
 			ALLOW_OCCLUSION_CULLING = 1 << 7,
+			ALLOW_SHADOWS = 1 << 8, // cull shadow casters for the shadow cameras of visible lights
 
 			ALLOW_EVERYTHING = ~0u
 		};
@@ -109,6 +215,16 @@ namespace wi::renderer
 		wi::vector<uint32_t> visibleHairs;
 		wi::vector<uint32_t> visibleLights;
 
+		// Shadow casters of one shadow camera of a visible light, consumed by DrawShadowmaps():
+		struct ShadowQueue
+		{
+			uint32_t lightIndex = 0;
+			uint32_t cascade = 0; // cascade index for directional lights
+			bool transparentShadowsRequested = false;
+			RenderQueue renderQueue;
+		};
+		wi::vector<ShadowQueue> shadowQueues;
+
 		std::atomic<uint32_t> object_counter;
 		std::atomic<uint32_t> light_counter;
 		std::atomic<uint32_t> decal_counter;
@@ -215,6 +331,7 @@ namespace wi::renderer
 	// Draw shadow maps for each visible light that has associated shadow maps
 	void DrawSun(wi::graphics::CommandList cmd);
 	// Draw shadow maps for each visible light that has associated shadow maps
+	//	The shadow casters are culled by UpdateVisibility() when the Visibility::ALLOW_SHADOWS flag is set
 	void DrawShadowmaps(
 		const Visibility& vis,
 		wi::graphics::CommandList cmd
@@ -13,6 +13,12 @@ extern basist::etc1_global_selector_codebook g_basis_global_codebook;
 
 #include <algorithm>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <cstdlib>
 
 using namespace wi::graphics;
 
@@ -20,24 +26,61 @@ namespace wi
 {
 	struct ResourceInternal
 	{
+		enum class State
+		{
+			READY,
+			LOADING,
+			FAILED,
+		};
+		std::atomic<State> state{ State::READY }; // the contents must not be accessed by other threads while loading
+		std::atomic<int> priority{ 0 }; // priority of the async load request
+
 		resourcemanager::Flags flags = resourcemanager::Flags::NONE;
 		wi::graphics::Texture texture;
 		wi::audio::Sound sound;
 		wi::vector<uint8_t> filedata;
+
+		// Completion callbacks of async load requests, protected by the resource manager lock:
+		wi::vector<std::function<void(const Resource& resource, bool success)>> callbacks;
+
+		// Memory used by the contents, this is included in the totals of the resource manager:
+		size_t memory_usage[(size_t)resourcemanager::MemoryType::COUNT] = {};
+		void UpdateMemoryUsage();
+		~ResourceInternal();
 	};
 
+	bool Resource::IsReady() const
+	{
+		const ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
+		return resourceinternal != nullptr && resourceinternal->state.load(std::memory_order_acquire) == ResourceInternal::State::READY;
+	}
+	bool Resource::IsLoading() const
+	{
+		const ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
+		return resourceinternal != nullptr && resourceinternal->state.load(std::memory_order_acquire) == ResourceInternal::State::LOADING;
+	}
+
 	const wi::vector<uint8_t>& Resource::GetFileData() const
 	{
+		static const wi::vector<uint8_t> empty;
+		if (!IsReady())
+			return empty;
 		const ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
 		return resourceinternal->filedata;
 	}
 	const wi::graphics::Texture& Resource::GetTexture() const
 	{
+		static const wi::graphics::Texture empty;
+		if (!IsReady())
+			return empty;
 		const ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
 		return resourceinternal->texture;
 	}
 	const wi::audio::Sound& Resource::GetSound() const
 	{
+		static const wi::audio::Sound empty;
+		if (!IsReady())
+			return empty;
 		const ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
 		return resourceinternal->sound;
 	}
@@ -50,6 +93,7 @@ namespace wi
 		}
 		ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
 		resourceinternal->filedata = data;
+		resourceinternal->UpdateMemoryUsage();
 	}
 	void Resource::SetFileData(wi::vector<uint8_t>&& data)
 	{
@@ -59,6 +103,7 @@ namespace wi
 		}
 		ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
 		resourceinternal->filedata = data;
+		resourceinternal->UpdateMemoryUsage();
 	}
 	void Resource::SetTexture(const wi::graphics::Texture& texture)
 	{
@@ -68,6 +113,7 @@ namespace wi
 		}
 		ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
 		resourceinternal->texture = texture;
+		resourceinternal->UpdateMemoryUsage();
 	}
 	void Resource::SetSound(const wi::audio::Sound& sound)
 	{
@@ -77,14 +123,64 @@ namespace wi
 		}
 		ResourceInternal* resourceinternal = (ResourceInternal*)internal_state.get();
 		resourceinternal->sound = sound;
+		resourceinternal->UpdateMemoryUsage();
 	}
 
 	namespace resourcemanager
 	{
 		static std::mutex locker;
+		static std::condition_variable loading_finished; // signaled with locker when a resource finished loading
 		static wi::unordered_map<std::string, std::weak_ptr<ResourceInternal>> resources;
 		static Mode mode = Mode::DISCARD_FILEDATA_AFTER_LOAD;
 
+		static std::atomic<size_t> total_memory_usage[(size_t)MemoryType::COUNT] = {};
+		static std::atomic<size_t> memory_budget[(size_t)MemoryType::COUNT] = { ~size_t(0), ~size_t(0), ~size_t(0) };
+
+		// Resources that are not referenced anymore, in the order they were released (least recently used first):
+		//	This has its own lock, because resources can be released while the resource manager lock is held
+		struct CacheEntry
+		{
+			std::string name;
+			std::shared_ptr<ResourceInternal> resource;
+			std::chrono::steady_clock::time_point release_time;
+		};
+		struct Cache
+		{
+			std::mutex locker;
+			std::list<CacheEntry> entries;
+			wi::unordered_map<std::string, std::list<CacheEntry>::iterator> lookup;
+		};
+		// The cache is intentionally leaked, because static resources can be released after the statics of this file were destroyed
+		static Cache& GetCache()
+		{
+			static Cache* cache = new Cache;
+			return *cache;
+		}
+		static std::atomic<float> cache_duration{ 0 };
+
+		static size_t ComputeTextureMemorySize(const TextureDesc& desc)
+		{
+			const uint32_t block_size = GetFormatBlockSize(desc.format);
+			const uint32_t stride = GetFormatStride(desc.format);
+			size_t size = 0;
+			for (uint32_t mip = 0; mip < desc.mip_levels; ++mip)
+			{
+				const uint32_t width = std::max(1u, desc.width >> mip);
+				const uint32_t height = std::max(1u, desc.height >> mip);
+				const uint32_t depth = std::max(1u, desc.depth >> mip);
+				size += size_t((width + block_size - 1) / block_size) * size_t((height + block_size - 1) / block_size) * depth * stride;
+			}
+			return size * desc.array_size * desc.sample_count;
+		}
+
+		static void AddMemoryUsage(const size_t(&usage)[(size_t)MemoryType::COUNT], const size_t(&prev_usage)[(size_t)MemoryType::COUNT])
+		{
+			for (size_t i = 0; i < (size_t)MemoryType::COUNT; ++i)
+			{
+				total_memory_usage[i].fetch_add(usage[i] - prev_usage[i], std::memory_order_relaxed); // unsigned wrap around subtracts when the usage shrinks
+			}
+		}
+
 		void SetMode(Mode param)
 		{
 			mode = param;
@@ -137,44 +233,14 @@ namespace wi
 			return ret;
 		}
 
-		Resource Load(const std::string& name, Flags flags, const uint8_t* filedata, size_t filesize)
+		// Loads the contents of a resource that is not accessible by other threads yet
+		static bool LoadResource(ResourceInternal* resource, const std::string& name, Flags flags, const uint8_t* filedata, size_t filesize)
 		{
-			if (mode == Mode::DISCARD_FILEDATA_AFTER_LOAD)
-			{
-				flags &= ~Flags::IMPORT_RETAIN_FILEDATA;
-			}
-
-			locker.lock();
-			std::weak_ptr<ResourceInternal>& weak_resource = resources[name];
-			std::shared_ptr<ResourceInternal> resource = weak_resource.lock();
-
-			static bool basis_init = false; // within lock!
-			if (!basis_init)
-			{
-				basis_init = true;
-				basist::basisu_transcoder_init();
-			}
-
-			if (resource == nullptr)
-			{
-				resource = std::make_shared<ResourceInternal>();
-				resources[name] = resource;
-				locker.unlock();
-			}
-			else
-			{
-				locker.unlock();
-				Resource retVal;
-				retVal.internal_state = resource;
-				return retVal;
-			}
-
 			if (filedata == nullptr || filesize == 0)
 			{
 				if (!wi::helper::FileRead(name, resource->filedata))
 				{
-					resource.reset();
-					return Resource();
+					return false;
 				}
 				filedata = resource->filedata.data();
 				filesize = resource->filedata.size();
@@ -192,7 +258,7 @@ namespace wi
 				}
 				else
 				{
-					return Resource();
+					return false;
 				}
 			}
 
@@ -670,12 +736,334 @@ namespace wi
 					wi::renderer::AddDeferredMIPGen(resource->texture, true);
 				}
 
+				return true;
+			}
+
+			return false;
+		}
+
+
+		// Makes the result of loading visible to other threads, and calls the completion callbacks
+		static void FinishLoading(const std::shared_ptr<ResourceInternal>& resource, bool success)
+		{
+			resource->UpdateMemoryUsage();
+			locker.lock();
+			resource->state.store(success ? ResourceInternal::State::READY : ResourceInternal::State::FAILED, std::memory_order_release);
+			wi::vector<std::function<void(const Resource& resource, bool success)>> callbacks = std::move(resource->callbacks);
+			resource->callbacks.clear();
+			locker.unlock();
+			loading_finished.notify_all();
+
+			Resource retVal;
+			retVal.internal_state = resource;
+			for (auto& callback : callbacks)
+			{
+				callback(retVal, success);
+			}
+		}
+
+		// Keeps a resource that is not referenced anymore in the cache, or frees it if caching is disabled
+		static void Release(const std::string& name, std::shared_ptr<ResourceInternal>&& resource)
+		{
+			if (cache_duration.load(std::memory_order_relaxed) <= 0 || resource->state.load(std::memory_order_acquire) != ResourceInternal::State::READY)
+			{
+				resource.reset();
+				return;
+			}
+
+			std::shared_ptr<ResourceInternal> replaced; // destroyed outside of the lock
+			Cache& cache = GetCache();
+			cache.locker.lock();
+			auto it = cache.lookup.find(name);
+			if (it != cache.lookup.end())
+			{
+				// A resource of the same name was reloaded while the previous one was cached, only the most recently released one is kept:
+				replaced = std::move(it->second->resource);
+				cache.entries.erase(it->second);
+			}
+			cache.entries.push_back({ name, std::move(resource), std::chrono::steady_clock::now() });
+			cache.lookup[name] = std::prev(cache.entries.end());
+			cache.locker.unlock();
+
+			UpdateCache();
+		}
+
+		// The resources that are given out are handles that share the resource, so that releasing the last handle can move the resource to the cache
+		static std::shared_ptr<ResourceInternal> CreateHandle(const std::string& name, std::shared_ptr<ResourceInternal>&& resource)
+		{
+			ResourceInternal* ptr = resource.get();
+			return std::shared_ptr<ResourceInternal>(ptr, [name, resource = std::move(resource)](ResourceInternal*) mutable {
+				Release(name, std::move(resource));
+			});
+		}
+
+		// Returns the resource that is registered with the name if it's loaded or being loaded, otherwise registers a new resource in LOADING state
+		//	Must be called within lock!
+		static std::shared_ptr<ResourceInternal> Register(const std::string& name, bool& is_new)
+		{
+			static bool basis_init = false; // within lock!
+			if (!basis_init)
+			{
+				basis_init = true;
+				basist::basisu_transcoder_init();
+			}
+
+			std::weak_ptr<ResourceInternal>& weak_resource = resources[name];
+			std::shared_ptr<ResourceInternal> resource = weak_resource.lock();
+			if (resource != nullptr && resource->state.load(std::memory_order_relaxed) != ResourceInternal::State::FAILED)
+			{
+				is_new = false;
+				return resource;
+			}
+
+			if (resource == nullptr)
+			{
+				// A resource that was released recently is revived from the cache:
+				std::shared_ptr<ResourceInternal> cached;
+				Cache& cache = GetCache();
+				cache.locker.lock();
+				auto it = cache.lookup.find(name);
+				if (it != cache.lookup.end())
+				{
+					cached = std::move(it->second->resource);
+					cache.entries.erase(it->second);
+					cache.lookup.erase(it);
+				}
+				cache.locker.unlock();
+				if (cached != nullptr)
+				{
+					resource = CreateHandle(name, std::move(cached));
+					weak_resource = resource;
+					is_new = false;
+					return resource;
+				}
+			}
+
+			// Failed resources are retried:
+			std::shared_ptr<ResourceInternal> internal = std::make_shared<ResourceInternal>();
+			internal->state.store(ResourceInternal::State::LOADING, std::memory_order_relaxed);
+			resource = CreateHandle(name, std::move(internal));
+			weak_resource = resource;
+			is_new = true;
+			return resource;
+		}
+
+		Resource Load(const std::string& name, Flags flags, const uint8_t* filedata, size_t filesize)
+		{
+			if (mode == Mode::DISCARD_FILEDATA_AFTER_LOAD)
+			{
+				flags &= ~Flags::IMPORT_RETAIN_FILEDATA;
+			}
+
+			std::unique_lock<std::mutex> lock(locker);
+			bool is_new = false;
+			std::shared_ptr<ResourceInternal> resource = Register(name, is_new);
+			if (!is_new)
+			{
+				// The resource could be still loading on a different thread, it is only returned when it's usable.
+				//	If it's waiting in the async queue, it's moved to the front because it's blocking now:
+				resource->priority.store(std::numeric_limits<int>::max(), std::memory_order_relaxed);
+				loading_finished.wait(lock, [&] { return resource->state.load(std::memory_order_relaxed) != ResourceInternal::State::LOADING; });
+				lock.unlock();
+				if (resource->state.load(std::memory_order_acquire) == ResourceInternal::State::FAILED)
+				{
+					return Resource();
+				}
 				Resource retVal;
 				retVal.internal_state = resource;
 				return retVal;
 			}
+			lock.unlock();
+
+			const bool success = LoadResource(resource.get(), name, flags, filedata, filesize);
+			FinishLoading(resource, success);
+			if (!success)
+			{
+				return Resource();
+			}
+
+			Resource retVal;
+			retVal.internal_state = resource;
+			return retVal;
+		}
+
+		// Background loading pipeline of LoadAsync():
+		//	The I/O thread reads files one by one, so that the disk is accessed sequentially
+		//	Decoder threads decode the file data and create the GPU resources
+		//	Both stages pick the request with the highest priority first
+		namespace async
+		{
+			struct Request
+			{
+				std::shared_ptr<ResourceInternal> resource;
+				std::string name;
+				Flags flags = Flags::NONE;
+			};
+			static std::mutex queue_locker;
+			static std::condition_variable io_wakeup;
+			static std::condition_variable decode_wakeup;
+			static wi::vector<Request> io_queue;
+			static wi::vector<Request> decode_queue;
+			static std::once_flag initialized;
+			static bool shutdown = false; // protected by queue_locker
+			static wi::vector<std::thread> threads;
+
+			static Request Pop(wi::vector<Request>& queue)
+			{
+				size_t best = 0;
+				for (size_t i = 1; i < queue.size(); ++i)
+				{
+					// Strictly higher priority is required to overtake, so requests of the same priority are processed in order:
+					if (queue[i].resource->priority.load(std::memory_order_relaxed) > queue[best].resource->priority.load(std::memory_order_relaxed))
+					{
+						best = i;
+					}
+				}
+				Request request = std::move(queue[best]);
+				queue.erase(queue.begin() + best);
+				return request;
+			}
+
+			// Stops the loader threads at exit. The requests that are still queued fail, so that their waiters and callbacks are finished
+			static void ShutDown()
+			{
+				queue_locker.lock();
+				shutdown = true;
+				queue_locker.unlock();
+				io_wakeup.notify_all();
+				decode_wakeup.notify_all();
+				for (std::thread& thread : threads)
+				{
+					thread.join();
+				}
+				threads.clear();
+
+				// The threads don't add requests anymore after they were joined:
+				queue_locker.lock();
+				wi::vector<Request> requests = std::move(io_queue);
+				io_queue.clear();
+				for (Request& request : decode_queue)
+				{
+					requests.push_back(std::move(request));
+				}
+				decode_queue.clear();
+				queue_locker.unlock();
+				for (Request& request : requests)
+				{
+					FinishLoading(request.resource, false);
+				}
+			}
+
+			static void Initialize()
+			{
+				threads.emplace_back([] {
+					while (true)
+					{
+						std::unique_lock<std::mutex> lock(queue_locker);
+						io_wakeup.wait(lock, [] { return shutdown || !io_queue.empty(); });
+						if (shutdown)
+						{
+							return;
+						}
+						Request request = Pop(io_queue);
+						lock.unlock();
 
-			return Resource();
+						if (!wi::helper::FileRead(request.name, request.resource->filedata))
+						{
+							FinishLoading(request.resource, false);
+							continue;
+						}
+
+						lock.lock();
+						decode_queue.push_back(std::move(request));
+						lock.unlock();
+						decode_wakeup.notify_one();
+					}
+				});
+
+				const uint32_t decoder_count = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 4));
+				for (uint32_t i = 0; i < decoder_count; ++i)
+				{
+					threads.emplace_back([] {
+						while (true)
+						{
+							std::unique_lock<std::mutex> lock(queue_locker);
+							decode_wakeup.wait(lock, [] { return shutdown || !decode_queue.empty(); });
+							if (shutdown)
+							{
+								return;
+							}
+							Request request = Pop(decode_queue);
+							lock.unlock();
+
+							ResourceInternal* resource = request.resource.get();
+							const bool success = LoadResource(resource, request.name, request.flags, resource->filedata.data(), resource->filedata.size());
+							FinishLoading(request.resource, success);
+						}
+					});
+				}
+
+				// The handler is registered after the static objects were constructed, so it runs before they are destroyed, including the job system:
+				std::atexit(ShutDown);
+			}
+		}
+
+		Resource LoadAsync(const std::string& name, Flags flags, int priority, std::function<void(const Resource& resource, bool success)> callback)
+		{
+			if (mode == Mode::DISCARD_FILEDATA_AFTER_LOAD)
+			{
+				flags &= ~Flags::IMPORT_RETAIN_FILEDATA;
+			}
+
+			std::call_once(async::initialized, async::Initialize);
+
+			locker.lock();
+			bool is_new = false;
+			std::shared_ptr<ResourceInternal> resource = Register(name, is_new);
+			Resource retVal;
+			retVal.internal_state = resource;
+
+			if (resource->state.load(std::memory_order_relaxed) == ResourceInternal::State::LOADING)
+			{
+				// Requests for the same resource are merged, the highest priority of them is used:
+				if (is_new || resource->priority.load(std::memory_order_relaxed) < priority)
+				{
+					resource->priority.store(priority, std::memory_order_relaxed);
+				}
+				if (callback != nullptr)
+				{
+					resource->callbacks.push_back(std::move(callback));
+				}
+				locker.unlock();
+
+				if (is_new)
+				{
+					async::Request request;
+					request.resource = resource;
+					request.name = name;
+					request.flags = flags;
+					async::queue_locker.lock();
+					if (async::shutdown)
+					{
+						// The loader threads were already stopped at exit:
+						async::queue_locker.unlock();
+						FinishLoading(resource, false);
+						return retVal;
+					}
+					async::io_queue.push_back(std::move(request));
+					async::queue_locker.unlock();
+					async::io_wakeup.notify_one();
+				}
+				return retVal;
+			}
+			locker.unlock();
+
+			// Already loaded:
+			if (callback != nullptr)
+			{
+				callback(retVal, true);
+			}
+			return retVal;
 		}
 
 		bool Contains(const std::string& name)
@@ -697,6 +1085,99 @@ namespace wi
 			locker.lock();
 			resources.clear();
 			locker.unlock();
+			ClearCache();
+		}
+
+		size_t GetMemoryUsage(MemoryType type)
+		{
+			return total_memory_usage[(size_t)type].load(std::memory_order_relaxed);
+		}
+		size_t GetCacheMemoryUsage(MemoryType type)
+		{
+			size_t result = 0;
+			Cache& cache = GetCache();
+			cache.locker.lock();
+			for (auto& entry : cache.entries)
+			{
+				result += entry.resource->memory_usage[(size_t)type];
+			}
+			cache.locker.unlock();
+			return result;
+		}
+		size_t GetCacheResourceCount()
+		{
+			Cache& cache = GetCache();
+			cache.locker.lock();
+			size_t result = cache.entries.size();
+			cache.locker.unlock();
+			return result;
+		}
+		void SetCacheDuration(float seconds)
+		{
+			cache_duration.store(seconds, std::memory_order_relaxed);
+			UpdateCache();
+		}
+		float GetCacheDuration()
+		{
+			return cache_duration.load(std::memory_order_relaxed);
+		}
+		void SetMemoryBudget(MemoryType type, size_t bytes)
+		{
+			memory_budget[(size_t)type].store(bytes, std::memory_order_relaxed);
+			UpdateCache();
+		}
+		size_t GetMemoryBudget(MemoryType type)
+		{
+			return memory_budget[(size_t)type].load(std::memory_order_relaxed);
+		}
+		void UpdateCache()
+		{
+			wi::vector<std::shared_ptr<ResourceInternal>> evicted; // destroyed outside of the lock
+			size_t evicted_usage[(size_t)MemoryType::COUNT] = {};
+
+			Cache& cache = GetCache();
+			cache.locker.lock();
+			const auto now = std::chrono::steady_clock::now();
+			const float duration = cache_duration.load(std::memory_order_relaxed);
+			for (auto it = cache.entries.begin(); it != cache.entries.end();)
+			{
+				const ResourceInternal* resource = it->resource.get();
+				bool evict = std::chrono::duration<float>(now - it->release_time).count() >= duration;
+				bool over_budget = false;
+				for (size_t i = 0; i < (size_t)MemoryType::COUNT; ++i)
+				{
+					if (total_memory_usage[i].load(std::memory_order_relaxed) - evicted_usage[i] > memory_budget[i].load(std::memory_order_relaxed))
+					{
+						over_budget = true;
+						evict |= resource->memory_usage[i] > 0;
+					}
+				}
+				if (!evict)
+				{
+					if (!over_budget)
+						break; // the rest were released later, so they didn't expire either
+					++it;
+					continue;
+				}
+				for (size_t i = 0; i < (size_t)MemoryType::COUNT; ++i)
+				{
+					evicted_usage[i] += resource->memory_usage[i];
+				}
+				evicted.push_back(std::move(it->resource));
+				cache.lookup.erase(it->name);
+				it = cache.entries.erase(it);
+			}
+			cache.locker.unlock();
+		}
+		void ClearCache()
+		{
+			std::list<CacheEntry> evicted; // destroyed outside of the lock
+			Cache& cache = GetCache();
+			cache.locker.lock();
+			evicted = std::move(cache.entries);
+			cache.entries.clear();
+			cache.lookup.clear();
+			cache.locker.unlock();
 		}
 
 
@@ -759,7 +1240,7 @@ namespace wi
 					for (auto& it : resources)
 					{
 						std::shared_ptr<ResourceInternal> resource = it.second.lock();
-						if (resource != nullptr && !resource->filedata.empty())
+						if (resource != nullptr && resource->state.load(std::memory_order_relaxed) == ResourceInternal::State::READY && !resource->filedata.empty())
 						{
 							serializable_count++;
 						}
@@ -771,7 +1252,7 @@ namespace wi
 					{
 						std::shared_ptr<ResourceInternal> resource = it.second.lock();
 
-						if (resource != nullptr && !resource->filedata.empty())
+						if (resource != nullptr && resource->state.load(std::memory_order_relaxed) == ResourceInternal::State::READY && !resource->filedata.empty())
 						{
 							std::string name = it.first;
 							wi::helper::MakePathRelative(archive.GetSourceDirectory(), name);
@@ -788,4 +1269,19 @@ namespace wi
 
 	}
 
+
+	void ResourceInternal::UpdateMemoryUsage()
+	{
+		size_t usage[(size_t)resourcemanager::MemoryType::COUNT] = {};
+		usage[(size_t)resourcemanager::MemoryType::FILEDATA] = filedata.size();
+		usage[(size_t)resourcemanager::MemoryType::TEXTURE] = texture.IsValid() ? resourcemanager::ComputeTextureMemorySize(texture.desc) : 0;
+		usage[(size_t)resourcemanager::MemoryType::SOUND] = wi::audio::GetSoundMemorySize(&sound);
+		resourcemanager::AddMemoryUsage(usage, memory_usage);
+		std::memcpy(memory_usage, usage, sizeof(usage));
+	}
+	ResourceInternal::~ResourceInternal()
+	{
+		const size_t none[(size_t)resourcemanager::MemoryType::COUNT] = {};
+		resourcemanager::AddMemoryUsage(none, memory_usage);
+	}
 }
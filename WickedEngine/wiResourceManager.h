@@ -7,15 +7,21 @@
 #include "wiVector.h"
 
 #include <memory>
+#include <functional>
 
 namespace wi
 {
 	// This can hold an asset
-	//	It can be loaded from file or memory using wi::resourcemanager::Load()
+	//	It can be loaded from file or memory using wi::resourcemanager::Load() or wi::resourcemanager::LoadAsync()
 	struct Resource
 	{
 		std::shared_ptr<void> internal_state;
 		inline bool IsValid() const { return internal_state.get() != nullptr; }
+		// Check if the contents are usable. Resources that are being loaded asynchronously are valid, but not ready yet
+		//	The getters return empty contents until the resource is ready
+		bool IsReady() const;
+		// Check if the resource is still being loaded asynchronously
+		bool IsLoading() const;
 
 		const wi::vector<uint8_t>& GetFileData() const;
 		const wi::graphics::Texture& GetTexture() const;
@@ -59,11 +65,52 @@ namespace wi
 			const uint8_t* filedata = nullptr,
 			size_t filesize = 0
 		);
+		// Load a resource asynchronously on background threads, without blocking the calling thread
+		//	The returned resource is valid, but it will only become ready when loading finished. Use Resource::IsReady() or the callback to check it
+		//	Requests for the same name are merged, and the resource is only loaded once
+		//	name : file name of resource
+		//	flags : specify flags that modify behaviour (optional)
+		//	priority : requests with higher priority are loaded first (optional)
+		//	callback : called when loading finished, either on a background thread or on the calling thread if the resource was already loaded (optional)
+		Resource LoadAsync(
+			const std::string& name,
+			Flags flags = Flags::NONE,
+			int priority = 0,
+			std::function<void(const Resource& resource, bool success)> callback = nullptr
+		);
 		// Check if a resource is currently loaded
 		bool Contains(const std::string& name);
 		// Invalidate all resources
 		void Clear();
 
+		// Memory that is used by the contents of resources:
+		enum class MemoryType
+		{
+			FILEDATA,	// file data that is kept by resources, see IMPORT_RETAIN_FILEDATA
+			TEXTURE,	// texture data, estimated from the texture descriptions
+			SOUND,		// decoded sound data
+			COUNT
+		};
+		// Returns the memory used by all resources that are alive, including the cached ones
+		size_t GetMemoryUsage(MemoryType type);
+		// Returns the memory used by cached resources, that are not referenced anymore
+		size_t GetCacheMemoryUsage(MemoryType type);
+		// Returns the number of cached resources, that are not referenced anymore
+		size_t GetCacheResourceCount();
+		// Resources that were loaded by name are kept alive in a cache for this duration after their last reference is released,
+		//	so requesting them again shortly after doesn't need to reload them. Default: 0 (resources are freed immediately)
+		void SetCacheDuration(float seconds);
+		float GetCacheDuration();
+		// If the memory usage of a memory type exceeds its budget, cached resources that use that memory are freed, least recently used first
+		//	Resources that are still referenced are never freed. Default: no limit
+		void SetMemoryBudget(MemoryType type, size_t bytes);
+		size_t GetMemoryBudget(MemoryType type);
+		// Frees the cached resources that expired or exceed the memory budgets
+		//	This is also done when resources are released, but expiration needs this to be called periodically (wi::Application calls it every frame)
+		void UpdateCache();
+		// Frees all cached resources
+		void ClearCache();
+
 		struct ResourceSerializer
 		{
 			wi::vector<Resource> resources;
@@ -10,11 +10,15 @@
 #include "wiRenderer.h"
 #include "wiBacklog.h"
 #include "wiTimer.h"
+#include "wiTrace.h"
 #include "wiUnorderedMap.h"
 
 #include "shaders/ShaderInterop_SurfelGI.h"
 #include "shaders/ShaderInterop_DDGI.h"
 
+#include <algorithm>
+#include <numeric>
+
 using namespace wi::ecs;
 using namespace wi::enums;
 using namespace wi::graphics;
@@ -23,6 +27,100 @@ using namespace wi::primitive;
 namespace wi::scene
 {
 
+	void NameComponent::SetName(const std::string& value)
+	{
+		if (manager != nullptr)
+		{
+			manager->Rename(this, name, value);
+		}
+		name = value;
+	}
+
+	Entity NameComponentManager::Find(const std::string& name)
+	{
+		UpdateIndex();
+		// Same names are resolved by component order, so the result is the same as with a linear search:
+		Entity result = INVALID_ENTITY;
+		size_t result_index = ~0ull;
+		auto range = index.equal_range(name);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			const size_t component_index = GetIndex(it->second);
+			if (component_index < result_index)
+			{
+				result = it->second;
+				result_index = component_index;
+			}
+		}
+		return result;
+	}
+	void NameComponentManager::FindAll(const std::string& name, wi::vector<Entity>& entities)
+	{
+		UpdateIndex();
+		const size_t offset = entities.size();
+		auto range = index.equal_range(name);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			entities.push_back(it->second);
+		}
+		std::sort(entities.begin() + offset, entities.end(), [&](Entity a, Entity b) {
+			return GetIndex(a) < GetIndex(b);
+		});
+	}
+	void NameComponentManager::FindAllPrefix(const std::string& prefix, wi::vector<Entity>& entities)
+	{
+		UpdateIndex();
+		for (auto it = sorted_index.lower_bound(prefix); it != sorted_index.end(); ++it)
+		{
+			if (it->first.compare(0, prefix.size(), prefix) != 0)
+				break;
+			entities.push_back(it->second);
+		}
+	}
+	void NameComponentManager::UpdateIndex()
+	{
+		if (index_version == GetVersion())
+			return;
+		index_version = GetVersion();
+		index.clear();
+		index.reserve(GetCount());
+		sorted_index.clear();
+		for (size_t i = 0; i < GetCount(); ++i)
+		{
+			NameComponent& component = (*this)[i];
+			component.manager = this;
+			index.emplace(component.name, GetEntity(i));
+			sorted_index.emplace(component.name, GetEntity(i));
+		}
+	}
+	void NameComponentManager::Rename(const NameComponent* component, const std::string& prev_name, const std::string& name)
+	{
+		if (index_version != GetVersion())
+			return; // the indices are rebuilt by the next query anyway
+		// Copies of components keep the manager, but they are not indexed, so they are found by their address:
+		auto range = index.equal_range(prev_name);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (GetComponent(it->second) == component)
+			{
+				const Entity entity = it->second;
+				index.erase(it);
+				index.emplace(name, entity);
+				auto sorted_range = sorted_index.equal_range(prev_name);
+				for (auto jt = sorted_range.first; jt != sorted_range.second; ++jt)
+				{
+					if (jt->second == entity)
+					{
+						sorted_index.erase(jt);
+						break;
+					}
+				}
+				sorted_index.emplace(name, entity);
+				return;
+			}
+		}
+	}
+
 	XMFLOAT3 TransformComponent::GetPosition() const
 	{
 		return *((XMFLOAT3*)&world._41);
@@ -387,6 +485,8 @@ namespace wi::scene
 	{
 		GraphicsDevice* device = wi::graphics::GetDevice();
 
+		bvh.Clear(); // vertex data changed, it will be rebuilt by the mesh update system
+		bvh_leaf_aabbs.clear();
 		generalBuffer = {};
 		streamoutBuffer = {};
 		ib = {};
@@ -1158,6 +1258,64 @@ namespace wi::scene
 		sphere.radius = aabb.getRadius();
 		return sphere;
 	}
+	void MeshComponent::UpdateBVH()
+	{
+		uint32_t first_subset = 0;
+		uint32_t last_subset = 0;
+		GetLODSubsetRange(0, first_subset, last_subset);
+
+		uint32_t triangle_count = 0;
+		for (uint32_t subsetIndex = first_subset; subsetIndex < last_subset; ++subsetIndex)
+		{
+			triangle_count += subsets[subsetIndex].indexCount / 3;
+		}
+
+		const bool morphed = !vertex_positions_morphed.empty();
+		bvh_leaf_aabbs.resize(triangle_count);
+		uint32_t triangle = 0;
+		for (uint32_t subsetIndex = first_subset; subsetIndex < last_subset; ++subsetIndex)
+		{
+			const MeshSubset& subset = subsets[subsetIndex];
+			for (uint32_t i = 0; i + 2 < subset.indexCount; i += 3)
+			{
+				const uint32_t i0 = indices[subset.indexOffset + i + 0];
+				const uint32_t i1 = indices[subset.indexOffset + i + 1];
+				const uint32_t i2 = indices[subset.indexOffset + i + 2];
+				const XMFLOAT3 p0 = morphed ? vertex_positions_morphed[i0].pos : vertex_positions[i0];
+				const XMFLOAT3 p1 = morphed ? vertex_positions_morphed[i1].pos : vertex_positions[i1];
+				const XMFLOAT3 p2 = morphed ? vertex_positions_morphed[i2].pos : vertex_positions[i2];
+				bvh_leaf_aabbs[triangle++] = AABB(wi::math::Min(p0, wi::math::Min(p1, p2)), wi::math::Max(p0, wi::math::Max(p1, p2)));
+			}
+		}
+
+		bvh.Update(bvh_leaf_aabbs.data(), triangle_count);
+
+		if (morph_targets.empty())
+		{
+			// Static vertices never need refitting:
+			bvh_leaf_aabbs.clear();
+			bvh_leaf_aabbs.shrink_to_fit();
+		}
+	}
+	void MeshComponent::GetBVHTriangle(uint32_t triangle, uint32_t& subsetIndex, uint32_t& indexOffset) const
+	{
+		uint32_t first_subset = 0;
+		uint32_t last_subset = 0;
+		GetLODSubsetRange(0, first_subset, last_subset);
+		for (subsetIndex = first_subset; subsetIndex < last_subset; ++subsetIndex)
+		{
+			const MeshSubset& subset = subsets[subsetIndex];
+			const uint32_t subset_triangle_count = subset.indexCount / 3;
+			if (triangle < subset_triangle_count)
+			{
+				indexOffset = subset.indexOffset + triangle * 3;
+				return;
+			}
+			triangle -= subset_triangle_count;
+		}
+		assert(0); // triangle is not in the BVH
+		indexOffset = 0;
+	}
 
 	void ObjectComponent::ClearLightmap()
 	{
@@ -1587,105 +1745,131 @@ namespace wi::scene
 			queryAllocator.store(0);
 		}
 
-		wi::jobsystem::context ctx;
-
-		// Scan mesh subset counts to allocate GPU geometry data:
-		geometryAllocator.store(0u);
-		wi::jobsystem::Dispatch(ctx, (uint32_t)meshes.GetCount(), small_subtask_groupsize, [&](wi::jobsystem::JobArgs args) {
-			MeshComponent& mesh = meshes[args.jobIndex];
-			mesh.geometryOffset = geometryAllocator.fetch_add((uint32_t)mesh.subsets.size());
-		});
-
-		wi::jobsystem::Execute(ctx, [&](wi::jobsystem::JobArgs args) {
-			// Must not keep inactive TLAS instances, so zero them out for safety:
-			std::memset(TLAS_instancesMapped, 0, TLAS_instancesUpload->desc.size);
-		});
-
-		wi::jobsystem::Execute(ctx, [&](wi::jobsystem::JobArgs args) {
-			// Must not keep inactive instances, so init them for safety:
-			ShaderMeshInstance inst;
-			inst.init();
-			for (uint32_t i = 0; i < instanceArraySize; ++i)
-			{
-				std::memcpy(instanceArrayMapped + i, &inst, sizeof(inst));
-			}
-		});
-
-		wi::physics::RunPhysicsUpdateSystem(ctx, *this, dt);
+		// The update systems are organized into a task graph, so that independent systems can overlap
+		//	and only the real data dependencies between them need to be waited on:
+		if (update_graph.IsEmpty())
+		{
+			using wi::jobsystem::TaskGraph;
+
+			// Systems spawn their jobs into the task graph, they finish when all of their jobs finished without blocking a worker thread:
+			//	Their range names show up in wi::trace, and label the jobs that they dispatch
+			auto system = [this](const char* name, void(Scene::*func)(wi::jobsystem::context&)) {
+				return [this, name, func](wi::jobsystem::context& ctx) {
+					wi::trace::ScopedRange range(name);
+					(this->*func)(ctx);
+				};
+			};
+
+			// Scan mesh subset counts to allocate GPU geometry data:
+			TaskGraph::Task task_geometry_scan = update_graph.AddSpawn([this](wi::jobsystem::context& ctx) {
+				geometryAllocator.store(0u);
+				wi::jobsystem::Dispatch(ctx, (uint32_t)meshes.GetCount(), small_subtask_groupsize, [this](wi::jobsystem::JobArgs args) {
+					MeshComponent& mesh = meshes[args.jobIndex];
+					mesh.geometryOffset = geometryAllocator.fetch_add((uint32_t)mesh.subsets.size());
+				});
+			});
+
+			TaskGraph::Task task_tlas_clear = update_graph.Add([this](wi::jobsystem::JobArgs args) {
+				// Must not keep inactive TLAS instances, so zero them out for safety:
+				if (TLAS_instancesMapped != nullptr)
+				{
+					std::memset(TLAS_instancesMapped, 0, TLAS_instancesUpload->desc.size);
+				}
+			});
 
-		RunAnimationUpdateSystem(ctx);
+			TaskGraph::Task task_instance_clear = update_graph.Add([this](wi::jobsystem::JobArgs args) {
+				// Must not keep inactive instances, so init them for safety:
+				ShaderMeshInstance inst;
+				inst.init();
+				for (uint32_t i = 0; i < instanceArraySize; ++i)
+				{
+					std::memcpy(instanceArrayMapped + i, &inst, sizeof(inst));
+				}
+			});
 
-		RunTransformUpdateSystem(ctx);
+			TaskGraph::Task task_physics = update_graph.AddSpawn([this](wi::jobsystem::context& ctx) {
+				wi::trace::ScopedRange range("Physics");
+				wi::physics::RunPhysicsUpdateSystem(ctx, *this, this->dt);
+			});
 
-		wi::jobsystem::Wait(ctx); // dependencies
+			TaskGraph::Task task_animation = update_graph.AddSpawn(system("Animation", &Scene::RunAnimationUpdateSystem));
+			TaskGraph::Task task_transform = update_graph.AddSpawn(system("Transform", &Scene::RunTransformUpdateSystem), { task_physics, task_animation });
+			TaskGraph::Task task_hierarchy = update_graph.AddSpawn(system("Hierarchy", &Scene::RunHierarchyUpdateSystem), { task_transform });
 
-		RunHierarchyUpdateSystem(ctx);
+			TaskGraph::Task task_geometry_allocation = update_graph.Add([this](wi::jobsystem::JobArgs args) {
+				GraphicsDevice* device = wi::graphics::GetDevice();
 
-		// GPU subset count allocation is ready at this point:
-		geometryArraySize = geometryAllocator.load();
-		geometryArraySize += hairs.GetCount();
-		geometryArraySize += emitters.GetCount();
-		if (impostors.GetCount() > 0)
-		{
-			impostorGeometryOffset = uint32_t(geometryArraySize);
-			geometryArraySize += 1;
+				// GPU subset count allocation is ready at this point:
+				geometryArraySize = geometryAllocator.load();
+				geometryArraySize += hairs.GetCount();
+				geometryArraySize += emitters.GetCount();
+				if (impostors.GetCount() > 0)
+				{
+					impostorGeometryOffset = uint32_t(geometryArraySize);
+					geometryArraySize += 1;
+				}
+				if (geometryBuffer.desc.size < (geometryArraySize * sizeof(ShaderGeometry)))
+				{
+					GPUBufferDesc desc;
+					desc.stride = sizeof(ShaderGeometry);
+					desc.size = desc.stride * geometryArraySize * 2; // *2 to grow fast
+					desc.bind_flags = BindFlag::SHADER_RESOURCE;
+					desc.misc_flags = ResourceMiscFlag::BUFFER_RAW;
+					device->CreateBuffer(&desc, nullptr, &geometryBuffer);
+					device->SetName(&geometryBuffer, "Scene::geometryBuffer");
+
+					desc.usage = Usage::UPLOAD;
+					desc.bind_flags = BindFlag::NONE;
+					desc.misc_flags = ResourceMiscFlag::NONE;
+					for (int i = 0; i < arraysize(geometryUploadBuffer); ++i)
+					{
+						device->CreateBuffer(&desc, nullptr, &geometryUploadBuffer[i]);
+						device->SetName(&geometryUploadBuffer[i], "Scene::geometryUploadBuffer");
+					}
+				}
+				geometryArrayMapped = (ShaderGeometry*)geometryUploadBuffer[device->GetBufferIndex()].mapped_data;
+			}, { task_geometry_scan });
+
+			TaskGraph::Task task_mesh = update_graph.AddSpawn(system("Mesh", &Scene::RunMeshUpdateSystem), { task_geometry_allocation, task_physics, task_animation });
+			TaskGraph::Task task_material = update_graph.AddSpawn(system("Material", &Scene::RunMaterialUpdateSystem), { task_animation });
+
+			// IK and springs both overwrite world matrices through transforms_temp, so they are serialized.
+			//	World matrices are final only after these:
+			TaskGraph::Task task_inverse_kinematics = update_graph.AddSpawn(system("Inverse Kinematics", &Scene::RunInverseKinematicsUpdateSystem), { task_hierarchy });
+			TaskGraph::Task task_spring = update_graph.AddSpawn(system("Spring", &Scene::RunSpringUpdateSystem), { task_inverse_kinematics });
+			const TaskGraph::Task task_world_final = task_spring;
+
+			TaskGraph::Task task_armature = update_graph.AddSpawn(system("Armature", &Scene::RunArmatureUpdateSystem), { task_world_final });
+			TaskGraph::Task task_weather = update_graph.AddSpawn(system("Weather", &Scene::RunWeatherUpdateSystem), { task_spring }); // springs read the previous weather
+
+			TaskGraph::Task task_object = update_graph.AddSpawn(system("Object", &Scene::RunObjectUpdateSystem), { task_world_final, task_mesh, task_material, task_armature, task_weather, task_instance_clear, task_tlas_clear });
+			update_graph.AddSpawn(system("Camera", &Scene::RunCameraUpdateSystem), { task_world_final });
+			TaskGraph::Task task_decal = update_graph.AddSpawn(system("Decal", &Scene::RunDecalUpdateSystem), { task_world_final, task_material });
+			update_graph.AddSpawn(system("Probe", &Scene::RunProbeUpdateSystem), { task_world_final });
+			update_graph.AddSpawn(system("Force", &Scene::RunForceUpdateSystem), { task_world_final });
+			TaskGraph::Task task_light = update_graph.AddSpawn(system("Light", &Scene::RunLightUpdateSystem), { task_world_final, task_weather });
+
+			// Bounding volume hierarchies are refitted to the new AABBs, and only rebuilt when the component count changed:
+			update_graph.Add([this](wi::jobsystem::JobArgs args) {
+				object_bvh.Update(aabb_objects.GetComponentArray().data(), (uint32_t)aabb_objects.GetCount());
+			}, { task_object });
+			update_graph.Add([this](wi::jobsystem::JobArgs args) {
+				decal_bvh.Update(aabb_decals.GetComponentArray().data(), (uint32_t)aabb_decals.GetCount());
+			}, { task_decal });
+			update_graph.Add([this](wi::jobsystem::JobArgs args) {
+				light_bvh.Update(aabb_lights.GetComponentArray().data(), (uint32_t)aabb_lights.GetCount());
+			}, { task_light });
+			update_graph.AddSpawn(system("Particle", &Scene::RunParticleUpdateSystem), { task_world_final, task_mesh, task_material, task_instance_clear, task_tlas_clear });
+			update_graph.AddSpawn(system("Sound", &Scene::RunSoundUpdateSystem), { task_world_final });
+			update_graph.AddSpawn(system("Impostor", &Scene::RunImpostorUpdateSystem), { task_world_final, task_mesh, task_material, task_instance_clear, task_tlas_clear });
 		}
-		if (geometryBuffer.desc.size < (geometryArraySize * sizeof(ShaderGeometry)))
-		{
-			GPUBufferDesc desc;
-			desc.stride = sizeof(ShaderGeometry);
-			desc.size = desc.stride * geometryArraySize * 2; // *2 to grow fast
-			desc.bind_flags = BindFlag::SHADER_RESOURCE;
-			desc.misc_flags = ResourceMiscFlag::BUFFER_RAW;
-			device->CreateBuffer(&desc, nullptr, &geometryBuffer);
-			device->SetName(&geometryBuffer, "Scene::geometryBuffer");
 
-			desc.usage = Usage::UPLOAD;
-			desc.bind_flags = BindFlag::NONE;
-			desc.misc_flags = ResourceMiscFlag::NONE;
-			for (int i = 0; i < arraysize(geometryUploadBuffer); ++i)
-			{
-				device->CreateBuffer(&desc, nullptr, &geometryUploadBuffer[i]);
-				device->SetName(&geometryUploadBuffer[i], "Scene::geometryUploadBuffer");
-			}
+		{
+			wi::trace::ScopedRange range("Scene::Update");
+			wi::jobsystem::context ctx;
+			update_graph.Submit(ctx);
+			wi::jobsystem::Wait(ctx); // dependencies
 		}
-		geometryArrayMapped = (ShaderGeometry*)geometryUploadBuffer[device->GetBufferIndex()].mapped_data;
-
-		RunMeshUpdateSystem(ctx);
-
-		RunMaterialUpdateSystem(ctx);
-
-		wi::jobsystem::Wait(ctx); // dependencies
-
-		RunInverseKinematicsUpdateSystem(ctx);
-
-		RunSpringUpdateSystem(ctx);
-
-		RunArmatureUpdateSystem(ctx);
-
-		RunWeatherUpdateSystem(ctx);
-
-		wi::jobsystem::Wait(ctx); // dependencies
-
-		RunObjectUpdateSystem(ctx);
-
-		RunCameraUpdateSystem(ctx);
-
-		RunDecalUpdateSystem(ctx);
-
-		RunProbeUpdateSystem(ctx);
-
-		RunForceUpdateSystem(ctx);
-
-		RunLightUpdateSystem(ctx);
-
-		RunParticleUpdateSystem(ctx);
-
-		RunSoundUpdateSystem(ctx);
-
-		RunImpostorUpdateSystem(ctx);
-
-		wi::jobsystem::Wait(ctx); // dependencies
 
 		// Merge parallel bounds computation (depends on object update system):
 		bounds = AABB();
@@ -2056,6 +2240,9 @@ namespace wi::scene
 
 		TLAS = RaytracingAccelerationStructure();
 		BVH.Clear();
+		object_bvh.Clear();
+		light_bvh.Clear();
+		decal_bvh.Clear();
 		waterRipples.clear();
 
 		surfelBuffer = {};
@@ -2137,18 +2324,12 @@ namespace wi::scene
 		if (recursive)
 		{
 			wi::vector<Entity> entities_to_remove;
-			for (size_t i = 0; i < hierarchy.GetCount(); ++i)
-			{
-				const HierarchyComponent& hier = hierarchy[i];
-				if (hier.parentID == entity)
-				{
-					Entity child = hierarchy.GetEntity(i);
-					entities_to_remove.push_back(child);
-				}
-			}
-			for (auto& child : entities_to_remove)
+			entities_to_remove.push_back(entity);
+			Entity_GetChildren(entity, entities_to_remove, true);
+			if (entities_to_remove.size() > 1)
 			{
-				Entity_Remove(child);
+				Entity_RemoveMany(entities_to_remove, false);
+				return;
 			}
 		}
 
@@ -2181,16 +2362,106 @@ namespace wi::scene
 		inverse_kinematics.Remove(entity);
 		springs.Remove(entity);
 	}
-	Entity Scene::Entity_FindByName(const std::string& name)
+	void Scene::Entity_RemoveMany(const wi::vector<Entity>& entities, bool recursive)
+	{
+		wi::vector<Entity> entities_to_remove;
+		if (recursive)
+		{
+			// The input can already contain children of other entities in the input, they must be only removed once:
+			wi::unordered_set<Entity> visited;
+			for (Entity entity : entities)
+			{
+				if (visited.insert(entity).second)
+				{
+					const size_t offset = entities_to_remove.size();
+					entities_to_remove.push_back(entity);
+					Entity_GetChildren(entity, entities_to_remove, true);
+					size_t write = offset + 1;
+					for (size_t i = offset + 1; i < entities_to_remove.size(); ++i)
+					{
+						if (visited.insert(entities_to_remove[i]).second)
+						{
+							entities_to_remove[write++] = entities_to_remove[i];
+						}
+					}
+					entities_to_remove.resize(write);
+				}
+			}
+		}
+		else
+		{
+			entities_to_remove = entities;
+		}
+
+		if (entities_to_remove.size() == 1)
+		{
+			Entity_Remove(entities_to_remove.front(), false);
+			return;
+		}
+
+		names.Remove_Many(entities_to_remove);
+		layers.Remove_Many(entities_to_remove);
+		transforms.Remove_Many(entities_to_remove);
+		hierarchy.Remove_Many(entities_to_remove);
+		materials.Remove_Many(entities_to_remove);
+		meshes.Remove_Many(entities_to_remove);
+		impostors.Remove_Many(entities_to_remove);
+		objects.Remove_Many(entities_to_remove);
+		aabb_objects.Remove_Many(entities_to_remove);
+		rigidbodies.Remove_Many(entities_to_remove);
+		softbodies.Remove_Many(entities_to_remove);
+		armatures.Remove_Many(entities_to_remove);
+		lights.Remove_Many(entities_to_remove);
+		aabb_lights.Remove_Many(entities_to_remove);
+		cameras.Remove_Many(entities_to_remove);
+		probes.Remove_Many(entities_to_remove);
+		aabb_probes.Remove_Many(entities_to_remove);
+		forces.Remove_Many(entities_to_remove);
+		decals.Remove_Many(entities_to_remove);
+		aabb_decals.Remove_Many(entities_to_remove);
+		animations.Remove_Many(entities_to_remove);
+		animation_datas.Remove_Many(entities_to_remove);
+		emitters.Remove_Many(entities_to_remove);
+		hairs.Remove_Many(entities_to_remove);
+		weathers.Remove_Many(entities_to_remove);
+		sounds.Remove_Many(entities_to_remove);
+		inverse_kinematics.Remove_Many(entities_to_remove);
+		springs.Remove_Many(entities_to_remove);
+	}
+	void Scene::Entity_GetChildren(Entity parent, wi::vector<Entity>& children, bool recursive)
 	{
-		for (size_t i = 0; i < names.GetCount(); ++i)
+		UpdateHierarchyChildren();
+
+		// The appended children are also visited in the recursive case, which finds the whole subtree in breadth first order:
+		const size_t offset = children.size();
+		Entity current = parent;
+		size_t next = offset;
+		while (true)
 		{
-			if (names[i] == name)
+			auto it = hierarchy_children_ranges.find(current);
+			if (it != hierarchy_children_ranges.end())
 			{
-				return names.GetEntity(i);
+				const HierarchyChildren& range = it->second;
+				children.insert(children.end(), hierarchy_children.begin() + range.offset, hierarchy_children.begin() + range.offset + range.count);
 			}
+			if (!recursive || next >= children.size())
+			{
+				break;
+			}
+			current = children[next++];
 		}
-		return INVALID_ENTITY;
+	}
+	Entity Scene::Entity_FindByName(const std::string& name)
+	{
+		return names.Find(name);
+	}
+	void Scene::Entity_FindAllByName(const std::string& name, wi::vector<Entity>& entities)
+	{
+		names.FindAll(name, entities);
+	}
+	void Scene::Entity_FindAllByNamePrefix(const std::string& prefix, wi::vector<Entity>& entities)
+	{
+		names.FindAllPrefix(prefix, entities);
 	}
 	Entity Scene::Entity_Duplicate(Entity entity)
 	{
@@ -2680,6 +2951,7 @@ namespace wi::scene
 
 		HierarchyComponent& parentcomponent = hierarchy.Create(entity);
 		parentcomponent.parentID = parent;
+		hierarchy_children_dirty = true;
 
 		TransformComponent* transform_parent = transforms.GetComponent(parent);
 		TransformComponent* transform_child = transforms.GetComponent(entity);
@@ -2713,27 +2985,55 @@ namespace wi::scene
 			}
 
 			hierarchy.Remove(entity);
+			hierarchy_children_dirty = true;
 		}
 	}
 	void Scene::Component_DetachChildren(Entity parent)
 	{
-		for (size_t i = 0; i < hierarchy.GetCount(); )
+		wi::vector<Entity> children;
+		Entity_GetChildren(parent, children);
+		for (Entity child : children)
+		{
+			Component_Detach(child);
+		}
+	}
+
+
+	// Finds the keyframes around the time in the sorted keyframe times
+	//	cursor is the left keyframe of the previous search. It is checked first, as well as the next keyframe, so that playback finds the keyframes in constant time
+	//	returns false if the time is outside the range of keyframes
+	static bool FindKeyframes(const wi::vector<float>& keyframe_times, float time, uint32_t& cursor, int& keyLeft, int& keyRight)
+	{
+		const uint32_t count = (uint32_t)keyframe_times.size();
+		if (count == 0 || time < keyframe_times.front() || time > keyframe_times.back())
+		{
+			return false;
+		}
+
+		auto contains = [&](uint32_t key) {
+			return key < count && keyframe_times[key] <= time && (key + 1 == count || time < keyframe_times[key + 1]);
+		};
+		if (!contains(cursor))
 		{
-			if (hierarchy[i].parentID == parent)
+			if (contains(cursor + 1))
 			{
-				Entity entity = hierarchy.GetEntity(i);
-				Component_Detach(entity);
+				cursor++;
 			}
 			else
 			{
-				++i;
+				cursor = uint32_t(std::upper_bound(keyframe_times.begin(), keyframe_times.end(), time) - keyframe_times.begin()) - 1;
 			}
 		}
-	}
-
 
+		keyLeft = (int)cursor;
+		keyRight = (keyframe_times[cursor] == time || cursor + 1 == count) ? keyLeft : keyLeft + 1;
+		return true;
+	}
 	void Scene::RunAnimationUpdateSystem(wi::jobsystem::context& ctx)
 	{
+		// Gather the channels that need to be sampled and resolve their targets:
+		animation_samples.clear();
+		uint32_t weight_count_total = 0;
 		for (size_t i = 0; i < animations.GetCount(); ++i)
 		{
 			AnimationComponent& animation = animations[i];
@@ -2743,8 +3043,9 @@ namespace wi::scene
 			}
 			animation.last_update_time = animation.timer;
 
-			for (const AnimationComponent::AnimationChannel& channel : animation.channels)
+			for (size_t channel_index = 0; channel_index < animation.channels.size(); ++channel_index)
 			{
+				const AnimationComponent::AnimationChannel& channel = animation.channels[channel_index];
 				assert(channel.samplerIndex < (int)animation.samplers.size());
 				const AnimationComponent::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
 				const AnimationDataComponent* animationdata = animation_datas.GetComponent(sampler.data);
@@ -2753,59 +3054,24 @@ namespace wi::scene
 					continue;
 				}
 
-				float timeFirst = std::numeric_limits<float>::max();
-				float timeLast = std::numeric_limits<float>::min();
-				int keyLeft = 0;	float timeLeft = std::numeric_limits<float>::min();
-				int keyRight = 0;	float timeRight = std::numeric_limits<float>::max();
-
-				// search for usable keyframes:
-				for (int k = 0; k < (int)animationdata->keyframe_times.size(); ++k)
-				{
-					const float time = animationdata->keyframe_times[k];
-					if (time < timeFirst)
-					{
-						timeFirst = time;
-					}
-					if (time > timeLast)
-					{
-						timeLast = time;
-					}
-					if (time <= animation.timer && time > timeLeft)
-					{
-						timeLeft = time;
-						keyLeft = k;
-					}
-					if (time >= animation.timer && time < timeRight)
-					{
-						timeRight = time;
-						keyRight = k;
-					}
-				}
-				if (animation.timer < timeFirst || animation.timer > timeLast)
-				{
-					// timer is outside range of keyframes, don't update animation:
-					continue;
-				}
-
-				const float left = animationdata->keyframe_times[keyLeft];
-				const float right = animationdata->keyframe_times[keyRight];
-
-				TransformComponent transform;
-				LightComponent light;
-
-				TransformComponent* target_transform = nullptr;
-				MeshComponent* target_mesh = nullptr;
-				LightComponent* target_light = nullptr;
+				AnimationSample sample;
+				sample.animation = &animation;
+				sample.channel_index = (uint32_t)channel_index;
+				sample.data = animationdata;
+				sample.time = animation.timer;
+				sample.amount = animation.amount;
 
 				if (channel.path == AnimationComponent::AnimationChannel::Path::WEIGHTS)
 				{
 					ObjectComponent* object = objects.GetComponent(channel.target);
 					if (object == nullptr)
 						continue;
-					target_mesh = meshes.GetComponent(object->meshID);
-					if (target_mesh == nullptr)
+					sample.target_mesh = meshes.GetComponent(object->meshID);
+					if (sample.target_mesh == nullptr)
 						continue;
-					animation.morph_weights_temp.resize(target_mesh->morph_targets.size());
+					sample.weight_offset = weight_count_total;
+					sample.weight_count = (uint32_t)sample.target_mesh->morph_targets.size();
+					weight_count_total += sample.weight_count;
 				}
 				else if (
 					channel.path == AnimationComponent::AnimationChannel::Path::LIGHT_COLOR ||
@@ -2815,446 +3081,750 @@ namespace wi::scene
 					channel.path == AnimationComponent::AnimationChannel::Path::LIGHT_OUTERCONE
 					)
 				{
-					target_light = lights.GetComponent(channel.target);
-					if (target_light == nullptr)
+					sample.target_light = lights.GetComponent(channel.target);
+					if (sample.target_light == nullptr)
 						continue;
-					light = *target_light;
 				}
 				else
 				{
-					target_transform = transforms.GetComponent(channel.target);
-					if (target_transform == nullptr)
+					sample.target_transform = transforms.GetComponent(channel.target);
+					if (sample.target_transform == nullptr)
 						continue;
-					transform = *target_transform;
 				}
 
-				switch (sampler.mode)
+				animation_samples.push_back(sample);
+			}
+
+			// The timer can be advanced now, because the samples store the current time:
+			if (animation.IsPlaying())
+			{
+				animation.timer += dt * animation.speed;
+			}
+
+			if (animation.IsLooped() && animation.timer > animation.end)
+			{
+				animation.timer = animation.start;
+			}
+		}
+		animation_sample_weights.resize(weight_count_total);
+
+		// Sample all channels in parallel into the staging buffer, the targets are not modified here:
+		wi::jobsystem::Dispatch(ctx, (uint32_t)animation_samples.size(), small_subtask_groupsize, [&](wi::jobsystem::JobArgs args) {
+
+			AnimationSample& sample = animation_samples[args.jobIndex];
+			AnimationComponent::AnimationChannel& channel = sample.animation->channels[sample.channel_index];
+			const AnimationComponent::AnimationSampler& sampler = sample.animation->samplers[channel.samplerIndex];
+			const AnimationDataComponent* animationdata = sample.data;
+
+			int keyLeft = 0;
+			int keyRight = 0;
+			if (!FindKeyframes(animationdata->keyframe_times, sample.time, channel.cached_key, keyLeft, keyRight))
+			{
+				// timer is outside range of keyframes, don't update animation:
+				return;
+			}
+			sample.valid = true;
+
+			const float left = animationdata->keyframe_times[keyLeft];
+			const float right = animationdata->keyframe_times[keyRight];
+
+			float* weights = animation_sample_weights.data() + sample.weight_offset;
+			const size_t weight_count = sample.weight_count;
+
+			switch (sampler.mode)
+			{
+			default:
+			case AnimationComponent::AnimationSampler::Mode::STEP:
+			{
+				// Nearest neighbor method:
+				const int key = wi::math::InverseLerp(left, right, sample.time) > 0.5f ? keyRight : keyLeft;
+				switch (channel.path)
 				{
 				default:
-				case AnimationComponent::AnimationSampler::Mode::STEP:
+				case AnimationComponent::AnimationChannel::Path::TRANSLATION:
 				{
-					// Nearest neighbor method:
-					const int key = wi::math::InverseLerp(timeLeft, timeRight, animation.timer) > 0.5f ? keyRight : keyLeft;
-					switch (channel.path)
-					{
-					default:
-					case AnimationComponent::AnimationChannel::Path::TRANSLATION:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-						transform.translation_local = ((const XMFLOAT3*)animationdata->keyframe_data.data())[key];
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::ROTATION:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4);
-						transform.rotation_local = ((const XMFLOAT4*)animationdata->keyframe_data.data())[key];
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::SCALE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-						transform.scale_local = ((const XMFLOAT3*)animationdata->keyframe_data.data())[key];
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::WEIGHTS:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * animation.morph_weights_temp.size());
-						for (size_t j = 0; j < animation.morph_weights_temp.size(); ++j)
-						{
-							animation.morph_weights_temp[j] = animationdata->keyframe_data[key * animation.morph_weights_temp.size() + j];
-						}
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_COLOR:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-						light.color = ((const XMFLOAT3*)animationdata->keyframe_data.data())[key];
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_INTENSITY:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						light.intensity = animationdata->keyframe_data[key];
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_RANGE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						light.range = animationdata->keyframe_data[key];
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_INNERCONE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						light.innerConeAngle = animationdata->keyframe_data[key];
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_OUTERCONE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						light.outerConeAngle = animationdata->keyframe_data[key];
-					}
-					break;
-					}
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
+					sample.translation = ((const XMFLOAT3*)animationdata->keyframe_data.data())[key];
 				}
 				break;
-				case AnimationComponent::AnimationSampler::Mode::LINEAR:
+				case AnimationComponent::AnimationChannel::Path::ROTATION:
 				{
-					// Linear interpolation method:
-					float t;
-					if (keyLeft == keyRight)
-					{
-						t = 0;
-					}
-					else
-					{
-						t = (animation.timer - left) / (right - left);
-					}
-
-					switch (channel.path)
-					{
-					default:
-					case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4);
+					sample.rotation = ((const XMFLOAT4*)animationdata->keyframe_data.data())[key];
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::SCALE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
+					sample.scale = ((const XMFLOAT3*)animationdata->keyframe_data.data())[key];
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::WEIGHTS:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * weight_count);
+					for (size_t j = 0; j < weight_count; ++j)
 					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-						const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
-						XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft]);
-						XMVECTOR vRight = XMLoadFloat3(&data[keyRight]);
-						XMVECTOR vAnim = XMVectorLerp(vLeft, vRight, t);
-						XMStoreFloat3(&transform.translation_local, vAnim);
+						weights[j] = animationdata->keyframe_data[key * weight_count + j];
 					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::ROTATION:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4);
-						const XMFLOAT4* data = (const XMFLOAT4*)animationdata->keyframe_data.data();
-						XMVECTOR vLeft = XMLoadFloat4(&data[keyLeft]);
-						XMVECTOR vRight = XMLoadFloat4(&data[keyRight]);
-						XMVECTOR vAnim = XMQuaternionSlerp(vLeft, vRight, t);
-						vAnim = XMQuaternionNormalize(vAnim);
-						XMStoreFloat4(&transform.rotation_local, vAnim);
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::SCALE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-						const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
-						XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft]);
-						XMVECTOR vRight = XMLoadFloat3(&data[keyRight]);
-						XMVECTOR vAnim = XMVectorLerp(vLeft, vRight, t);
-						XMStoreFloat3(&transform.scale_local, vAnim);
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::WEIGHTS:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * animation.morph_weights_temp.size());
-						for (size_t j = 0; j < animation.morph_weights_temp.size(); ++j)
-						{
-							float vLeft = animationdata->keyframe_data[keyLeft * animation.morph_weights_temp.size() + j];
-							float vRight = animationdata->keyframe_data[keyRight * animation.morph_weights_temp.size() + j];
-							float vAnim = wi::math::Lerp(vLeft, vRight, t);
-							animation.morph_weights_temp[j] = vAnim;
-						}
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_COLOR:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-						const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
-						XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft]);
-						XMVECTOR vRight = XMLoadFloat3(&data[keyRight]);
-						XMVECTOR vAnim = XMVectorLerp(vLeft, vRight, t);
-						XMStoreFloat3(&light.color, vAnim);
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_INTENSITY:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						float vLeft = animationdata->keyframe_data[keyLeft];
-						float vRight = animationdata->keyframe_data[keyRight];
-						float vAnim = wi::math::Lerp(vLeft, vRight, t);
-						light.intensity = vAnim;
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_RANGE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						float vLeft = animationdata->keyframe_data[keyLeft];
-						float vRight = animationdata->keyframe_data[keyRight];
-						float vAnim = wi::math::Lerp(vLeft, vRight, t);
-						light.range = vAnim;
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_INNERCONE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						float vLeft = animationdata->keyframe_data[keyLeft];
-						float vRight = animationdata->keyframe_data[keyRight];
-						float vAnim = wi::math::Lerp(vLeft, vRight, t);
-						light.innerConeAngle = vAnim;
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_OUTERCONE:
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_COLOR:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
+					sample.color = ((const XMFLOAT3*)animationdata->keyframe_data.data())[key];
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_INTENSITY:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					sample.intensity = animationdata->keyframe_data[key];
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_RANGE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					sample.range = animationdata->keyframe_data[key];
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_INNERCONE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					sample.innerConeAngle = animationdata->keyframe_data[key];
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_OUTERCONE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					sample.outerConeAngle = animationdata->keyframe_data[key];
+				}
+				break;
+				}
+			}
+			break;
+			case AnimationComponent::AnimationSampler::Mode::LINEAR:
+			{
+				// Linear interpolation method:
+				float t;
+				if (keyLeft == keyRight)
+				{
+					t = 0;
+				}
+				else
+				{
+					t = (sample.time - left) / (right - left);
+				}
+
+				switch (channel.path)
+				{
+				default:
+				case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
+					const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
+					XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft]);
+					XMVECTOR vRight = XMLoadFloat3(&data[keyRight]);
+					XMVECTOR vAnim = XMVectorLerp(vLeft, vRight, t);
+					XMStoreFloat3(&sample.translation, vAnim);
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::ROTATION:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4);
+					const XMFLOAT4* data = (const XMFLOAT4*)animationdata->keyframe_data.data();
+					XMVECTOR vLeft = XMLoadFloat4(&data[keyLeft]);
+					XMVECTOR vRight = XMLoadFloat4(&data[keyRight]);
+					XMVECTOR vAnim = XMQuaternionSlerp(vLeft, vRight, t);
+					vAnim = XMQuaternionNormalize(vAnim);
+					XMStoreFloat4(&sample.rotation, vAnim);
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::SCALE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
+					const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
+					XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft]);
+					XMVECTOR vRight = XMLoadFloat3(&data[keyRight]);
+					XMVECTOR vAnim = XMVectorLerp(vLeft, vRight, t);
+					XMStoreFloat3(&sample.scale, vAnim);
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::WEIGHTS:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * weight_count);
+					for (size_t j = 0; j < weight_count; ++j)
 					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						float vLeft = animationdata->keyframe_data[keyLeft];
-						float vRight = animationdata->keyframe_data[keyRight];
+						float vLeft = animationdata->keyframe_data[keyLeft * weight_count + j];
+						float vRight = animationdata->keyframe_data[keyRight * weight_count + j];
 						float vAnim = wi::math::Lerp(vLeft, vRight, t);
-						light.outerConeAngle = vAnim;
-					}
-					break;
+						weights[j] = vAnim;
 					}
 				}
 				break;
-				case AnimationComponent::AnimationSampler::Mode::CUBICSPLINE:
+				case AnimationComponent::AnimationChannel::Path::LIGHT_COLOR:
 				{
-					// Cubic Spline interpolation method:
-					float t;
-					if (keyLeft == keyRight)
-					{
-						t = 0;
-					}
-					else
-					{
-						t = (animation.timer - left) / (right - left);
-					}
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
+					const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
+					XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft]);
+					XMVECTOR vRight = XMLoadFloat3(&data[keyRight]);
+					XMVECTOR vAnim = XMVectorLerp(vLeft, vRight, t);
+					XMStoreFloat3(&sample.color, vAnim);
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_INTENSITY:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					float vLeft = animationdata->keyframe_data[keyLeft];
+					float vRight = animationdata->keyframe_data[keyRight];
+					float vAnim = wi::math::Lerp(vLeft, vRight, t);
+					sample.intensity = vAnim;
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_RANGE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					float vLeft = animationdata->keyframe_data[keyLeft];
+					float vRight = animationdata->keyframe_data[keyRight];
+					float vAnim = wi::math::Lerp(vLeft, vRight, t);
+					sample.range = vAnim;
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_INNERCONE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					float vLeft = animationdata->keyframe_data[keyLeft];
+					float vRight = animationdata->keyframe_data[keyRight];
+					float vAnim = wi::math::Lerp(vLeft, vRight, t);
+					sample.innerConeAngle = vAnim;
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_OUTERCONE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					float vLeft = animationdata->keyframe_data[keyLeft];
+					float vRight = animationdata->keyframe_data[keyRight];
+					float vAnim = wi::math::Lerp(vLeft, vRight, t);
+					sample.outerConeAngle = vAnim;
+				}
+				break;
+				}
+			}
+			break;
+			case AnimationComponent::AnimationSampler::Mode::CUBICSPLINE:
+			{
+				// Cubic Spline interpolation method:
+				float t;
+				if (keyLeft == keyRight)
+				{
+					t = 0;
+				}
+				else
+				{
+					t = (sample.time - left) / (right - left);
+				}
 
-					const float t2 = t * t;
-					const float t3 = t2 * t;
+				const float t2 = t * t;
+				const float t3 = t2 * t;
 
-					switch (channel.path)
-					{
-					default:
-					case AnimationComponent::AnimationChannel::Path::TRANSLATION:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3 * 3);
-						const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
-						XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft * 3 + 1]);
-						XMVECTOR vLeftTanOut = dt * XMLoadFloat3(&data[keyLeft * 3 + 2]);
-						XMVECTOR vRightTanIn = dt * XMLoadFloat3(&data[keyRight * 3 + 0]);
-						XMVECTOR vRight = XMLoadFloat3(&data[keyRight * 3 + 1]);
-						XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-						XMStoreFloat3(&transform.translation_local, vAnim);
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::ROTATION:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4 * 3);
-						const XMFLOAT4* data = (const XMFLOAT4*)animationdata->keyframe_data.data();
-						XMVECTOR vLeft = XMLoadFloat4(&data[keyLeft * 3 + 1]);
-						XMVECTOR vLeftTanOut = dt * XMLoadFloat4(&data[keyLeft * 3 + 2]);
-						XMVECTOR vRightTanIn = dt * XMLoadFloat4(&data[keyRight * 3 + 0]);
-						XMVECTOR vRight = XMLoadFloat4(&data[keyRight * 3 + 1]);
-						XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-						vAnim = XMQuaternionNormalize(vAnim);
-						XMStoreFloat4(&transform.rotation_local, vAnim);
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::SCALE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3 * 3);
-						const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
-						XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft * 3 + 1]);
-						XMVECTOR vLeftTanOut = dt * XMLoadFloat3(&data[keyLeft * 3 + 2]);
-						XMVECTOR vRightTanIn = dt * XMLoadFloat3(&data[keyRight * 3 + 0]);
-						XMVECTOR vRight = XMLoadFloat3(&data[keyRight * 3 + 1]);
-						XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-						XMStoreFloat3(&transform.scale_local, vAnim);
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::WEIGHTS:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * animation.morph_weights_temp.size() * 3);
-						for (size_t j = 0; j < animation.morph_weights_temp.size(); ++j)
-						{
-							float vLeft = animationdata->keyframe_data[(keyLeft * animation.morph_weights_temp.size() + j) * 3 + 1];
-							float vLeftTanOut = animationdata->keyframe_data[(keyLeft * animation.morph_weights_temp.size() + j) * 3 + 2];
-							float vRightTanIn = animationdata->keyframe_data[(keyRight * animation.morph_weights_temp.size() + j) * 3 + 0];
-							float vRight = animationdata->keyframe_data[(keyRight * animation.morph_weights_temp.size() + j) * 3 + 1];
-							float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-							animation.morph_weights_temp[j] = vAnim;
-						}
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_COLOR:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3 * 3);
-						const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
-						XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft * 3 + 1]);
-						XMVECTOR vLeftTanOut = dt * XMLoadFloat3(&data[keyLeft * 3 + 2]);
-						XMVECTOR vRightTanIn = dt * XMLoadFloat3(&data[keyRight * 3 + 0]);
-						XMVECTOR vRight = XMLoadFloat3(&data[keyRight * 3 + 1]);
-						XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-						XMStoreFloat3(&light.color, vAnim);
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_INTENSITY:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						float vLeft = animationdata->keyframe_data[keyLeft * 3 + 1];
-						float vLeftTanOut = animationdata->keyframe_data[keyLeft * 3 + 2];
-						float vRightTanIn = animationdata->keyframe_data[keyRight * 3 + 0];
-						float vRight = animationdata->keyframe_data[keyRight * 3 + 1];
-						float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-						light.intensity = vAnim;
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_RANGE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						float vLeft = animationdata->keyframe_data[keyLeft * 3 + 1];
-						float vLeftTanOut = animationdata->keyframe_data[keyLeft * 3 + 2];
-						float vRightTanIn = animationdata->keyframe_data[keyRight * 3 + 0];
-						float vRight = animationdata->keyframe_data[keyRight * 3 + 1];
-						float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-						light.range = vAnim;
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_INNERCONE:
-					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						float vLeft = animationdata->keyframe_data[keyLeft * 3 + 1];
-						float vLeftTanOut = animationdata->keyframe_data[keyLeft * 3 + 2];
-						float vRightTanIn = animationdata->keyframe_data[keyRight * 3 + 0];
-						float vRight = animationdata->keyframe_data[keyRight * 3 + 1];
-						float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-						light.innerConeAngle = vAnim;
-					}
-					break;
-					case AnimationComponent::AnimationChannel::Path::LIGHT_OUTERCONE:
+				switch (channel.path)
+				{
+				default:
+				case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3 * 3);
+					const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
+					XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft * 3 + 1]);
+					XMVECTOR vLeftTanOut = dt * XMLoadFloat3(&data[keyLeft * 3 + 2]);
+					XMVECTOR vRightTanIn = dt * XMLoadFloat3(&data[keyRight * 3 + 0]);
+					XMVECTOR vRight = XMLoadFloat3(&data[keyRight * 3 + 1]);
+					XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+					XMStoreFloat3(&sample.translation, vAnim);
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::ROTATION:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4 * 3);
+					const XMFLOAT4* data = (const XMFLOAT4*)animationdata->keyframe_data.data();
+					XMVECTOR vLeft = XMLoadFloat4(&data[keyLeft * 3 + 1]);
+					XMVECTOR vLeftTanOut = dt * XMLoadFloat4(&data[keyLeft * 3 + 2]);
+					XMVECTOR vRightTanIn = dt * XMLoadFloat4(&data[keyRight * 3 + 0]);
+					XMVECTOR vRight = XMLoadFloat4(&data[keyRight * 3 + 1]);
+					XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+					vAnim = XMQuaternionNormalize(vAnim);
+					XMStoreFloat4(&sample.rotation, vAnim);
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::SCALE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3 * 3);
+					const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
+					XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft * 3 + 1]);
+					XMVECTOR vLeftTanOut = dt * XMLoadFloat3(&data[keyLeft * 3 + 2]);
+					XMVECTOR vRightTanIn = dt * XMLoadFloat3(&data[keyRight * 3 + 0]);
+					XMVECTOR vRight = XMLoadFloat3(&data[keyRight * 3 + 1]);
+					XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+					XMStoreFloat3(&sample.scale, vAnim);
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::WEIGHTS:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * weight_count * 3);
+					for (size_t j = 0; j < weight_count; ++j)
 					{
-						assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
-						float vLeft = animationdata->keyframe_data[keyLeft * 3 + 1];
-						float vLeftTanOut = animationdata->keyframe_data[keyLeft * 3 + 2];
-						float vRightTanIn = animationdata->keyframe_data[keyRight * 3 + 0];
-						float vRight = animationdata->keyframe_data[keyRight * 3 + 1];
+						float vLeft = animationdata->keyframe_data[(keyLeft * weight_count + j) * 3 + 1];
+						float vLeftTanOut = animationdata->keyframe_data[(keyLeft * weight_count + j) * 3 + 2];
+						float vRightTanIn = animationdata->keyframe_data[(keyRight * weight_count + j) * 3 + 0];
+						float vRight = animationdata->keyframe_data[(keyRight * weight_count + j) * 3 + 1];
 						float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-						light.outerConeAngle = vAnim;
-					}
-					break;
+						weights[j] = vAnim;
 					}
 				}
 				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_COLOR:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3 * 3);
+					const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
+					XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft * 3 + 1]);
+					XMVECTOR vLeftTanOut = dt * XMLoadFloat3(&data[keyLeft * 3 + 2]);
+					XMVECTOR vRightTanIn = dt * XMLoadFloat3(&data[keyRight * 3 + 0]);
+					XMVECTOR vRight = XMLoadFloat3(&data[keyRight * 3 + 1]);
+					XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+					XMStoreFloat3(&sample.color, vAnim);
 				}
-
-				const float t = animation.amount;
-
-				if (target_transform != nullptr)
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_INTENSITY:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					float vLeft = animationdata->keyframe_data[keyLeft * 3 + 1];
+					float vLeftTanOut = animationdata->keyframe_data[keyLeft * 3 + 2];
+					float vRightTanIn = animationdata->keyframe_data[keyRight * 3 + 0];
+					float vRight = animationdata->keyframe_data[keyRight * 3 + 1];
+					float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+					sample.intensity = vAnim;
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_RANGE:
 				{
-					target_transform->SetDirty();
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					float vLeft = animationdata->keyframe_data[keyLeft * 3 + 1];
+					float vLeftTanOut = animationdata->keyframe_data[keyLeft * 3 + 2];
+					float vRightTanIn = animationdata->keyframe_data[keyRight * 3 + 0];
+					float vRight = animationdata->keyframe_data[keyRight * 3 + 1];
+					float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+					sample.range = vAnim;
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_INNERCONE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					float vLeft = animationdata->keyframe_data[keyLeft * 3 + 1];
+					float vLeftTanOut = animationdata->keyframe_data[keyLeft * 3 + 2];
+					float vRightTanIn = animationdata->keyframe_data[keyRight * 3 + 0];
+					float vRight = animationdata->keyframe_data[keyRight * 3 + 1];
+					float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+					sample.innerConeAngle = vAnim;
+				}
+				break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_OUTERCONE:
+				{
+					assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size());
+					float vLeft = animationdata->keyframe_data[keyLeft * 3 + 1];
+					float vLeftTanOut = animationdata->keyframe_data[keyLeft * 3 + 2];
+					float vRightTanIn = animationdata->keyframe_data[keyRight * 3 + 0];
+					float vRight = animationdata->keyframe_data[keyRight * 3 + 1];
+					float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+					sample.outerConeAngle = vAnim;
+				}
+				break;
+				}
+			}
+			break;
+			}
 
-					const XMVECTOR aS = XMLoadFloat3(&target_transform->scale_local);
-					const XMVECTOR aR = XMLoadFloat4(&target_transform->rotation_local);
-					const XMVECTOR aT = XMLoadFloat3(&target_transform->translation_local);
+		});
+		wi::jobsystem::Wait(ctx);
 
-					const XMVECTOR bS = XMLoadFloat3(&transform.scale_local);
-					const XMVECTOR bR = XMLoadFloat4(&transform.rotation_local);
-					const XMVECTOR bT = XMLoadFloat3(&transform.translation_local);
+		// Apply the samples in the original channel order, because multiple animations can blend the same targets:
+		for (const AnimationSample& sample : animation_samples)
+		{
+			if (!sample.valid)
+			{
+				continue;
+			}
 
-					const XMVECTOR S = XMVectorLerp(aS, bS, t);
-					const XMVECTOR R = XMQuaternionSlerp(aR, bR, t);
-					const XMVECTOR T = XMVectorLerp(aT, bT, t);
+			const AnimationComponent::AnimationChannel& channel = sample.animation->channels[sample.channel_index];
+			const float t = sample.amount;
 
-					XMStoreFloat3(&target_transform->scale_local, S);
-					XMStoreFloat4(&target_transform->rotation_local, R);
-					XMStoreFloat3(&target_transform->translation_local, T);
-				}
+			if (sample.target_transform != nullptr)
+			{
+				TransformComponent* target_transform = sample.target_transform;
+				target_transform->SetDirty();
 
-				if (target_mesh != nullptr)
+				switch (channel.path)
 				{
-					for (size_t j = 0; j < target_mesh->morph_targets.size(); ++j)
-					{
-						target_mesh->morph_targets[j].weight = wi::math::Lerp(target_mesh->morph_targets[j].weight, animation.morph_weights_temp[j], t);
-					}
-
-					target_mesh->dirty_morph = true;
+				default:
+				case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+					XMStoreFloat3(&target_transform->translation_local, XMVectorLerp(XMLoadFloat3(&target_transform->translation_local), XMLoadFloat3(&sample.translation), t));
+					break;
+				case AnimationComponent::AnimationChannel::Path::ROTATION:
+					XMStoreFloat4(&target_transform->rotation_local, XMQuaternionSlerp(XMLoadFloat4(&target_transform->rotation_local), XMLoadFloat4(&sample.rotation), t));
+					break;
+				case AnimationComponent::AnimationChannel::Path::SCALE:
+					XMStoreFloat3(&target_transform->scale_local, XMVectorLerp(XMLoadFloat3(&target_transform->scale_local), XMLoadFloat3(&sample.scale), t));
+					break;
 				}
+			}
 
-				if (target_light != nullptr)
+			if (sample.target_mesh != nullptr)
+			{
+				MeshComponent* target_mesh = sample.target_mesh;
+				const float* weights = animation_sample_weights.data() + sample.weight_offset;
+				for (size_t j = 0; j < target_mesh->morph_targets.size() && j < sample.weight_count; ++j)
 				{
-					target_light->color = wi::math::Lerp(target_light->color, light.color, t);
-					target_light->intensity = wi::math::Lerp(target_light->intensity, light.intensity, t);
-					target_light->range = wi::math::Lerp(target_light->range, light.range, t);
-					target_light->innerConeAngle = wi::math::Lerp(target_light->innerConeAngle, light.innerConeAngle, t);
-					target_light->outerConeAngle = wi::math::Lerp(target_light->outerConeAngle, light.outerConeAngle, t);
+					target_mesh->morph_targets[j].weight = wi::math::Lerp(target_mesh->morph_targets[j].weight, weights[j], t);
 				}
 
+				target_mesh->dirty_morph = true;
 			}
 
-			if (animation.IsPlaying())
+			if (sample.target_light != nullptr)
 			{
-				animation.timer += dt * animation.speed;
-			}
-
-			if (animation.IsLooped() && animation.timer > animation.end)
-			{
-				animation.timer = animation.start;
+				LightComponent* target_light = sample.target_light;
+				switch (channel.path)
+				{
+				default:
+				case AnimationComponent::AnimationChannel::Path::LIGHT_COLOR:
+					target_light->color = wi::math::Lerp(target_light->color, sample.color, t);
+					break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_INTENSITY:
+					target_light->intensity = wi::math::Lerp(target_light->intensity, sample.intensity, t);
+					break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_RANGE:
+					target_light->range = wi::math::Lerp(target_light->range, sample.range, t);
+					break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_INNERCONE:
+					target_light->innerConeAngle = wi::math::Lerp(target_light->innerConeAngle, sample.innerConeAngle, t);
+					break;
+				case AnimationComponent::AnimationChannel::Path::LIGHT_OUTERCONE:
+					target_light->outerConeAngle = wi::math::Lerp(target_light->outerConeAngle, sample.outerConeAngle, t);
+					break;
+				}
 			}
 		}
 	}
+	void Scene::TransformSoA::resize(size_t count)
+	{
+		scale_x.resize(count);
+		scale_y.resize(count);
+		scale_z.resize(count);
+		rotation_x.resize(count);
+		rotation_y.resize(count);
+		rotation_z.resize(count);
+		rotation_w.resize(count);
+		translation_x.resize(count);
+		translation_y.resize(count);
+		translation_z.resize(count);
+		world.resize(count);
+	}
+	void Scene::TransformSoA::set(size_t index, TransformComponent& transform)
+	{
+		scale_x[index] = transform.scale_local.x;
+		scale_y[index] = transform.scale_local.y;
+		scale_z[index] = transform.scale_local.z;
+		rotation_x[index] = transform.rotation_local.x;
+		rotation_y[index] = transform.rotation_local.y;
+		rotation_z[index] = transform.rotation_local.z;
+		rotation_w[index] = transform.rotation_local.w;
+		translation_x[index] = transform.translation_local.x;
+		translation_y[index] = transform.translation_local.y;
+		translation_z[index] = transform.translation_local.z;
+		world[index] = &transform.world;
+	}
+	wi::math::TransformArrays Scene::TransformSoA::get(size_t offset) const
+	{
+		wi::math::TransformArrays arrays;
+		arrays.scale_x = scale_x.data() + offset;
+		arrays.scale_y = scale_y.data() + offset;
+		arrays.scale_z = scale_z.data() + offset;
+		arrays.rotation_x = rotation_x.data() + offset;
+		arrays.rotation_y = rotation_y.data() + offset;
+		arrays.rotation_z = rotation_z.data() + offset;
+		arrays.rotation_w = rotation_w.data() + offset;
+		arrays.translation_x = translation_x.data() + offset;
+		arrays.translation_y = translation_y.data() + offset;
+		arrays.translation_z = translation_z.data() + offset;
+		return arrays;
+	}
 	void Scene::RunTransformUpdateSystem(wi::jobsystem::context& ctx)
 	{
+		transforms_changed.resize(transforms.GetCount());
+		transforms_soa.resize(transforms.GetCount());
+
 		wi::jobsystem::Dispatch(ctx, (uint32_t)transforms.GetCount(), small_subtask_groupsize, [&](wi::jobsystem::JobArgs args) {
 
+			// Dirty transforms of the group are gathered into the structure of arrays, then the world matrices are composed at once by the last job of the group:
+			uint32_t& batch_count = *(uint32_t*)args.sharedmemory;
+			if (args.isFirstJobInGroup)
+			{
+				batch_count = 0;
+			}
+			const size_t batch_offset = args.groupID * small_subtask_groupsize;
+
 			TransformComponent& transform = transforms[args.jobIndex];
-			transform.UpdateTransform();
-		});
+			transforms_changed[args.jobIndex] = transform.IsChanged() ? 1 : 0;
+			transform._flags &= ~TransformComponent::CHANGED;
+			if (transform.IsDirty())
+			{
+				transform.SetDirty(false);
+				transforms_soa.set(batch_offset + batch_count, transform);
+				batch_count++;
+			}
+
+			if (args.isLastJobInGroup && batch_count > 0)
+			{
+				wi::math::ComposeTransforms(transforms_soa.get(batch_offset), transforms_soa.world.data() + batch_offset, batch_count);
+			}
+		}, sizeof(uint32_t));
 	}
-	void Scene::RunHierarchyUpdateSystem(wi::jobsystem::context& ctx)
+	void Scene::BuildHierarchyUpdateOrder()
 	{
-		wi::jobsystem::Dispatch(ctx, (uint32_t)hierarchy.GetCount(), small_subtask_groupsize, [&](wi::jobsystem::JobArgs args) {
-
-			HierarchyComponent& hier = hierarchy[args.jobIndex];
-			Entity entity = hierarchy.GetEntity(args.jobIndex);
+		const uint32_t count = (uint32_t)hierarchy.GetCount();
 
-			TransformComponent* transform_child = transforms.GetComponent(entity);
-			XMMATRIX worldmatrix;
-			if (transform_child != nullptr)
+		// Dense parent indices within the hierarchy and depths:
+		wi::vector<uint32_t> parents(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			parents[i] = (uint32_t)hierarchy.GetIndex(hierarchy[i].parentID);
+		}
+		wi::vector<uint32_t> depths(count, ~0u);
+		wi::vector<uint32_t> path;
+		uint32_t max_depth = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			// Walk up until a node with known depth or a root is found, then assign depths on the way back:
+			path.clear();
+			uint32_t node = i;
+			while (node != ~0u && depths[node] == ~0u && path.size() <= count)
+			{
+				path.push_back(node);
+				node = parents[node];
+			}
+			assert(path.size() <= count); // cyclic hierarchy
+			uint32_t depth = (node == ~0u || depths[node] == ~0u) ? 0 : depths[node] + 1;
+			for (auto it = path.rbegin(); it != path.rend(); ++it)
 			{
-				worldmatrix = transform_child->GetLocalMatrix();
+				depths[*it] = depth;
+				max_depth = std::max(max_depth, depth);
+				depth++;
 			}
+		}
+
+		// Counting sort by depth:
+		hierarchy_update_levels.clear();
+		hierarchy_update_levels.resize(max_depth + 2);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			hierarchy_update_levels[depths[i] + 1]++;
+		}
+		for (uint32_t level = 1; level < (uint32_t)hierarchy_update_levels.size(); ++level)
+		{
+			hierarchy_update_levels[level] += hierarchy_update_levels[level - 1];
+		}
+		wi::vector<uint32_t> offsets = hierarchy_update_levels;
+		wi::vector<uint32_t> order(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			order[offsets[depths[i]]++] = i;
+		}
 
-			LayerComponent* layer_child = layers.GetComponent(entity);
-			if (layer_child != nullptr)
+		// Resolve component indices in parent before child order, so that the closest ancestors can be propagated from parents:
+		wi::vector<uint32_t> node_of_hierarchy(count);
+		hierarchy_update_nodes.resize(count);
+		for (uint32_t n = 0; n < count; ++n)
+		{
+			const uint32_t i = order[n];
+			node_of_hierarchy[i] = n;
+			const Entity entity = hierarchy.GetEntity(i);
+			const Entity parentID = hierarchy[i].parentID;
+
+			HierarchyUpdateNode& node = hierarchy_update_nodes[n];
+			node = {};
+			node.parentID = parentID;
+			node.hierarchy_index = i;
+			node.transform_index = (uint32_t)transforms.GetIndex(entity);
+			node.layer_index = (uint32_t)layers.GetIndex(entity);
+
+			const uint32_t parent = parents[i];
+			if (parent == ~0u)
+			{
+				// Parent is a root:
+				node.parent_transform_index = (uint32_t)transforms.GetIndex(parentID);
+				node.parent_layer_index = (uint32_t)layers.GetIndex(parentID);
+				continue;
+			}
+			const HierarchyUpdateNode& parent_node = hierarchy_update_nodes[node_of_hierarchy[parent]];
+			if (parent_node.transform_index != ~0u)
+			{
+				node.parent_transform_index = parent_node.transform_index;
+				node.parent_transform_in_hierarchy = true;
+			}
+			else
+			{
+				node.parent_transform_index = parent_node.parent_transform_index;
+				node.parent_transform_in_hierarchy = parent_node.parent_transform_in_hierarchy;
+			}
+			if (parent_node.layer_index != ~0u)
 			{
-				layer_child->propagationMask = ~0u; // clear propagation mask to full
+				node.parent_layer_index = parent_node.layer_index;
+				node.parent_layer_in_hierarchy = true;
 			}
+			else
+			{
+				node.parent_layer_index = parent_node.parent_layer_index;
+				node.parent_layer_in_hierarchy = parent_node.parent_layer_in_hierarchy;
+			}
+		}
 
-			if (transform_child == nullptr && layer_child == nullptr)
-				return;
+		hierarchy_update_versions[0] = hierarchy.GetVersion();
+		hierarchy_update_versions[1] = transforms.GetVersion();
+		hierarchy_update_versions[2] = layers.GetVersion();
+	}
+	void Scene::UpdateHierarchyChildren()
+	{
+		if (!hierarchy_children_dirty && hierarchy_children_version == hierarchy.GetVersion())
+		{
+			return;
+		}
+
+		// Count the children per parent, then place them after each other in hierarchy order:
+		const size_t count = hierarchy.GetCount();
+		hierarchy_children_ranges.clear();
+		for (size_t i = 0; i < count; ++i)
+		{
+			hierarchy_children_ranges[hierarchy[i].parentID].count++;
+		}
+		uint32_t offset = 0;
+		for (auto& it : hierarchy_children_ranges)
+		{
+			it.second.offset = offset;
+			offset += it.second.count;
+			it.second.count = 0;
+		}
+		hierarchy_children.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			HierarchyChildren& range = hierarchy_children_ranges[hierarchy[i].parentID];
+			hierarchy_children[range.offset + range.count++] = hierarchy.GetEntity(i);
+		}
 
-			Entity parentID = hier.parentID;
-			while (parentID != INVALID_ENTITY)
+		hierarchy_children_version = hierarchy.GetVersion();
+		hierarchy_children_dirty = false;
+	}
+	void Scene::RunHierarchyUpdateSystem(wi::jobsystem::context& ctx)
+	{
+		bool valid =
+			hierarchy_update_versions[0] == hierarchy.GetVersion() &&
+			hierarchy_update_versions[1] == transforms.GetVersion() &&
+			hierarchy_update_versions[2] == layers.GetVersion();
+		for (size_t i = 0; i < hierarchy_update_nodes.size() && valid; ++i)
+		{
+			// Parents can also be changed without adding or removing components:
+			const HierarchyUpdateNode& node = hierarchy_update_nodes[i];
+			valid = hierarchy[node.hierarchy_index].parentID == node.parentID;
+		}
+		if (!valid)
+		{
+			BuildHierarchyUpdateOrder();
+
+			// Cached world matrices can't be trusted after the hierarchy changed:
+			std::fill(transforms_changed.begin(), transforms_changed.end(), uint8_t(1));
+		}
+
+		transform_statistics.transform_count = (uint32_t)transforms_changed.size();
+		transform_statistics.local_changed_count = (uint32_t)std::count(transforms_changed.begin(), transforms_changed.end(), uint8_t(1));
+		transform_statistics.full_update = !valid;
+
+		// A node is computed from its closest ancestors, which are either roots or were updated in a previous level:
+		//	world = local * parent_world
+		//	propagationMask = parent_layerMask & parent_propagationMask
+		//	The world matrix is only recomputed if the local space or the parent world matrix changed
+		auto update_node = [&](const HierarchyUpdateNode& node) {
+			if (node.transform_index != ~0u && (transforms_changed[node.transform_index] || (node.parent_transform_index != ~0u && transforms_changed[node.parent_transform_index])))
 			{
-				TransformComponent* transform_parent = transforms.GetComponent(parentID);
-				if (transform_child != nullptr && transform_parent != nullptr)
-				{
-					worldmatrix *= transform_parent->GetLocalMatrix();
-				}
+				transforms_changed[node.transform_index] = 1;
 
-				LayerComponent* layer_parent = layers.GetComponent(parentID);
-				if (layer_child != nullptr && layer_parent != nullptr)
+				TransformComponent& transform_child = transforms[node.transform_index];
+				XMMATRIX worldmatrix = transform_child.GetLocalMatrix();
+				if (node.parent_transform_index != ~0u)
 				{
-					layer_child->propagationMask &= layer_parent->layerMask;
+					const TransformComponent& transform_parent = transforms[node.parent_transform_index];
+					if (node.parent_transform_in_hierarchy)
+					{
+						worldmatrix *= XMLoadFloat4x4(&transform_parent.world);
+					}
+					else
+					{
+						worldmatrix *= transform_parent.GetLocalMatrix();
+					}
 				}
-
-				const HierarchyComponent* hier_recursive = hierarchy.GetComponent(parentID);
-				if (hier_recursive != nullptr)
+				XMStoreFloat4x4(&transform_child.world, worldmatrix);
+			}
+			if (node.layer_index != ~0u)
+			{
+				LayerComponent& layer_child = layers[node.layer_index];
+				layer_child.propagationMask = ~0u;
+				if (node.parent_layer_index != ~0u)
 				{
-					parentID = hier_recursive->parentID;
+					const LayerComponent& layer_parent = layers[node.parent_layer_index];
+					layer_child.propagationMask &= layer_parent.layerMask;
+					if (node.parent_layer_in_hierarchy)
+					{
+						layer_child.propagationMask &= layer_parent.propagationMask;
+					}
 				}
-				else
+			}
+		};
+
+		// Levels are processed in order, small levels (for example the bones of a single skeleton) are not worth distributing:
+		for (size_t level = 0; level + 1 < hierarchy_update_levels.size(); ++level)
+		{
+			const uint32_t offset = hierarchy_update_levels[level];
+			const uint32_t count = hierarchy_update_levels[level + 1] - offset;
+			if (count < small_subtask_groupsize * 2)
+			{
+				for (uint32_t i = 0; i < count; ++i)
 				{
-					parentID = INVALID_ENTITY;
+					update_node(hierarchy_update_nodes[offset + i]);
 				}
 			}
-
-			if (transform_child != nullptr)
+			else
 			{
-				XMStoreFloat4x4(&transform_child->world, worldmatrix);
+				wi::jobsystem::Dispatch(ctx, count, small_subtask_groupsize, [&](wi::jobsystem::JobArgs args) {
+					update_node(hierarchy_update_nodes[offset + args.jobIndex]);
+				});
+				wi::jobsystem::Wait(ctx);
 			}
+		}
 
-		});
+		transform_statistics.world_changed_count = (uint32_t)std::count(transforms_changed.begin(), transforms_changed.end(), uint8_t(1));
+	}
+	void Scene::CommitTransformsTemp()
+	{
+		for (size_t i = 0; i < transforms.GetCount(); ++i)
+		{
+			// IK and springs shouldn't modify local space, so only update the world matrices!
+			TransformComponent& transform = transforms[i];
+			const TransformComponent& transform_temp = transforms_temp[i];
+			if (std::memcmp(&transform.world, &transform_temp.world, sizeof(transform.world)) == 0)
+				continue;
+			transform.world = transform_temp.world;
+			if (!transforms_changed[i])
+			{
+				transforms_changed[i] = 1;
+				transform_statistics.world_changed_count++;
+			}
+			// The modified world matrix doesn't match the local space, it will need to be recomputed in the next frame:
+			transform.SetDirty();
+		}
 	}
 	void Scene::RunSpringUpdateSystem(wi::jobsystem::context& ctx)
 	{
@@ -3356,11 +3926,7 @@ namespace wi::scene
 
 		if (springs.GetCount() > 0)
 		{
-			for (size_t i = 0; i < transforms.GetCount(); ++i)
-			{
-				// IK shouldn't modify local space, so only update the world matrices!
-				transforms[i].world = transforms_temp[i].world;
-			}
+			CommitTransformsTemp();
 		}
 	}
 	void Scene::RunInverseKinematicsUpdateSystem(wi::jobsystem::context& ctx)
@@ -3481,11 +4047,7 @@ namespace wi::scene
 
 		if (inverse_kinematics.GetCount() > 0)
 		{
-			for (size_t i = 0; i < transforms.GetCount(); ++i)
-			{
-				// IK shouldn't modify local space, so only update the world matrices!
-				transforms[i].world = transforms_temp[i].world;
-			}
+			CommitTransformsTemp();
 		}
 	}
 	void Scene::RunArmatureUpdateSystem(wi::jobsystem::context& ctx)
@@ -3574,7 +4136,8 @@ namespace wi::scene
 			mesh._flags &= ~MeshComponent::TLAS_FORCE_DOUBLE_SIDED;
 
 			// Update morph targets if needed:
-			if (mesh.dirty_morph && !mesh.morph_targets.empty())
+			const bool morph_update = mesh.dirty_morph && !mesh.morph_targets.empty();
+			if (morph_update)
 			{
 			    XMFLOAT3 _min = XMFLOAT3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
 			    XMFLOAT3 _max = XMFLOAT3(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
@@ -3609,6 +4172,12 @@ namespace wi::scene
 			    mesh.aabb = AABB(_min, _max);
 			}
 
+			// Triangle BVH for CPU queries. Skinned and soft body meshes are queried by brute force, because their vertices move every frame:
+			if (!mesh.IsSkinned() && !mesh.indices.empty() && (!mesh.bvh.IsValid() || morph_update) && !softbodies.Contains(entity))
+			{
+				mesh.UpdateBVH();
+			}
+
 			ShaderGeometry geometry;
 			geometry.init();
 			geometry.ib = mesh.ib.descriptor_srv;
@@ -3951,15 +4520,22 @@ namespace wi::scene
 				{
 					const MeshComponent& mesh = meshes[object.mesh_index];
 
-					XMMATRIX W = XMLoadFloat4x4(&transform.world);
-					aabb = mesh.aabb.transform(W);
-
-					// This is instance bounding box matrix:
-					XMFLOAT4X4 meshMatrix;
-					XMStoreFloat4x4(&meshMatrix, mesh.aabb.getAsBoxMatrix() * W);
+					// The transformed bounds are only recomputed if the world matrix or the mesh bounds changed:
+					const bool bounds_changed =
+						transforms_changed[transform_index] ||
+						std::memcmp(&object.cached_mesh_aabb._min, &mesh.aabb._min, sizeof(XMFLOAT3)) != 0 ||
+						std::memcmp(&object.cached_mesh_aabb._max, &mesh.aabb._max, sizeof(XMFLOAT3)) != 0;
+					if (bounds_changed)
+					{
+						XMMATRIX W = XMLoadFloat4x4(&transform.world);
+						object.cached_mesh_aabb = mesh.aabb;
+						object.cached_aabb = mesh.aabb.transform(W);
 
-					// We need sometimes the center of the instance bounding box, not the transform position (which can be outside the bounding box)
-					object.center = *((XMFLOAT3*)&meshMatrix._41);
+						XMMATRIX worldMatrixInverseTranspose = XMMatrixInverse(nullptr, W);
+						worldMatrixInverseTranspose = XMMatrixTranspose(worldMatrixInverseTranspose);
+						XMStoreFloat4x4(&object.worldMatrixInverseTranspose, worldMatrixInverseTranspose);
+					}
+					aabb = object.cached_aabb;
 
 					if (mesh.IsSkinned() || mesh.IsDynamic())
 					{
@@ -4030,14 +4606,7 @@ namespace wi::scene
 					inst.transformPrev.Create(object.worldMatrix);
 					object.worldMatrix = transform_index == ~0u ? wi::math::IDENTITY_MATRIX : transforms[transform_index].world;
 					inst.transform.Create(object.worldMatrix);
-
-					XMMATRIX worldMatrixInverseTranspose = XMLoadFloat4x4(&object.worldMatrix);
-					worldMatrixInverseTranspose = XMMatrixInverse(nullptr, worldMatrixInverseTranspose);
-					worldMatrixInverseTranspose = XMMatrixTranspose(worldMatrixInverseTranspose);
-					XMFLOAT4X4 transformIT;
-					XMStoreFloat4x4(&transformIT, worldMatrixInverseTranspose);
-
-					inst.transformInverseTranspose.Create(transformIT);
+					inst.transformInverseTranspose.Create(transform_index == ~0u ? wi::math::IDENTITY_MATRIX : object.worldMatrixInverseTranspose);
 					if (object.lightmap.IsValid())
 					{
 						inst.lightmap = device->GetDescriptorIndex(&object.lightmap, SubresourceType::SRV);
@@ -4077,7 +4646,7 @@ namespace wi::scene
 							instance.flags |= RaytracingAccelerationStructureDesc::TopLevel::Instance::FLAG_TRIANGLE_CULL_DISABLE;
 						}
 						
-						if (XMVectorGetX(XMMatrixDeterminant(W)) > 0)
+						if (XMVectorGetX(XMMatrixDeterminant(XMLoadFloat4x4(&transform.world))) > 0)
 						{
 							// There is a mismatch between object space winding and BLAS winding:
 							//	https://docs.microsoft.com/en-us/windows/win32/api/d3d12/ne-d3d12-d3d12_raytracing_instance_flags
@@ -4190,30 +4759,39 @@ namespace wi::scene
 	{
 		assert(decals.GetCount() == aabb_decals.GetCount());
 
+		const bool full_update = decal_update_version != decals.GetVersion();
+		decal_update_version = decals.GetVersion();
+
 		for (size_t i = 0; i < decals.GetCount(); ++i)
 		{
 			DecalComponent& decal = decals[i];
 			Entity entity = decals.GetEntity(i);
-			if (!transforms.Contains(entity))
+			size_t transform_index = transforms.GetIndex(entity);
+			if (transform_index == ~0ull)
 				continue;
-			const TransformComponent& transform = *transforms.GetComponent(entity);
-			decal.world = transform.world;
-
-			XMMATRIX W = XMLoadFloat4x4(&decal.world);
-			XMVECTOR front = XMVectorSet(0, 0, 1, 0);
-			front = XMVector3TransformNormal(front, W);
-			XMStoreFloat3(&decal.front, front);
-
-			XMVECTOR S, R, T;
-			XMMatrixDecompose(&S, &R, &T, W);
-			XMStoreFloat3(&decal.position, T);
-			XMFLOAT3 scale;
-			XMStoreFloat3(&scale, S);
-			decal.range = std::max(scale.x, std::max(scale.y, scale.z)) * 2;
-
+			const TransformComponent& transform = transforms[transform_index];
 			AABB& aabb = aabb_decals[i];
-			aabb.createFromHalfWidth(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
-			aabb = aabb.transform(transform.world);
+
+			// Placement is only recomputed if the world matrix changed:
+			if (full_update || transforms_changed[transform_index])
+			{
+				decal.world = transform.world;
+
+				XMMATRIX W = XMLoadFloat4x4(&decal.world);
+				XMVECTOR front = XMVectorSet(0, 0, 1, 0);
+				front = XMVector3TransformNormal(front, W);
+				XMStoreFloat3(&decal.front, front);
+
+				XMVECTOR S, R, T;
+				XMMatrixDecompose(&S, &R, &T, W);
+				XMStoreFloat3(&decal.position, T);
+				XMFLOAT3 scale;
+				XMStoreFloat3(&scale, S);
+				decal.range = std::max(scale.x, std::max(scale.y, scale.z)) * 2;
+
+				aabb.createFromHalfWidth(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
+				aabb = aabb.transform(transform.world);
+			}
 
 			const LayerComponent* layer = layers.GetComponent(entity);
 			if (layer == nullptr)
@@ -4459,13 +5037,17 @@ namespace wi::scene
 	{
 		assert(lights.GetCount() == aabb_lights.GetCount());
 
-		wi::jobsystem::Dispatch(ctx, (uint32_t)lights.GetCount(), small_subtask_groupsize, [&](wi::jobsystem::JobArgs args) {
+		const bool full_update = light_update_version != lights.GetVersion();
+		light_update_version = lights.GetVersion();
+
+		wi::jobsystem::Dispatch(ctx, (uint32_t)lights.GetCount(), small_subtask_groupsize, [&, full_update](wi::jobsystem::JobArgs args) {
 
 			LightComponent& light = lights[args.jobIndex];
 			Entity entity = lights.GetEntity(args.jobIndex);
-			if (!transforms.Contains(entity))
+			size_t transform_index = transforms.GetIndex(entity);
+			if (transform_index == ~0ull)
 				return;
-			const TransformComponent& transform = *transforms.GetComponent(entity);
+			const TransformComponent& transform = transforms[transform_index];
 			AABB& aabb = aabb_lights[args.jobIndex];
 
 			light.occlusionquery = -1;
@@ -4480,14 +5062,18 @@ namespace wi::scene
 				aabb.layerMask = layer->GetLayerMask();
 			}
 
-			XMMATRIX W = XMLoadFloat4x4(&transform.world);
-			XMVECTOR S, R, T;
-			XMMatrixDecompose(&S, &R, &T, W);
-
-			XMStoreFloat3(&light.position, T);
-			XMStoreFloat4(&light.rotation, R);
-			XMStoreFloat3(&light.scale, S);
-			XMStoreFloat3(&light.direction, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(0, 1, 0, 0), W)));
+			// Placement is only recomputed if the world matrix changed, the bounds are always recomputed because the range can change without it:
+			if (full_update || transforms_changed[transform_index])
+			{
+				XMMATRIX W = XMLoadFloat4x4(&transform.world);
+				XMVECTOR S, R, T;
+				XMMatrixDecompose(&S, &R, &T, W);
+
+				XMStoreFloat3(&light.position, T);
+				XMStoreFloat4(&light.rotation, R);
+				XMStoreFloat3(&light.scale, S);
+				XMStoreFloat3(&light.direction, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(0, 1, 0, 0), W)));
+			}
 
 			switch (light.type)
 			{
@@ -4886,6 +5472,14 @@ namespace wi::scene
 		return INVALID_ENTITY;
 	}
 
+	// Calls callback(object_index) for objects whose AABB passes aabb_intersects
+	//	When the object BVH of the scene is up to date, only the intersecting subtrees are visited
+	template<typename AABBIntersects, typename Callback>
+	inline void IntersectObjects(const Scene& scene, const AABBIntersects& aabb_intersects, const Callback& callback)
+	{
+		scene.object_bvh.Query(scene.aabb_objects.GetComponentArray().data(), (uint32_t)scene.aabb_objects.GetCount(), aabb_intersects, callback);
+	}
+
 	PickResult Pick(const Ray& ray, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
 	{
 		PickResult result;
@@ -4895,29 +5489,22 @@ namespace wi::scene
 			const XMVECTOR rayOrigin = XMLoadFloat3(&ray.origin);
 			const XMVECTOR rayDirection = XMVector3Normalize(XMLoadFloat3(&ray.direction));
 
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
-			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (!ray.intersects(aabb))
-				{
-					continue;
-				}
-
+			IntersectObjects(scene, [&](const AABB& aabb) { return ray.intersects(aabb); }, [&](uint32_t i) {
 				const ObjectComponent& object = scene.objects[i];
 				if (object.meshID == INVALID_ENTITY)
 				{
-					continue;
+					return;
 				}
 				if (!(renderTypeMask & object.GetRenderTypes()))
 				{
-					continue;
+					return;
 				}
 
 				Entity entity = scene.aabb_objects.GetEntity(i);
 				const LayerComponent* layer = scene.layers.GetComponent(entity);
 				if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
 				{
-					continue;
+					return;
 				}
 
 				const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
@@ -4932,79 +5519,97 @@ namespace wi::scene
 
 				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 
-				uint32_t first_subset = 0;
-				uint32_t last_subset = 0;
-				mesh.GetLODSubsetRange(0, first_subset, last_subset);
-				for (uint32_t subsetIndex = first_subset; subsetIndex < last_subset; ++subsetIndex)
-				{
-					const MeshComponent::MeshSubset& subset = mesh.subsets[subsetIndex];
-					for (size_t i = 0; i < subset.indexCount; i += 3)
-					{
-						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
-						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
-						const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
+				auto intersect_triangle = [&](uint32_t subsetIndex, uint32_t indexOffset) {
+					const uint32_t i0 = mesh.indices[indexOffset + 0];
+					const uint32_t i1 = mesh.indices[indexOffset + 1];
+					const uint32_t i2 = mesh.indices[indexOffset + 2];
 
-						XMVECTOR p0;
-						XMVECTOR p1;
-						XMVECTOR p2;
+					XMVECTOR p0;
+					XMVECTOR p1;
+					XMVECTOR p2;
 
-						if (softbody_active)
-						{
-							p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
-							p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
-							p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
-						}
-						else
+					if (softbody_active)
+					{
+						p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
+						p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
+						p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+					}
+					else
+					{
+						if (armature == nullptr)
 						{
-							if (armature == nullptr)
-							{
-								if (mesh.vertex_positions_morphed.empty())
-							    {
-									p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
-									p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
-									p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
-								}
-								else
-								{
-								    p0 = mesh.vertex_positions_morphed[i0].LoadPOS();
-								    p1 = mesh.vertex_positions_morphed[i1].LoadPOS();
-								    p2 = mesh.vertex_positions_morphed[i2].LoadPOS();
-								}
+							if (mesh.vertex_positions_morphed.empty())
+						    {
+								p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
+								p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
+								p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
 							}
 							else
 							{
-								p0 = SkinVertex(mesh, *armature, i0);
-								p1 = SkinVertex(mesh, *armature, i1);
-								p2 = SkinVertex(mesh, *armature, i2);
+							    p0 = mesh.vertex_positions_morphed[i0].LoadPOS();
+							    p1 = mesh.vertex_positions_morphed[i1].LoadPOS();
+							    p2 = mesh.vertex_positions_morphed[i2].LoadPOS();
 							}
 						}
+						else
+						{
+							p0 = SkinVertex(mesh, *armature, i0);
+							p1 = SkinVertex(mesh, *armature, i1);
+							p2 = SkinVertex(mesh, *armature, i2);
+						}
+					}
+
+					float distance;
+					XMFLOAT2 bary;
+					if (wi::math::RayTriangleIntersects(rayOrigin_local, rayDirection_local, p0, p1, p2, distance, bary, ray.TMin, ray.TMax))
+					{
+						const XMVECTOR pos = XMVector3Transform(XMVectorAdd(rayOrigin_local, rayDirection_local*distance), objectMat);
+						distance = wi::math::Distance(pos, rayOrigin);
 
-						float distance;
-						XMFLOAT2 bary;
-						if (wi::math::RayTriangleIntersects(rayOrigin_local, rayDirection_local, p0, p1, p2, distance, bary, ray.TMin, ray.TMax))
+						if (distance < result.distance)
 						{
-							const XMVECTOR pos = XMVector3Transform(XMVectorAdd(rayOrigin_local, rayDirection_local*distance), objectMat);
-							distance = wi::math::Distance(pos, rayOrigin);
+							const XMVECTOR nor = XMVector3Normalize(XMVector3TransformNormal(XMVector3Cross(XMVectorSubtract(p2, p1), XMVectorSubtract(p1, p0)), objectMat));
 
-							if (distance < result.distance)
-							{
-								const XMVECTOR nor = XMVector3Normalize(XMVector3TransformNormal(XMVector3Cross(XMVectorSubtract(p2, p1), XMVectorSubtract(p1, p0)), objectMat));
-
-								result.entity = entity;
-								XMStoreFloat3(&result.position, pos);
-								XMStoreFloat3(&result.normal, nor);
-								result.distance = distance;
-								result.subsetIndex = (int)subsetIndex;
-								result.vertexID0 = (int)i0;
-								result.vertexID1 = (int)i1;
-								result.vertexID2 = (int)i2;
-								result.bary = bary;
-							}
+							result.entity = entity;
+							XMStoreFloat3(&result.position, pos);
+							XMStoreFloat3(&result.normal, nor);
+							result.distance = distance;
+							result.subsetIndex = (int)subsetIndex;
+							result.vertexID0 = (int)i0;
+							result.vertexID1 = (int)i1;
+							result.vertexID2 = (int)i2;
+							result.bary = bary;
+						}
+					}
+				};
+
+				if (armature == nullptr && !softbody_active && mesh.bvh.IsValid())
+				{
+					// Only the triangles in the leaves that the local space ray intersects are tested:
+					const Ray ray_local = Ray(rayOrigin_local, rayDirection_local, ray.TMin, ray.TMax);
+					mesh.bvh.Intersects([&](const AABB& aabb) { return ray_local.intersects(aabb); }, [&](uint32_t triangle) {
+						uint32_t subsetIndex = 0;
+						uint32_t indexOffset = 0;
+						mesh.GetBVHTriangle(triangle, subsetIndex, indexOffset);
+						intersect_triangle(subsetIndex, indexOffset);
+					});
+				}
+				else
+				{
+					uint32_t first_subset = 0;
+					uint32_t last_subset = 0;
+					mesh.GetLODSubsetRange(0, first_subset, last_subset);
+					for (uint32_t subsetIndex = first_subset; subsetIndex < last_subset; ++subsetIndex)
+					{
+						const MeshComponent::MeshSubset& subset = mesh.subsets[subsetIndex];
+						for (uint32_t i = 0; i < subset.indexCount; i += 3)
+						{
+							intersect_triangle(subsetIndex, subset.indexOffset + i);
 						}
 					}
 				}
 
-			}
+				});
 		}
 
 		// Construct a matrix that will orient to position (P) according to surface normal (N):
@@ -5028,30 +5633,23 @@ namespace wi::scene
 
 		if (scene.objects.GetCount() > 0)
 		{
-
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
-			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (!sphere.intersects(aabb))
-				{
-					continue;
-				}
-
+			bool found = false;
+			IntersectObjects(scene, [&](const AABB& aabb) { return !found && sphere.intersects(aabb); }, [&](uint32_t i) {
 				const ObjectComponent& object = scene.objects[i];
 				if (object.meshID == INVALID_ENTITY)
 				{
-					continue;
+					return;
 				}
 				if (!(renderTypeMask & object.GetRenderTypes()))
 				{
-					continue;
+					return;
 				}
 
 				Entity entity = scene.aabb_objects.GetEntity(i);
 				const LayerComponent* layer = scene.layers.GetComponent(entity);
 				if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
 				{
-					continue;
+					return;
 				}
 
 				const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
@@ -5062,162 +5660,183 @@ namespace wi::scene
 
 				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 
-				uint32_t first_subset = 0;
-				uint32_t last_subset = 0;
-				mesh.GetLODSubsetRange(0, first_subset, last_subset);
-				for (uint32_t subsetIndex = first_subset; subsetIndex < last_subset; ++subsetIndex)
-				{
-					const MeshComponent::MeshSubset& subset = mesh.subsets[subsetIndex];
-					for (size_t i = 0; i < subset.indexCount; i += 3)
-					{
-						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
-						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
-						const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
+				auto intersect_triangle = [&](uint32_t subsetIndex, uint32_t indexOffset) {
+					const uint32_t i0 = mesh.indices[indexOffset + 0];
+					const uint32_t i1 = mesh.indices[indexOffset + 1];
+					const uint32_t i2 = mesh.indices[indexOffset + 2];
 
-						XMVECTOR p0;
-						XMVECTOR p1;
-						XMVECTOR p2;
+					XMVECTOR p0;
+					XMVECTOR p1;
+					XMVECTOR p2;
 
-						if (softbody_active)
+					if (softbody_active)
+					{
+						p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
+						p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
+						p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+					}
+					else
+					{
+						if (armature == nullptr)
 						{
-							p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
-							p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
-							p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+							p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
+							p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
+							p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
 						}
 						else
 						{
-							if (armature == nullptr)
-							{
-								p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
-								p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
-								p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
-							}
-							else
-							{
-								p0 = SkinVertex(mesh, *armature, i0);
-								p1 = SkinVertex(mesh, *armature, i1);
-								p2 = SkinVertex(mesh, *armature, i2);
-							}
+							p0 = SkinVertex(mesh, *armature, i0);
+							p1 = SkinVertex(mesh, *armature, i1);
+							p2 = SkinVertex(mesh, *armature, i2);
 						}
+					}
 
-						p0 = XMVector3Transform(p0, objectMat);
-						p1 = XMVector3Transform(p1, objectMat);
-						p2 = XMVector3Transform(p2, objectMat);
+					p0 = XMVector3Transform(p0, objectMat);
+					p1 = XMVector3Transform(p1, objectMat);
+					p2 = XMVector3Transform(p2, objectMat);
 
-						XMFLOAT3 min, max;
-						XMStoreFloat3(&min, XMVectorMin(p0, XMVectorMin(p1, p2)));
-						XMStoreFloat3(&max, XMVectorMax(p0, XMVectorMax(p1, p2)));
-						AABB aabb_triangle(min, max);
-						if (sphere.intersects(aabb_triangle) == AABB::OUTSIDE)
-						{
-							continue;
-						}
+					XMFLOAT3 min, max;
+					XMStoreFloat3(&min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+					XMStoreFloat3(&max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+					AABB aabb_triangle(min, max);
+					if (sphere.intersects(aabb_triangle) == AABB::OUTSIDE)
+					{
+						return;
+					}
 
-						// Compute the plane of the triangle (has to be normalized).
-						XMVECTOR N = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+					// Compute the plane of the triangle (has to be normalized).
+					XMVECTOR N = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
 
-						// Assert that the triangle is not degenerate.
-						assert(!XMVector3Equal(N, XMVectorZero()));
+					// Assert that the triangle is not degenerate.
+					assert(!XMVector3Equal(N, XMVectorZero()));
 
-						// Find the nearest feature on the triangle to the sphere.
-						XMVECTOR Dist = XMVector3Dot(XMVectorSubtract(Center, p0), N);
+					// Find the nearest feature on the triangle to the sphere.
+					XMVECTOR Dist = XMVector3Dot(XMVectorSubtract(Center, p0), N);
 
-						if (!mesh.IsDoubleSided() && XMVectorGetX(Dist) > 0)
-						{
-							continue; // pass through back faces
-						}
+					if (!mesh.IsDoubleSided() && XMVectorGetX(Dist) > 0)
+					{
+						return; // pass through back faces
+					}
 
-						// If the center of the sphere is farther from the plane of the triangle than
-						// the radius of the sphere, then there cannot be an intersection.
-						XMVECTOR NoIntersection = XMVectorLess(Dist, XMVectorNegate(Radius));
-						NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(Dist, Radius));
+					// If the center of the sphere is farther from the plane of the triangle than
+					// the radius of the sphere, then there cannot be an intersection.
+					XMVECTOR NoIntersection = XMVectorLess(Dist, XMVectorNegate(Radius));
+					NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(Dist, Radius));
 
-						// Project the center of the sphere onto the plane of the triangle.
-						XMVECTOR Point0 = XMVectorNegativeMultiplySubtract(N, Dist, Center);
+					// Project the center of the sphere onto the plane of the triangle.
+					XMVECTOR Point0 = XMVectorNegativeMultiplySubtract(N, Dist, Center);
 
-						// Is it inside all the edges? If so we intersect because the distance 
-						// to the plane is less than the radius.
-						//XMVECTOR Intersection = DirectX::Internal::PointOnPlaneInsideTriangle(Point0, p0, p1, p2);
+					// Is it inside all the edges? If so we intersect because the distance 
+					// to the plane is less than the radius.
+					//XMVECTOR Intersection = DirectX::Internal::PointOnPlaneInsideTriangle(Point0, p0, p1, p2);
 
-						// Compute the cross products of the vector from the base of each edge to 
-						// the point with each edge vector.
-						XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(Point0, p0), XMVectorSubtract(p1, p0));
-						XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(Point0, p1), XMVectorSubtract(p2, p1));
-						XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(Point0, p2), XMVectorSubtract(p0, p2));
+					// Compute the cross products of the vector from the base of each edge to 
+					// the point with each edge vector.
+					XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(Point0, p0), XMVectorSubtract(p1, p0));
+					XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(Point0, p1), XMVectorSubtract(p2, p1));
+					XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(Point0, p2), XMVectorSubtract(p0, p2));
 
-						// If the cross product points in the same direction as the normal the the
-						// point is inside the edge (it is zero if is on the edge).
-						XMVECTOR Zero = XMVectorZero();
-						XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
-						XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
-						XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
+					// If the cross product points in the same direction as the normal the the
+					// point is inside the edge (it is zero if is on the edge).
+					XMVECTOR Zero = XMVectorZero();
+					XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
+					XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
+					XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
 
-						// If the point inside all of the edges it is inside.
-						XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
+					// If the point inside all of the edges it is inside.
+					XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
 
-						bool inside = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+					bool inside = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
 
-						// Find the nearest point on each edge.
+					// Find the nearest point on each edge.
 
-						// Edge 0,1
-						XMVECTOR Point1 = DirectX::Internal::PointOnLineSegmentNearestPoint(p0, p1, Center);
+					// Edge 0,1
+					XMVECTOR Point1 = DirectX::Internal::PointOnLineSegmentNearestPoint(p0, p1, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point1)), RadiusSq));
+					// If the distance to the center of the sphere to the point is less than 
+					// the radius of the sphere then it must intersect.
+					Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point1)), RadiusSq));
 
-						// Edge 1,2
-						XMVECTOR Point2 = DirectX::Internal::PointOnLineSegmentNearestPoint(p1, p2, Center);
+					// Edge 1,2
+					XMVECTOR Point2 = DirectX::Internal::PointOnLineSegmentNearestPoint(p1, p2, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point2)), RadiusSq));
+					// If the distance to the center of the sphere to the point is less than 
+					// the radius of the sphere then it must intersect.
+					Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point2)), RadiusSq));
 
-						// Edge 2,0
-						XMVECTOR Point3 = DirectX::Internal::PointOnLineSegmentNearestPoint(p2, p0, Center);
+					// Edge 2,0
+					XMVECTOR Point3 = DirectX::Internal::PointOnLineSegmentNearestPoint(p2, p0, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point3)), RadiusSq));
+					// If the distance to the center of the sphere to the point is less than 
+					// the radius of the sphere then it must intersect.
+					Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point3)), RadiusSq));
 
-						bool intersects = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+					bool intersects = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
 
-						if (intersects)
+					if (intersects)
+					{
+						XMVECTOR bestPoint = Point0;
+						if (!inside)
 						{
-							XMVECTOR bestPoint = Point0;
-							if (!inside)
-							{
-								// If the sphere center's projection on the triangle plane is not within the triangle,
-								//	determine the closest point on triangle to the sphere center
-								float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - Center));
-								bestPoint = Point1;
+							// If the sphere center's projection on the triangle plane is not within the triangle,
+							//	determine the closest point on triangle to the sphere center
+							float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - Center));
+							bestPoint = Point1;
 
-								float d = XMVectorGetX(XMVector3LengthSq(Point2 - Center));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									bestPoint = Point2;
-								}
-								d = XMVectorGetX(XMVector3LengthSq(Point3 - Center));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									bestPoint = Point3;
-								}
+							float d = XMVectorGetX(XMVector3LengthSq(Point2 - Center));
+							if (d < bestDist)
+							{
+								bestDist = d;
+								bestPoint = Point2;
+							}
+							d = XMVectorGetX(XMVector3LengthSq(Point3 - Center));
+							if (d < bestDist)
+							{
+								bestDist = d;
+								bestPoint = Point3;
 							}
-							XMVECTOR intersectionVec = Center - bestPoint;
-							XMVECTOR intersectionVecLen = XMVector3Length(intersectionVec);
+						}
+						XMVECTOR intersectionVec = Center - bestPoint;
+						XMVECTOR intersectionVecLen = XMVector3Length(intersectionVec);
+
+						result.entity = entity;
+						result.depth = sphere.radius - XMVectorGetX(intersectionVecLen);
+						XMStoreFloat3(&result.position, bestPoint);
+						XMStoreFloat3(&result.normal, intersectionVec / intersectionVecLen);
+						found = true; // the first intersection is returned
+						return;
+					}
+				};
 
-							result.entity = entity;
-							result.depth = sphere.radius - XMVectorGetX(intersectionVecLen);
-							XMStoreFloat3(&result.position, bestPoint);
-							XMStoreFloat3(&result.normal, intersectionVec / intersectionVecLen);
-							return result;
+				if (armature == nullptr && !softbody_active && mesh.bvh.IsValid())
+				{
+					// Only the triangles in the leaves that the sphere bounds intersect in local space are tested:
+					AABB sphere_aabb;
+					sphere_aabb.createFromHalfWidth(sphere.center, XMFLOAT3(sphere.radius, sphere.radius, sphere.radius));
+					const AABB aabb_local = sphere_aabb.transform(XMMatrixInverse(nullptr, objectMat));
+					mesh.bvh.Intersects([&](const AABB& aabb) { return !found && aabb_local.intersects(aabb) != AABB::OUTSIDE; }, [&](uint32_t triangle) {
+						uint32_t subsetIndex = 0;
+						uint32_t indexOffset = 0;
+						mesh.GetBVHTriangle(triangle, subsetIndex, indexOffset);
+						intersect_triangle(subsetIndex, indexOffset);
+					});
+				}
+				else
+				{
+					uint32_t first_subset = 0;
+					uint32_t last_subset = 0;
+					mesh.GetLODSubsetRange(0, first_subset, last_subset);
+					for (uint32_t subsetIndex = first_subset; subsetIndex < last_subset && !found; ++subsetIndex)
+					{
+						const MeshComponent::MeshSubset& subset = mesh.subsets[subsetIndex];
+						for (uint32_t i = 0; i < subset.indexCount && !found; i += 3)
+						{
+							intersect_triangle(subsetIndex, subset.indexOffset + i);
 						}
 					}
 				}
 
-			}
+				});
 		}
 
 		return result;
@@ -5236,30 +5855,23 @@ namespace wi::scene
 
 		if (scene.objects.GetCount() > 0)
 		{
-
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
-			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (capsule_aabb.intersects(aabb) == AABB::INTERSECTION_TYPE::OUTSIDE)
-				{
-					continue;
-				}
-
+			bool found = false;
+			IntersectObjects(scene, [&](const AABB& aabb) { return !found && capsule_aabb.intersects(aabb) != AABB::INTERSECTION_TYPE::OUTSIDE; }, [&](uint32_t i) {
 				const ObjectComponent& object = scene.objects[i];
 				if (object.meshID == INVALID_ENTITY)
 				{
-					continue;
+					return;
 				}
 				if (!(renderTypeMask & object.GetRenderTypes()))
 				{
-					continue;
+					return;
 				}
 
 				Entity entity = scene.aabb_objects.GetEntity(i);
 				const LayerComponent* layer = scene.layers.GetComponent(entity);
 				if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
 				{
-					continue;
+					return;
 				}
 
 				const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
@@ -5270,233 +5882,252 @@ namespace wi::scene
 
 				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 
-				uint32_t first_subset = 0;
-				uint32_t last_subset = 0;
-				mesh.GetLODSubsetRange(0, first_subset, last_subset);
-				for (uint32_t subsetIndex = first_subset; subsetIndex < last_subset; ++subsetIndex)
-				{
-					const MeshComponent::MeshSubset& subset = mesh.subsets[subsetIndex];
-					for (size_t i = 0; i < subset.indexCount; i += 3)
-					{
-						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
-						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
-						const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
+				auto intersect_triangle = [&](uint32_t subsetIndex, uint32_t indexOffset) {
+					const uint32_t i0 = mesh.indices[indexOffset + 0];
+					const uint32_t i1 = mesh.indices[indexOffset + 1];
+					const uint32_t i2 = mesh.indices[indexOffset + 2];
 
-						XMVECTOR p0;
-						XMVECTOR p1;
-						XMVECTOR p2;
+					XMVECTOR p0;
+					XMVECTOR p1;
+					XMVECTOR p2;
 
-						if (softbody_active)
+					if (softbody_active)
+					{
+						p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
+						p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
+						p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+					}
+					else
+					{
+						if (armature == nullptr || armature->boneData.empty())
 						{
-							p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
-							p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
-							p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+							p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
+							p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
+							p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
 						}
 						else
 						{
-							if (armature == nullptr || armature->boneData.empty())
-							{
-								p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
-								p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
-								p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
-							}
-							else
-							{
-								p0 = SkinVertex(mesh, *armature, i0);
-								p1 = SkinVertex(mesh, *armature, i1);
-								p2 = SkinVertex(mesh, *armature, i2);
-							}
-						}
-						
-						p0 = XMVector3Transform(p0, objectMat);
-						p1 = XMVector3Transform(p1, objectMat);
-						p2 = XMVector3Transform(p2, objectMat);
-
-						XMFLOAT3 min, max;
-						XMStoreFloat3(&min, XMVectorMin(p0, XMVectorMin(p1, p2)));
-						XMStoreFloat3(&max, XMVectorMax(p0, XMVectorMax(p1, p2)));
-						AABB aabb_triangle(min, max);
-						if (capsule_aabb.intersects(aabb_triangle) == AABB::OUTSIDE)
-						{
-							continue;
+							p0 = SkinVertex(mesh, *armature, i0);
+							p1 = SkinVertex(mesh, *armature, i1);
+							p2 = SkinVertex(mesh, *armature, i2);
 						}
+					}
+					
+					p0 = XMVector3Transform(p0, objectMat);
+					p1 = XMVector3Transform(p1, objectMat);
+					p2 = XMVector3Transform(p2, objectMat);
+
+					XMFLOAT3 min, max;
+					XMStoreFloat3(&min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+					XMStoreFloat3(&max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+					AABB aabb_triangle(min, max);
+					if (capsule_aabb.intersects(aabb_triangle) == AABB::OUTSIDE)
+					{
+						return;
+					}
 
-						// Compute the plane of the triangle (has to be normalized).
-						XMVECTOR N = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
-						
-						XMVECTOR ReferencePoint;
-						XMVECTOR d = XMVector3Normalize(B - A);
-						if (abs(XMVectorGetX(XMVector3Dot(N, d))) < FLT_EPSILON)
+					// Compute the plane of the triangle (has to be normalized).
+					XMVECTOR N = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+					
+					XMVECTOR ReferencePoint;
+					XMVECTOR d = XMVector3Normalize(B - A);
+					if (abs(XMVectorGetX(XMVector3Dot(N, d))) < FLT_EPSILON)
+					{
+						// Capsule line cannot be intersected with triangle plane (they are parallel)
+						//	In this case, just take a point from triangle
+						ReferencePoint = p0;
+					}
+					else
+					{
+						// Intersect capsule line with triangle plane:
+						XMVECTOR t = XMVector3Dot(N, (Base - p0) / XMVectorAbs(XMVector3Dot(N, d)));
+						XMVECTOR LinePlaneIntersection = Base + d * t;
+
+						// Compute the cross products of the vector from the base of each edge to 
+						// the point with each edge vector.
+						XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p0), XMVectorSubtract(p1, p0));
+						XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p1), XMVectorSubtract(p2, p1));
+						XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p2), XMVectorSubtract(p0, p2));
+
+						// If the cross product points in the same direction as the normal the the
+						// point is inside the edge (it is zero if is on the edge).
+						XMVECTOR Zero = XMVectorZero();
+						XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
+						XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
+						XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
+
+						// If the point inside all of the edges it is inside.
+						XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
+
+						bool inside = XMVectorGetIntX(Intersection) != 0;
+
+						if (inside)
 						{
-							// Capsule line cannot be intersected with triangle plane (they are parallel)
-							//	In this case, just take a point from triangle
-							ReferencePoint = p0;
+							ReferencePoint = LinePlaneIntersection;
 						}
 						else
 						{
-							// Intersect capsule line with triangle plane:
-							XMVECTOR t = XMVector3Dot(N, (Base - p0) / XMVectorAbs(XMVector3Dot(N, d)));
-							XMVECTOR LinePlaneIntersection = Base + d * t;
-
-							// Compute the cross products of the vector from the base of each edge to 
-							// the point with each edge vector.
-							XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p0), XMVectorSubtract(p1, p0));
-							XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p1), XMVectorSubtract(p2, p1));
-							XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(LinePlaneIntersection, p2), XMVectorSubtract(p0, p2));
+							// Find the nearest point on each edge.
 
-							// If the cross product points in the same direction as the normal the the
-							// point is inside the edge (it is zero if is on the edge).
-							XMVECTOR Zero = XMVectorZero();
-							XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
-							XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
-							XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
+							// Edge 0,1
+							XMVECTOR Point1 = wi::math::ClosestPointOnLineSegment(p0, p1, LinePlaneIntersection);
 
-							// If the point inside all of the edges it is inside.
-							XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
+							// Edge 1,2
+							XMVECTOR Point2 = wi::math::ClosestPointOnLineSegment(p1, p2, LinePlaneIntersection);
 
-							bool inside = XMVectorGetIntX(Intersection) != 0;
+							// Edge 2,0
+							XMVECTOR Point3 = wi::math::ClosestPointOnLineSegment(p2, p0, LinePlaneIntersection);
 
-							if (inside)
+							ReferencePoint = Point1;
+							float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - LinePlaneIntersection));
+							float d = abs(XMVectorGetX(XMVector3LengthSq(Point2 - LinePlaneIntersection)));
+							if (d < bestDist)
 							{
-								ReferencePoint = LinePlaneIntersection;
+								bestDist = d;
+								ReferencePoint = Point2;
 							}
-							else
+							d = abs(XMVectorGetX(XMVector3LengthSq(Point3 - LinePlaneIntersection)));
+							if (d < bestDist)
 							{
-								// Find the nearest point on each edge.
-
-								// Edge 0,1
-								XMVECTOR Point1 = wi::math::ClosestPointOnLineSegment(p0, p1, LinePlaneIntersection);
-
-								// Edge 1,2
-								XMVECTOR Point2 = wi::math::ClosestPointOnLineSegment(p1, p2, LinePlaneIntersection);
-
-								// Edge 2,0
-								XMVECTOR Point3 = wi::math::ClosestPointOnLineSegment(p2, p0, LinePlaneIntersection);
-
-								ReferencePoint = Point1;
-								float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - LinePlaneIntersection));
-								float d = abs(XMVectorGetX(XMVector3LengthSq(Point2 - LinePlaneIntersection)));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									ReferencePoint = Point2;
-								}
-								d = abs(XMVectorGetX(XMVector3LengthSq(Point3 - LinePlaneIntersection)));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									ReferencePoint = Point3;
-								}
+								bestDist = d;
+								ReferencePoint = Point3;
 							}
+						}
 
 
-						}
+					}
 
-						// Place a sphere on closest point on line segment to intersection:
-						XMVECTOR Center = wi::math::ClosestPointOnLineSegment(A, B, ReferencePoint);
+					// Place a sphere on closest point on line segment to intersection:
+					XMVECTOR Center = wi::math::ClosestPointOnLineSegment(A, B, ReferencePoint);
 
-						// Assert that the triangle is not degenerate.
-						assert(!XMVector3Equal(N, XMVectorZero()));
+					// Assert that the triangle is not degenerate.
+					assert(!XMVector3Equal(N, XMVectorZero()));
 
-						// Find the nearest feature on the triangle to the sphere.
-						XMVECTOR Dist = XMVector3Dot(XMVectorSubtract(Center, p0), N);
+					// Find the nearest feature on the triangle to the sphere.
+					XMVECTOR Dist = XMVector3Dot(XMVectorSubtract(Center, p0), N);
 
-						if (!mesh.IsDoubleSided() && XMVectorGetX(Dist) > 0)
-						{
-							continue; // pass through back faces
-						}
+					if (!mesh.IsDoubleSided() && XMVectorGetX(Dist) > 0)
+					{
+						return; // pass through back faces
+					}
 
-						// If the center of the sphere is farther from the plane of the triangle than
-						// the radius of the sphere, then there cannot be an intersection.
-						XMVECTOR NoIntersection = XMVectorLess(Dist, XMVectorNegate(Radius));
-						NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(Dist, Radius));
+					// If the center of the sphere is farther from the plane of the triangle than
+					// the radius of the sphere, then there cannot be an intersection.
+					XMVECTOR NoIntersection = XMVectorLess(Dist, XMVectorNegate(Radius));
+					NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(Dist, Radius));
 
-						// Project the center of the sphere onto the plane of the triangle.
-						XMVECTOR Point0 = XMVectorNegativeMultiplySubtract(N, Dist, Center);
+					// Project the center of the sphere onto the plane of the triangle.
+					XMVECTOR Point0 = XMVectorNegativeMultiplySubtract(N, Dist, Center);
 
-						// Is it inside all the edges? If so we intersect because the distance 
-						// to the plane is less than the radius.
-						//XMVECTOR Intersection = DirectX::Internal::PointOnPlaneInsideTriangle(Point0, p0, p1, p2);
+					// Is it inside all the edges? If so we intersect because the distance 
+					// to the plane is less than the radius.
+					//XMVECTOR Intersection = DirectX::Internal::PointOnPlaneInsideTriangle(Point0, p0, p1, p2);
 
-						// Compute the cross products of the vector from the base of each edge to 
-						// the point with each edge vector.
-						XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(Point0, p0), XMVectorSubtract(p1, p0));
-						XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(Point0, p1), XMVectorSubtract(p2, p1));
-						XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(Point0, p2), XMVectorSubtract(p0, p2));
+					// Compute the cross products of the vector from the base of each edge to 
+					// the point with each edge vector.
+					XMVECTOR C0 = XMVector3Cross(XMVectorSubtract(Point0, p0), XMVectorSubtract(p1, p0));
+					XMVECTOR C1 = XMVector3Cross(XMVectorSubtract(Point0, p1), XMVectorSubtract(p2, p1));
+					XMVECTOR C2 = XMVector3Cross(XMVectorSubtract(Point0, p2), XMVectorSubtract(p0, p2));
 
-						// If the cross product points in the same direction as the normal the the
-						// point is inside the edge (it is zero if is on the edge).
-						XMVECTOR Zero = XMVectorZero();
-						XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
-						XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
-						XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
+					// If the cross product points in the same direction as the normal the the
+					// point is inside the edge (it is zero if is on the edge).
+					XMVECTOR Zero = XMVectorZero();
+					XMVECTOR Inside0 = XMVectorLessOrEqual(XMVector3Dot(C0, N), Zero);
+					XMVECTOR Inside1 = XMVectorLessOrEqual(XMVector3Dot(C1, N), Zero);
+					XMVECTOR Inside2 = XMVectorLessOrEqual(XMVector3Dot(C2, N), Zero);
 
-						// If the point inside all of the edges it is inside.
-						XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
+					// If the point inside all of the edges it is inside.
+					XMVECTOR Intersection = XMVectorAndInt(XMVectorAndInt(Inside0, Inside1), Inside2);
 
-						bool inside = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+					bool inside = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
 
-						// Find the nearest point on each edge.
+					// Find the nearest point on each edge.
 
-						// Edge 0,1
-						XMVECTOR Point1 = wi::math::ClosestPointOnLineSegment(p0, p1, Center);
+					// Edge 0,1
+					XMVECTOR Point1 = wi::math::ClosestPointOnLineSegment(p0, p1, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point1)), RadiusSq));
+					// If the distance to the center of the sphere to the point is less than 
+					// the radius of the sphere then it must intersect.
+					Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point1)), RadiusSq));
 
-						// Edge 1,2
-						XMVECTOR Point2 = wi::math::ClosestPointOnLineSegment(p1, p2, Center);
+					// Edge 1,2
+					XMVECTOR Point2 = wi::math::ClosestPointOnLineSegment(p1, p2, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point2)), RadiusSq));
+					// If the distance to the center of the sphere to the point is less than 
+					// the radius of the sphere then it must intersect.
+					Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point2)), RadiusSq));
 
-						// Edge 2,0
-						XMVECTOR Point3 = wi::math::ClosestPointOnLineSegment(p2, p0, Center);
+					// Edge 2,0
+					XMVECTOR Point3 = wi::math::ClosestPointOnLineSegment(p2, p0, Center);
 
-						// If the distance to the center of the sphere to the point is less than 
-						// the radius of the sphere then it must intersect.
-						Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point3)), RadiusSq));
+					// If the distance to the center of the sphere to the point is less than 
+					// the radius of the sphere then it must intersect.
+					Intersection = XMVectorOrInt(Intersection, XMVectorLessOrEqual(XMVector3LengthSq(XMVectorSubtract(Center, Point3)), RadiusSq));
 
-						bool intersects = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
+					bool intersects = XMVector4EqualInt(XMVectorAndCInt(Intersection, NoIntersection), XMVectorTrueInt());
 
-						if (intersects)
+					if (intersects)
+					{
+						XMVECTOR bestPoint = Point0;
+						if (!inside)
 						{
-							XMVECTOR bestPoint = Point0;
-							if (!inside)
-							{
-								// If the sphere center's projection on the triangle plane is not within the triangle,
-								//	determine the closest point on triangle to the sphere center
-								float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - Center));
-								bestPoint = Point1;
+							// If the sphere center's projection on the triangle plane is not within the triangle,
+							//	determine the closest point on triangle to the sphere center
+							float bestDist = XMVectorGetX(XMVector3LengthSq(Point1 - Center));
+							bestPoint = Point1;
 
-								float d = XMVectorGetX(XMVector3LengthSq(Point2 - Center));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									bestPoint = Point2;
-								}
-								d = XMVectorGetX(XMVector3LengthSq(Point3 - Center));
-								if (d < bestDist)
-								{
-									bestDist = d;
-									bestPoint = Point3;
-								}
+							float d = XMVectorGetX(XMVector3LengthSq(Point2 - Center));
+							if (d < bestDist)
+							{
+								bestDist = d;
+								bestPoint = Point2;
+							}
+							d = XMVectorGetX(XMVector3LengthSq(Point3 - Center));
+							if (d < bestDist)
+							{
+								bestDist = d;
+								bestPoint = Point3;
 							}
-							XMVECTOR intersectionVec = Center - bestPoint;
-							XMVECTOR intersectionVecLen = XMVector3Length(intersectionVec);
+						}
+						XMVECTOR intersectionVec = Center - bestPoint;
+						XMVECTOR intersectionVecLen = XMVector3Length(intersectionVec);
+
+						result.entity = entity;
+						result.depth = capsule.radius - XMVectorGetX(intersectionVecLen);
+						XMStoreFloat3(&result.position, bestPoint);
+						XMStoreFloat3(&result.normal, intersectionVec / intersectionVecLen);
+						found = true; // the first intersection is returned
+						return;
+					}
+				};
 
-							result.entity = entity;
-							result.depth = capsule.radius - XMVectorGetX(intersectionVecLen);
-							XMStoreFloat3(&result.position, bestPoint);
-							XMStoreFloat3(&result.normal, intersectionVec / intersectionVecLen);
-							return result;
+				if (armature == nullptr && !softbody_active && mesh.bvh.IsValid())
+				{
+					// Only the triangles in the leaves that the capsule bounds intersect in local space are tested:
+					const AABB aabb_local = capsule_aabb.transform(XMMatrixInverse(nullptr, objectMat));
+					mesh.bvh.Intersects([&](const AABB& aabb) { return !found && aabb_local.intersects(aabb) != AABB::OUTSIDE; }, [&](uint32_t triangle) {
+						uint32_t subsetIndex = 0;
+						uint32_t indexOffset = 0;
+						mesh.GetBVHTriangle(triangle, subsetIndex, indexOffset);
+						intersect_triangle(subsetIndex, indexOffset);
+					});
+				}
+				else
+				{
+					uint32_t first_subset = 0;
+					uint32_t last_subset = 0;
+					mesh.GetLODSubsetRange(0, first_subset, last_subset);
+					for (uint32_t subsetIndex = first_subset; subsetIndex < last_subset && !found; ++subsetIndex)
+					{
+						const MeshComponent::MeshSubset& subset = mesh.subsets[subsetIndex];
+						for (uint32_t i = 0; i < subset.indexCount && !found; i += 3)
+						{
+							intersect_triangle(subsetIndex, subset.indexOffset + i);
 						}
 					}
 				}
 
-			}
+				});
 		}
 
 		return result;
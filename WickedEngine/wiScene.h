@@ -10,6 +10,7 @@
 #include "wiResourceManager.h"
 #include "wiSpinLock.h"
 #include "wiGPUBVH.h"
+#include "wiBVH.h"
 #include "wiOcean.h"
 #include "wiSprite.h"
 #include "wiMath.h"
@@ -21,6 +22,8 @@
 #include <string>
 #include <memory>
 #include <limits>
+#include <unordered_map>
+#include <map>
 
 namespace wi
 {
@@ -29,17 +32,49 @@ namespace wi
 
 namespace wi::scene
 {
+	class NameComponentManager;
+
 	struct NameComponent
 	{
 		std::string name;
 
-		inline void operator=(const std::string& str) { name = str; }
-		inline void operator=(std::string&& str) { name = std::move(str); }
+		// Non-serialized attributes:
+		NameComponentManager* manager = nullptr; // the names of the scene that indexed this component, set by the index
+
+		inline const std::string& GetName() const { return name; }
+		// Renames the component and updates the name index of its scene in place
+		//	Writing name directly is also allowed, but the index only sees it after names.IncrementVersion() or the next added/removed name
+		void SetName(const std::string& value);
+
+		inline void operator=(const std::string& str) { SetName(str); }
+		inline void operator=(std::string&& str) { SetName(str); }
 		inline bool operator==(const std::string& str) const { return name.compare(str) == 0; }
 
 		void Serialize(wi::Archive& archive, wi::ecs::EntitySerializer& seri);
 	};
 
+	// The names of a scene, with indices that find entities by name or by name prefix without scanning every name
+	//	The indices are rebuilt lazily when the version of the manager changes (components added, removed, deserialized...)
+	//	Renames with NameComponent::SetName() update them in place
+	class NameComponentManager : public wi::ecs::ComponentManager<NameComponent>
+	{
+	public:
+		// Returns the entity with the name whose component comes first, or INVALID_ENTITY
+		wi::ecs::Entity Find(const std::string& name);
+		// Appends every entity with the name to the entities array, in component order
+		void FindAll(const std::string& name, wi::vector<wi::ecs::Entity>& entities);
+		// Appends every entity whose name starts with prefix to the entities array, in name order
+		void FindAllPrefix(const std::string& prefix, wi::vector<wi::ecs::Entity>& entities);
+
+	private:
+		std::unordered_multimap<std::string, wi::ecs::Entity> index;
+		std::multimap<std::string, wi::ecs::Entity> sorted_index; // ordered for prefix queries
+		uint64_t index_version = ~0ull;
+		void UpdateIndex(); // rebuilds the indices if the manager changed since they were built
+		void Rename(const NameComponent* component, const std::string& prev_name, const std::string& name);
+		friend struct NameComponent;
+	};
+
 	struct LayerComponent
 	{
 		uint32_t layerMask = ~0u;
@@ -58,8 +93,9 @@ namespace wi::scene
 		{
 			EMPTY = 0,
 			DIRTY = 1 << 0,
+			CHANGED = 1 << 1, // like DIRTY, but only cleared by the scene after the change was propagated to children and dependent bounds
 		};
-		uint32_t _flags = DIRTY;
+		uint32_t _flags = DIRTY | CHANGED;
 
 		XMFLOAT3 scale_local = XMFLOAT3(1, 1, 1);
 		XMFLOAT4 rotation_local = XMFLOAT4(0, 0, 0, 1);	// this is a quaternion
@@ -72,8 +108,9 @@ namespace wi::scene
 		//	- or by calling SetDirty() and letting the TransformUpdateSystem handle the updating
 		XMFLOAT4X4 world = wi::math::IDENTITY_MATRIX;
 
-		inline void SetDirty(bool value = true) { if (value) { _flags |= DIRTY; } else { _flags &= ~DIRTY; } }
+		inline void SetDirty(bool value = true) { if (value) { _flags |= DIRTY | CHANGED; } else { _flags &= ~DIRTY; } }
 		inline bool IsDirty() const { return _flags & DIRTY; }
+		inline bool IsChanged() const { return _flags & CHANGED; }
 
 		XMFLOAT3 GetPosition() const;
 		XMFLOAT4 GetRotation() const;
@@ -459,6 +496,11 @@ namespace wi::scene
 		void RecenterToBottom();
 		wi::primitive::Sphere GetBoundingSphere() const;
 
+		// Builds the triangle BVH for CPU queries, or refits it to the morphed vertex positions if it already exists
+		void UpdateBVH();
+		// Returns the subset index and index buffer offset of a triangle that was returned by the triangle BVH
+		void GetBVHTriangle(uint32_t triangle, uint32_t& subsetIndex, uint32_t& indexOffset) const;
+
 		void Serialize(wi::Archive& archive, wi::ecs::EntitySerializer& seri);
 
 
@@ -604,6 +646,8 @@ namespace wi::scene
 		
 		// Non serialized attributes:
 		wi::vector<Vertex_POS> vertex_positions_morphed;
+		wi::BVH bvh; // triangles of the first LOD in mesh local space, invalidated by CreateRenderData()
+		wi::vector<wi::primitive::AABB> bvh_leaf_aabbs; // triangle bounds for refitting, only kept for morphed meshes
 
 	};
 
@@ -670,6 +714,11 @@ namespace wi::scene
 
 		uint32_t lod = 0;
 
+		// transform dependent data that is only recomputed when the transform or the mesh bounds changed:
+		wi::primitive::AABB cached_mesh_aabb; // mesh bounds that the cached data was computed from
+		wi::primitive::AABB cached_aabb;
+		XMFLOAT4X4 worldMatrixInverseTranspose = wi::math::IDENTITY_MATRIX;
+
 		// these will only be valid for a single frame:
 		uint32_t mesh_index = ~0u;
 		XMFLOAT4X4 worldMatrix = wi::math::IDENTITY_MATRIX;
@@ -1120,6 +1169,9 @@ namespace wi::scene
 				UNKNOWN,
 				TYPE_FORCE_UINT32 = 0xFFFFFFFF
 			} path = TRANSLATION;
+
+			// Non-serialized attributes:
+			uint32_t cached_key = 0; // left keyframe of the last update, the next update starts searching from here
 		};
 		struct AnimationSampler
 		{
@@ -1146,7 +1198,6 @@ namespace wi::scene
 		wi::vector<AnimationSampler> samplers;
 
 		// Non-serialzied attributes:
-		wi::vector<float> morph_weights_temp;
 		float last_update_time = 0;
 
 		inline bool IsPlaying() const { return _flags & PLAYING; }
@@ -1306,12 +1357,32 @@ namespace wi::scene
 		void Serialize(wi::Archive& archive, wi::ecs::EntitySerializer& seri);
 	};
 
+	// The serialized state of every component in a scene, that deltas can be created against (see Scene::CreateSnapshot())
+	struct SceneSnapshot
+	{
+		struct ComponentData
+		{
+			size_t offset = 0;
+			size_t size = 0;
+		};
+		struct Manager
+		{
+			wi::Archive data; // serialized components of one component manager, changed components are appended
+			size_t garbage = 0; // size of the data that is not referenced anymore, the data is compacted when this grows too large
+			uint64_t version = ~0ull; // version of the component manager that the set of components was captured from
+			wi::unordered_map<wi::ecs::Entity, ComponentData> components; // location of each component in data
+		};
+		wi::vector<Manager> managers; // in the order of scene serialization
+
+		void Clear() { managers.clear(); }
+	};
+
 	struct Scene
 	{
-		wi::ecs::ComponentManager<NameComponent> names;
+		NameComponentManager names;
 		wi::ecs::ComponentManager<LayerComponent> layers;
-		wi::ecs::ComponentManager<TransformComponent> transforms;
-		wi::ecs::ComponentManager<HierarchyComponent> hierarchy;
+		wi::ecs::ComponentManager<TransformComponent, wi::ecs::SparseEntityLookup> transforms; // most entities have these, and they are looked up the most
+		wi::ecs::ComponentManager<HierarchyComponent, wi::ecs::SparseEntityLookup> hierarchy;
 		wi::ecs::ComponentManager<MaterialComponent> materials;
 		wi::ecs::ComponentManager<MeshComponent> meshes;
 		wi::ecs::ComponentManager<ImpostorComponent> impostors;
@@ -1350,6 +1421,10 @@ namespace wi::scene
 		wi::SpinLock locker;
 		wi::primitive::AABB bounds;
 		wi::vector<wi::primitive::AABB> parallel_bounds;
+		wi::jobsystem::TaskGraph update_graph; // update systems with their dependencies, built on first Update()
+		wi::BVH object_bvh; // CPU hierarchy over aabb_objects for culling and queries
+		wi::BVH light_bvh; // CPU hierarchy over aabb_lights
+		wi::BVH decal_bvh; // CPU hierarchy over aabb_decals
 		WeatherComponent weather;
 		wi::graphics::RaytracingAccelerationStructure TLAS;
 		wi::graphics::GPUBuffer TLAS_instancesUpload[wi::graphics::GraphicsDevice::GetBufferCount()];
@@ -1452,6 +1527,96 @@ namespace wi::scene
 		mutable std::atomic_bool lightmap_refresh_needed{ false };
 		wi::vector<TransformComponent> transforms_temp;
 
+		// Animation channels are sampled in parallel into this staging buffer, then applied to the targets in order:
+		struct AnimationSample
+		{
+			AnimationComponent* animation = nullptr;
+			uint32_t channel_index = 0;
+			const AnimationDataComponent* data = nullptr;
+			float time = 0;
+			float amount = 1;
+			bool valid = false; // false if the time was outside the range of keyframes
+
+			TransformComponent* target_transform = nullptr;
+			MeshComponent* target_mesh = nullptr;
+			LightComponent* target_light = nullptr;
+
+			XMFLOAT3 translation = XMFLOAT3(0, 0, 0);
+			XMFLOAT4 rotation = XMFLOAT4(0, 0, 0, 1);
+			XMFLOAT3 scale = XMFLOAT3(1, 1, 1);
+			XMFLOAT3 color = XMFLOAT3(1, 1, 1);
+			float intensity = 0;
+			float range = 0;
+			float innerConeAngle = 0;
+			float outerConeAngle = 0;
+			uint32_t weight_offset = 0; // morph target weights are in animation_sample_weights
+			uint32_t weight_count = 0;
+		};
+		wi::vector<AnimationSample> animation_samples;
+		wi::vector<float> animation_sample_weights;
+
+		// Hierarchy update order with cached component indices, so that the hierarchy update doesn't need entity lookups:
+		struct HierarchyUpdateNode
+		{
+			wi::ecs::Entity parentID = wi::ecs::INVALID_ENTITY;
+			uint32_t hierarchy_index = ~0u;
+			uint32_t transform_index = ~0u;
+			uint32_t layer_index = ~0u;
+			uint32_t parent_transform_index = ~0u; // transform of the closest ancestor that has one
+			uint32_t parent_layer_index = ~0u; // layer of the closest ancestor that has one
+			bool parent_transform_in_hierarchy = false; // if true, the parent world matrix is already updated when this node is updated
+			bool parent_layer_in_hierarchy = false; // if true, the parent propagationMask is already updated when this node is updated
+		};
+		wi::vector<HierarchyUpdateNode> hierarchy_update_nodes; // sorted by depth, so parents are always before children
+		wi::vector<uint32_t> hierarchy_update_levels; // start of each depth level in hierarchy_update_nodes, followed by the node count
+		uint64_t hierarchy_update_versions[3] = {}; // hierarchy, transforms and layers versions that the update order was built from
+		void BuildHierarchyUpdateOrder();
+
+		// Parent -> children index of the hierarchy, it is rebuilt when the hierarchy changed:
+		struct HierarchyChildren
+		{
+			uint32_t offset = 0; // first child in hierarchy_children
+			uint32_t count = 0;
+		};
+		wi::unordered_map<wi::ecs::Entity, HierarchyChildren> hierarchy_children_ranges;
+		wi::vector<wi::ecs::Entity> hierarchy_children; // children grouped by parent
+		uint64_t hierarchy_children_version = ~0ull; // hierarchy version that the index was built from
+		bool hierarchy_children_dirty = true; // set when a parent is changed without adding or removing hierarchy components
+		void UpdateHierarchyChildren();
+
+		// Structure of arrays mirror of the local transforms, which is the input of the batched world matrix composition (wi::math::ComposeTransforms())
+		//	The transform update system gathers the dirty transforms of every job group to the start of the group's range
+		struct TransformSoA
+		{
+			wi::vector<float> scale_x, scale_y, scale_z;
+			wi::vector<float> rotation_x, rotation_y, rotation_z, rotation_w;
+			wi::vector<float> translation_x, translation_y, translation_z;
+			wi::vector<XMFLOAT4X4*> world; // output matrices
+
+			void resize(size_t count);
+			void set(size_t index, TransformComponent& transform);
+			wi::math::TransformArrays get(size_t offset) const;
+		};
+		TransformSoA transforms_soa;
+
+		// Per transform flag for the current frame, set if the world matrix changed (indexed like the transforms ComponentManager)
+		//	Systems that depend on world matrices can skip recomputing data for unchanged transforms
+		wi::vector<uint8_t> transforms_changed;
+		uint64_t decal_update_version = ~0ull; // decals version of the last decal update, every decal is recomputed when it changes
+		uint64_t light_update_version = ~0ull; // lights version of the last light update, every light is recomputed when it changes
+		void CommitTransformsTemp(); // copies back world matrices from transforms_temp and flags the ones that changed
+
+		// Per-frame statistics of the transform update:
+		struct TransformUpdateStatistics
+		{
+			uint32_t transform_count = 0;
+			uint32_t local_changed_count = 0; // transforms whose local space was modified since the previous update
+			uint32_t world_changed_count = 0; // transforms whose world matrix was recomputed, including children of modified transforms
+			bool full_update = false; // the hierarchy changed, so every transform was recomputed
+		};
+		TransformUpdateStatistics transform_statistics;
+		const TransformUpdateStatistics& GetTransformUpdateStatistics() const { return transform_statistics; }
+
 		// Ocean GPU state:
 		wi::Ocean ocean;
 		void OceanRegenerate() { ocean.Create(weather.oceanParameters); }
@@ -1473,9 +1638,21 @@ namespace wi::scene
 
 		// Removes (deletes) a specific entity from the scene (if it exists):
 		//	recursive	: also removes children if true
+		//	The entity itself is not destroyed, because it can be referenced from outside the scene. With generational entities,
+		//	its owner can destroy it with wi::ecs::DestroyEntity() when it's no longer used, so its index can be reused
 		void Entity_Remove(wi::ecs::Entity entity, bool recursive = true);
+		// Removes (deletes) multiple entities from the scene. Every component manager is compacted only once, so this is much faster than removing them one by one:
+		//	recursive	: also removes children if true
+		void Entity_RemoveMany(const wi::vector<wi::ecs::Entity>& entities, bool recursive = true);
+		// Finds the children of an entity in the hierarchy and appends them to the children array:
+		//	recursive	: also finds the children of children if true
+		void Entity_GetChildren(wi::ecs::Entity parent, wi::vector<wi::ecs::Entity>& children, bool recursive = false);
 		// Finds the first entity by the name (if it exists, otherwise returns INVALID_ENTITY):
 		wi::ecs::Entity Entity_FindByName(const std::string& name);
+		// Finds all entities by the name and appends them to the entities array:
+		void Entity_FindAllByName(const std::string& name, wi::vector<wi::ecs::Entity>& entities);
+		// Finds all entities whose name starts with the prefix and appends them to the entities array, ordered by name:
+		void Entity_FindAllByNamePrefix(const std::string& prefix, wi::vector<wi::ecs::Entity>& entities);
 		// Duplicates all of an entity's components and creates a new entity with them (recursively keeps hierarchy):
 		wi::ecs::Entity Entity_Duplicate(wi::ecs::Entity entity);
 
@@ -1568,6 +1745,22 @@ namespace wi::scene
 
 		void Serialize(wi::Archive& archive);
 
+		// Capture the current state of every serialized component into a snapshot
+		//	This is the baseline that CreateDelta() compares against
+		void CreateSnapshot(SceneSnapshot& snapshot);
+		// Write only the components that were added, modified or removed since the snapshot into the delta archive (in write mode)
+		//	inverse_delta		: optional archive (in write mode) that receives the delta which reverts this change, for example for undo
+		//	changed_entities	: optional list of the entities whose components could have been modified in place since the snapshot.
+		//						If it's given, only these components are serialized and compared, and the added and removed components are only searched
+		//						in component managers whose version changed, so the cost depends on the amount of change instead of the scene size.
+		//						If it's nullptr, every component is serialized and compared
+		//	Returns the number of changed components. The snapshot is updated to the current state, so it can be used for the next delta
+		size_t CreateDelta(SceneSnapshot& snapshot, wi::Archive& delta, wi::Archive* inverse_delta = nullptr, const wi::vector<wi::ecs::Entity>* changed_entities = nullptr);
+		// Apply a delta that was written by CreateDelta(), the archive must be in read mode
+		//	snapshot	: optional snapshot of this scene that is updated with the applied components, so that they are not reported as changes by the next CreateDelta()
+		//	Entities are kept as they were, unless a generational entity is no longer alive, then it's recreated consistently within the delta
+		void ApplyDelta(wi::Archive& delta, SceneSnapshot* snapshot = nullptr);
+
 		void RunAnimationUpdateSystem(wi::jobsystem::context& ctx);
 		void RunTransformUpdateSystem(wi::jobsystem::context& ctx);
 		void RunHierarchyUpdateSystem(wi::jobsystem::context& ctx);
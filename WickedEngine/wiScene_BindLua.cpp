@@ -322,6 +322,8 @@ Luna<Scene_BindLua>::FunctionType Scene_BindLua::methods[] = {
 	lunamethod(Scene_BindLua, Clear),
 	lunamethod(Scene_BindLua, Merge),
 	lunamethod(Scene_BindLua, Entity_FindByName),
+	lunamethod(Scene_BindLua, Entity_FindAllByName),
+	lunamethod(Scene_BindLua, Entity_FindAllByNamePrefix),
 	lunamethod(Scene_BindLua, Entity_Remove),
 	lunamethod(Scene_BindLua, Entity_Duplicate),
 	lunamethod(Scene_BindLua, Component_CreateName),
@@ -438,6 +440,56 @@ int Scene_BindLua::Entity_FindByName(lua_State* L)
 	}
 	return 0;
 }
+int Scene_BindLua::Entity_FindAllByName(lua_State* L)
+{
+	int argc = wi::lua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		std::string name = wi::lua::SGetString(L, 1);
+
+		wi::vector<Entity> entities;
+		scene->Entity_FindAllByName(name, entities);
+
+		lua_createtable(L, (int)entities.size(), 0);
+		int newTable = lua_gettop(L);
+		for (size_t i = 0; i < entities.size(); ++i)
+		{
+			wi::lua::SSetLongLong(L, entities[i]);
+			lua_rawseti(L, newTable, lua_Integer(i + 1));
+		}
+		return 1;
+	}
+	else
+	{
+		wi::lua::SError(L, "Scene::Entity_FindAllByName(string name) not enough arguments!");
+	}
+	return 0;
+}
+int Scene_BindLua::Entity_FindAllByNamePrefix(lua_State* L)
+{
+	int argc = wi::lua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		std::string prefix = wi::lua::SGetString(L, 1);
+
+		wi::vector<Entity> entities;
+		scene->Entity_FindAllByNamePrefix(prefix, entities);
+
+		lua_createtable(L, (int)entities.size(), 0);
+		int newTable = lua_gettop(L);
+		for (size_t i = 0; i < entities.size(); ++i)
+		{
+			wi::lua::SSetLongLong(L, entities[i]);
+			lua_rawseti(L, newTable, lua_Integer(i + 1));
+		}
+		return 1;
+	}
+	else
+	{
+		wi::lua::SError(L, "Scene::Entity_FindAllByNamePrefix(string prefix) not enough arguments!");
+	}
+	return 0;
+}
 int Scene_BindLua::Entity_Remove(lua_State* L)
 {
 	int argc = wi::lua::SGetArgCount(L);
@@ -1171,7 +1223,7 @@ int NameComponent_BindLua::SetName(lua_State* L)
 	if (argc > 0)
 	{
 		std::string name = wi::lua::SGetString(L, 1);
-		*component = name;
+		component->SetName(name);
 	}
 	else
 	{
@@ -1181,7 +1233,7 @@ int NameComponent_BindLua::SetName(lua_State* L)
 }
 int NameComponent_BindLua::GetName(lua_State* L)
 {
-	wi::lua::SSetString(L, component->name);
+	wi::lua::SSetString(L, component->GetName());
 	return 1;
 }
 
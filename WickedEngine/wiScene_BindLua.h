@@ -38,6 +38,8 @@ namespace wi::lua::scene
 		int Merge(lua_State* L);
 
 		int Entity_FindByName(lua_State* L);
+		int Entity_FindAllByName(lua_State* L);
+		int Entity_FindAllByNamePrefix(lua_State* L);
 		int Entity_Remove(lua_State* L);
 		int Entity_Duplicate(lua_State* L);
 
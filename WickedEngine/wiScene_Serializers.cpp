@@ -1381,6 +1381,41 @@ namespace wi::scene
 		}
 	}
 
+	// Calls func with every component manager that is serialized with the scene, in the order of serialization
+	//	New component managers must only be added to the end of this list
+	template<typename F>
+	static void ForEachSerializedComponentManager(Scene& scene, F&& func)
+	{
+		func(scene.names);
+		func(scene.layers);
+		func(scene.transforms);
+		func(scene.hierarchy);
+		func(scene.materials);
+		func(scene.meshes);
+		func(scene.impostors);
+		func(scene.objects);
+		func(scene.aabb_objects);
+		func(scene.rigidbodies);
+		func(scene.softbodies);
+		func(scene.armatures);
+		func(scene.lights);
+		func(scene.aabb_lights);
+		func(scene.cameras);
+		func(scene.probes);
+		func(scene.aabb_probes);
+		func(scene.forces);
+		func(scene.decals);
+		func(scene.aabb_decals);
+		func(scene.animations);
+		func(scene.emitters);
+		func(scene.hairs);
+		func(scene.weathers);
+		func(scene.sounds);
+		func(scene.inverse_kinematics);
+		func(scene.springs);
+		func(scene.animation_datas);
+	}
+
 	void Scene::Serialize(wi::Archive& archive)
 	{
 		wi::Timer timer;
@@ -1406,50 +1441,135 @@ namespace wi::scene
 		// With this we will ensure that serialized entities are unique and persistent across the scene:
 		EntitySerializer seri;
 
-		names.Serialize(archive, seri);
-		layers.Serialize(archive, seri);
-		transforms.Serialize(archive, seri);
-		if (archive.GetVersion() < 75)
-		{
-			ComponentManager<DEPRECATED_PreviousFrameTransformComponent> prev_transforms;
-			prev_transforms.Serialize(archive, seri);
-		}
-		hierarchy.Serialize(archive, seri);
-		materials.Serialize(archive, seri);
-		meshes.Serialize(archive, seri);
-		impostors.Serialize(archive, seri);
-		objects.Serialize(archive, seri);
-		aabb_objects.Serialize(archive, seri);
-		rigidbodies.Serialize(archive, seri);
-		softbodies.Serialize(archive, seri);
-		armatures.Serialize(archive, seri);
-		lights.Serialize(archive, seri);
-		aabb_lights.Serialize(archive, seri);
-		cameras.Serialize(archive, seri);
-		probes.Serialize(archive, seri);
-		aabb_probes.Serialize(archive, seri);
-		forces.Serialize(archive, seri);
-		decals.Serialize(archive, seri);
-		aabb_decals.Serialize(archive, seri);
-		animations.Serialize(archive, seri);
-		emitters.Serialize(archive, seri);
-		hairs.Serialize(archive, seri);
-		weathers.Serialize(archive, seri);
-		if (archive.GetVersion() >= 30)
+		if (archive.GetVersion() >= 86)
 		{
-			sounds.Serialize(archive, seri);
-		}
-		if (archive.GetVersion() >= 37)
-		{
-			inverse_kinematics.Serialize(archive, seri);
-		}
-		if (archive.GetVersion() >= 38)
-		{
-			springs.Serialize(archive, seri);
+			// Every component manager is serialized into its own section, and the sections are preceded by their size table,
+			//	so that they can be deserialized in parallel. New component managers must only be added to the end of this list
+			wi::vector<std::function<void(wi::Archive&)>> sections;
+			ForEachSerializedComponentManager(*this, [&](auto& manager) {
+				sections.push_back([&manager, &seri](wi::Archive& section_archive) {
+					manager.Serialize(section_archive, seri);
+				});
+			});
+
+			// The section archives are kept alive until the serialization subtasks of components finish, because they can reference them:
+			wi::vector<wi::Archive> section_archives;
+
+			if (archive.IsReadMode())
+			{
+				// Every entity is remapped up front in the order they were written, so the sections only read the remap.
+				//	This creates the same entities as sequential deserialization would:
+				archive >> seri.entities;
+				seri.remap.reserve(seri.entities.size());
+				for (uint64_t entity : seri.entities)
+				{
+					seri.remap[entity] = CreateEntity();
+				}
+
+				wi::vector<uint64_t> section_sizes;
+				archive >> section_sizes;
+				uint64_t remaining_size = archive.GetRemainingSize();
+				for (uint64_t size : section_sizes)
+				{
+					if (size > remaining_size)
+					{
+						wi::backlog::post("Scene::Serialize: the component sections don't fit in the archive, the scene is not loaded!", wi::backlog::LogLevel::Error);
+						section_sizes.clear();
+						break;
+					}
+					remaining_size -= size;
+				}
+				section_archives.reserve(section_sizes.size());
+				for (uint64_t size : section_sizes)
+				{
+					section_archives.push_back(archive.ReadSection((size_t)size));
+				}
+
+				// Sections that are unknown to this version are skipped, missing sections leave their component managers empty:
+				const uint32_t section_count = (uint32_t)std::min(section_archives.size(), sections.size());
+				seri.remap_readonly = true;
+				wi::jobsystem::context ctx;
+				wi::jobsystem::Dispatch(ctx, section_count, 1, [&](wi::jobsystem::JobArgs args) {
+					sections[args.jobIndex](section_archives[args.jobIndex]);
+				});
+				wi::jobsystem::Wait(ctx);
+				wi::jobsystem::Wait(seri.ctx);
+				seri.remap_readonly = false;
+				if (seri.missing_entities.load() > 0)
+				{
+					wi::backlog::post("Scene::Serialize: " + std::to_string(seri.missing_entities.load()) + " entity references were not in the entity list of the archive, they were cleared and components of them were dropped", wi::backlog::LogLevel::Warning);
+				}
+			}
+			else
+			{
+				seri.collect_entities = true;
+				section_archives.reserve(sections.size());
+				wi::vector<uint64_t> section_sizes;
+				section_sizes.reserve(sections.size());
+				for (auto& serialize : sections)
+				{
+					section_archives.push_back(archive.CreateSection());
+					serialize(section_archives.back());
+					section_sizes.push_back(section_archives.back().GetPos());
+				}
+
+				archive << seri.entities;
+				archive << section_sizes;
+				for (auto& section_archive : section_archives)
+				{
+					archive.WriteSection(section_archive);
+				}
+			}
+
+			wi::jobsystem::Wait(seri.ctx);
 		}
-		if (archive.GetVersion() >= 46)
+		else
 		{
-			animation_datas.Serialize(archive, seri);
+			names.Serialize(archive, seri);
+			layers.Serialize(archive, seri);
+			transforms.Serialize(archive, seri);
+			if (archive.GetVersion() < 75)
+			{
+				ComponentManager<DEPRECATED_PreviousFrameTransformComponent> prev_transforms;
+				prev_transforms.Serialize(archive, seri);
+			}
+			hierarchy.Serialize(archive, seri);
+			materials.Serialize(archive, seri);
+			meshes.Serialize(archive, seri);
+			impostors.Serialize(archive, seri);
+			objects.Serialize(archive, seri);
+			aabb_objects.Serialize(archive, seri);
+			rigidbodies.Serialize(archive, seri);
+			softbodies.Serialize(archive, seri);
+			armatures.Serialize(archive, seri);
+			lights.Serialize(archive, seri);
+			aabb_lights.Serialize(archive, seri);
+			cameras.Serialize(archive, seri);
+			probes.Serialize(archive, seri);
+			aabb_probes.Serialize(archive, seri);
+			forces.Serialize(archive, seri);
+			decals.Serialize(archive, seri);
+			aabb_decals.Serialize(archive, seri);
+			animations.Serialize(archive, seri);
+			emitters.Serialize(archive, seri);
+			hairs.Serialize(archive, seri);
+			weathers.Serialize(archive, seri);
+			if (archive.GetVersion() >= 30)
+			{
+				sounds.Serialize(archive, seri);
+			}
+			if (archive.GetVersion() >= 37)
+			{
+				inverse_kinematics.Serialize(archive, seri);
+			}
+			if (archive.GetVersion() >= 38)
+			{
+				springs.Serialize(archive, seri);
+			}
+			if (archive.GetVersion() >= 46)
+			{
+				animation_datas.Serialize(archive, seri);
+			}
 		}
 
 		if (archive.GetVersion() < 46)
@@ -1783,6 +1903,7 @@ namespace wi::scene
 						if (hier != nullptr)
 						{
 							hier->parentID = entity;
+							hierarchy_children_dirty = true;
 						}
 					}
 				}
@@ -2163,4 +2284,345 @@ namespace wi::scene
 		return entity;
 	}
 
+
+	// Rewrites the data of a snapshot without the components that are not referenced anymore, when they take up most of it
+	static void CompactSnapshot(SceneSnapshot::Manager& state)
+	{
+		if (state.garbage == 0 || state.garbage < state.data.GetPos() / 2)
+			return;
+		wi::Archive data;
+		for (auto& it : state.components)
+		{
+			SceneSnapshot::ComponentData& component = it.second;
+			const size_t offset = data.GetPos();
+			data.WriteData(state.data.GetData() + component.offset, component.size);
+			component.offset = offset;
+		}
+		state.data = std::move(data);
+		state.garbage = 0;
+	}
+
+	// The serialized state replaces the whole component, like deserialization of a new one
+	template<typename T>
+	static void DeserializeComponent(T& component, wi::Archive& archive, EntitySerializer& seri)
+	{
+		component = T();
+		component.Serialize(archive, seri);
+	}
+
+	void Scene::CreateSnapshot(SceneSnapshot& snapshot)
+	{
+		wi::vector<std::function<void(SceneSnapshot::Manager&)>> captures;
+		ForEachSerializedComponentManager(*this, [&](auto& manager) {
+			captures.push_back([&manager](SceneSnapshot::Manager& state) {
+				// Entities are written as they are, so the components can be compared between snapshots:
+				EntitySerializer seri;
+				seri.allow_remap = false;
+				state.data = wi::Archive();
+				state.garbage = 0;
+				state.version = manager.GetVersion();
+				state.components.clear();
+				state.components.reserve(manager.GetCount());
+				for (size_t i = 0; i < manager.GetCount(); ++i)
+				{
+					const size_t offset = state.data.GetPos();
+					manager[i].Serialize(state.data, seri);
+					state.components[manager.GetEntity(i)] = { offset, state.data.GetPos() - offset };
+				}
+			});
+		});
+
+		snapshot.managers.resize(captures.size());
+		wi::jobsystem::context ctx;
+		wi::jobsystem::Dispatch(ctx, (uint32_t)captures.size(), 1, [&](wi::jobsystem::JobArgs args) {
+			captures[args.jobIndex](snapshot.managers[args.jobIndex]);
+		});
+		wi::jobsystem::Wait(ctx);
+	}
+
+	size_t Scene::CreateDelta(SceneSnapshot& snapshot, wi::Archive& delta, wi::Archive* inverse_delta, const wi::vector<Entity>* changed_entities)
+	{
+		struct ManagerDelta
+		{
+			wi::vector<Entity> added;
+			wi::vector<Entity> modified;
+			wi::vector<Entity> removed;
+			wi::vector<SceneSnapshot::ComponentData> previous_modified;
+			wi::vector<SceneSnapshot::ComponentData> previous_removed;
+			bool IsEmpty() const { return added.empty() && modified.empty() && removed.empty(); }
+		};
+
+		// The snapshot is updated in place: changed components are appended to its data, the previous state stays readable until compaction
+		wi::vector<std::function<void(SceneSnapshot::Manager&, ManagerDelta&)>> diffs;
+		ForEachSerializedComponentManager(*this, [&](auto& manager) {
+			diffs.push_back([&manager, changed_entities](SceneSnapshot::Manager& state, ManagerDelta& result) {
+				EntitySerializer seri;
+				seri.allow_remap = false;
+				wi::Archive scratch;
+
+				// Returns true if the component differs from the snapshot state, and then it's appended to the snapshot:
+				auto capture = [&](Entity entity, const SceneSnapshot::ComponentData* prev) {
+					const size_t offset = scratch.GetPos();
+					manager.GetComponent(entity)->Serialize(scratch, seri);
+					const size_t size = scratch.GetPos() - offset;
+					if (prev != nullptr && prev->size == size && std::memcmp(state.data.GetData() + prev->offset, scratch.GetData() + offset, size) == 0)
+					{
+						return false;
+					}
+					SceneSnapshot::ComponentData& component = state.components[entity];
+					component.offset = state.data.GetPos();
+					component.size = size;
+					state.data.WriteData(scratch.GetData() + offset, size);
+					return true;
+				};
+
+				// Components can only be added or removed if the version of the component manager changed:
+				const size_t appended_offset = state.data.GetPos();
+				if (changed_entities == nullptr || state.version != manager.GetVersion())
+				{
+					for (auto& it : state.components)
+					{
+						if (!manager.Contains(it.first))
+						{
+							result.removed.push_back(it.first);
+							result.previous_removed.push_back(it.second);
+							state.garbage += it.second.size;
+						}
+					}
+					for (Entity entity : result.removed)
+					{
+						state.components.erase(entity);
+					}
+					for (size_t i = 0; i < manager.GetCount(); ++i)
+					{
+						const Entity entity = manager.GetEntity(i);
+						if (state.components.find(entity) == state.components.end())
+						{
+							capture(entity, nullptr);
+							result.added.push_back(entity);
+						}
+					}
+					state.version = manager.GetVersion();
+				}
+
+				auto compare = [&](Entity entity) {
+					auto it = state.components.find(entity);
+					if (it == state.components.end() || !manager.Contains(entity))
+						return;
+					const SceneSnapshot::ComponentData prev = it->second;
+					if (prev.offset >= appended_offset)
+						return; // it was already captured by this delta
+					if (capture(entity, &prev))
+					{
+						result.modified.push_back(entity);
+						result.previous_modified.push_back(prev);
+						state.garbage += prev.size;
+					}
+				};
+				if (changed_entities == nullptr)
+				{
+					for (size_t i = 0; i < manager.GetCount(); ++i)
+					{
+						compare(manager.GetEntity(i));
+					}
+				}
+				else
+				{
+					for (Entity entity : *changed_entities)
+					{
+						compare(entity);
+					}
+				}
+			});
+		});
+
+		if (snapshot.managers.size() != diffs.size())
+		{
+			snapshot.managers.clear(); // an empty baseline means that everything was added
+			snapshot.managers.resize(diffs.size());
+		}
+		wi::vector<ManagerDelta> deltas(diffs.size());
+		wi::jobsystem::context ctx;
+		wi::jobsystem::Dispatch(ctx, (uint32_t)diffs.size(), 1, [&](wi::jobsystem::JobArgs args) {
+			diffs[args.jobIndex](snapshot.managers[args.jobIndex], deltas[args.jobIndex]);
+		});
+		wi::jobsystem::Wait(ctx);
+
+		// Per changed component manager: index, removed entities, then the changed components as entity and serialized component pairs
+		auto write_component = [](wi::Archive& archive, const SceneSnapshot::Manager& state, Entity entity, const SceneSnapshot::ComponentData& component) {
+			archive << entity;
+			archive.WriteData(state.data.GetData() + component.offset, component.size);
+		};
+		auto write_entities = [](wi::Archive& archive, const wi::vector<Entity>& entities) {
+			archive << entities.size();
+			for (Entity entity : entities)
+			{
+				archive << entity;
+			}
+		};
+
+		uint32_t changed_manager_count = 0;
+		size_t changed_component_count = 0;
+		for (const ManagerDelta& x : deltas)
+		{
+			if (!x.IsEmpty())
+			{
+				changed_manager_count++;
+				changed_component_count += x.added.size() + x.modified.size() + x.removed.size();
+			}
+		}
+
+		delta << changed_manager_count;
+		for (uint32_t i = 0; i < (uint32_t)deltas.size(); ++i)
+		{
+			const ManagerDelta& x = deltas[i];
+			if (x.IsEmpty())
+				continue;
+			const SceneSnapshot::Manager& state = snapshot.managers[i];
+			delta << i;
+			write_entities(delta, x.removed);
+			delta << (x.added.size() + x.modified.size());
+			for (Entity entity : x.added)
+			{
+				write_component(delta, state, entity, state.components.find(entity)->second);
+			}
+			for (Entity entity : x.modified)
+			{
+				write_component(delta, state, entity, state.components.find(entity)->second);
+			}
+		}
+
+		if (inverse_delta != nullptr)
+		{
+			// The inverse removes the added components and restores the previous state of the modified and removed ones:
+			wi::Archive& inverse = *inverse_delta;
+			inverse << changed_manager_count;
+			for (uint32_t i = 0; i < (uint32_t)deltas.size(); ++i)
+			{
+				const ManagerDelta& x = deltas[i];
+				if (x.IsEmpty())
+					continue;
+				const SceneSnapshot::Manager& state = snapshot.managers[i];
+				inverse << i;
+				write_entities(inverse, x.added);
+				inverse << (x.modified.size() + x.removed.size());
+				for (size_t j = 0; j < x.modified.size(); ++j)
+				{
+					write_component(inverse, state, x.modified[j], x.previous_modified[j]);
+				}
+				for (size_t j = 0; j < x.removed.size(); ++j)
+				{
+					write_component(inverse, state, x.removed[j], x.previous_removed[j]);
+				}
+			}
+		}
+
+		for (SceneSnapshot::Manager& state : snapshot.managers)
+		{
+			CompactSnapshot(state);
+		}
+		return changed_component_count;
+	}
+
+	void Scene::ApplyDelta(wi::Archive& delta, SceneSnapshot* snapshot)
+	{
+		// One EntitySerializer is used for the whole delta, so recreated generational entities are consistent across the component managers:
+		EntitySerializer seri;
+		seri.allow_remap = false;
+
+		wi::vector<std::function<void(wi::Archive&, SceneSnapshot::Manager*)>> appliers;
+		ForEachSerializedComponentManager(*this, [&](auto& manager) {
+			appliers.push_back([&manager, &seri](wi::Archive& archive, SceneSnapshot::Manager* state) {
+				// The snapshot can only follow structural changes if it was up to date before:
+				const bool structure_in_sync = state != nullptr && state->version == manager.GetVersion();
+
+				size_t removed_count = 0;
+				archive >> removed_count;
+				for (size_t i = 0; i < removed_count; ++i)
+				{
+					Entity entity = INVALID_ENTITY;
+					SerializeEntity(archive, entity, seri);
+					if (manager.Contains(entity))
+					{
+						manager.Remove(entity);
+					}
+					if (state != nullptr)
+					{
+						auto it = state->components.find(entity);
+						if (it != state->components.end())
+						{
+							state->garbage += it->second.size;
+							state->components.erase(it);
+						}
+					}
+				}
+				size_t changed_count = 0;
+				archive >> changed_count;
+				for (size_t i = 0; i < changed_count; ++i)
+				{
+					Entity entity = INVALID_ENTITY;
+					SerializeEntity(archive, entity, seri);
+					const size_t offset = archive.GetPos();
+					auto* component = manager.GetComponent(entity);
+					if (component == nullptr)
+					{
+						component = &manager.Create(entity);
+						component->Serialize(archive, seri);
+					}
+					else
+					{
+						DeserializeComponent(*component, archive, seri);
+					}
+					if (state != nullptr)
+					{
+						auto it = state->components.find(entity);
+						if (it != state->components.end())
+						{
+							state->garbage += it->second.size;
+						}
+						SceneSnapshot::ComponentData& data = state->components[entity];
+						data.offset = state->data.GetPos();
+						data.size = archive.GetPos() - offset;
+						state->data.WriteData(archive.GetData() + offset, data.size);
+					}
+				}
+
+				// Components were replaced in place, so everything that was derived from them must be rebuilt:
+				manager.IncrementVersion();
+
+				if (structure_in_sync)
+				{
+					state->version = manager.GetVersion();
+				}
+			});
+		});
+
+		if (snapshot != nullptr && snapshot->managers.size() != appliers.size())
+		{
+			snapshot = nullptr; // the snapshot is not of this scene
+		}
+
+		uint32_t changed_manager_count = 0;
+		delta >> changed_manager_count;
+		for (uint32_t i = 0; i < changed_manager_count; ++i)
+		{
+			uint32_t index = 0;
+			delta >> index;
+			if (index >= appliers.size())
+			{
+				// The rest of the delta can't be located without knowing the component type:
+				wi::backlog::post("Scene::ApplyDelta: unknown component manager in delta, the rest of it is skipped!", wi::backlog::LogLevel::Error);
+				break;
+			}
+			appliers[index](delta, snapshot == nullptr ? nullptr : &snapshot->managers[index]);
+		}
+
+		if (snapshot != nullptr)
+		{
+			for (SceneSnapshot::Manager& state : snapshot->managers)
+			{
+				CompactSnapshot(state);
+			}
+		}
+	}
 }
@@ -0,0 +1,376 @@
+#include "wiTrace.h"
+#include "wiSpinLock.h"
+#include "wiVector.h"
+#include "wiUnorderedMap.h"
+#include "wiHelper.h"
+#include "wiBacklog.h"
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+
+namespace wi::trace
+{
+	namespace trace_internal
+	{
+		enum class EventType : uint8_t
+		{
+			Range,
+			Job,
+			Wait,
+			Frame,
+		};
+		struct Event
+		{
+			const char* name;
+			uint64_t begin;
+			uint64_t end;
+			uint64_t enqueue_time; // Job
+			uint32_t group; // Job, Frame: frame index
+			EventType type;
+		};
+
+		struct ThreadState;
+		std::mutex locker;
+		wi::vector<ThreadState*> threads;
+		struct RetiredThread
+		{
+			uint32_t tid;
+			std::string name;
+			wi::vector<Event> events;
+		};
+		wi::vector<RetiredThread> retired_threads; // events of threads that exited are kept until cleared
+		std::atomic<uint32_t> next_tid{ 0 };
+		uint64_t frame_index = 0;
+		uint32_t capture_frames_remaining = 0;
+		std::string capture_filename;
+
+		// Names are copied, so that the recorded events don't depend on the lifetime of the strings that were given
+		//	The set is node based, so the copies don't move
+		std::mutex names_locker;
+		std::unordered_set<std::string> names;
+
+		// The events of a thread are registered, so that they can be exported from any thread
+		struct ThreadState
+		{
+			wi::SpinLock events_locker; // only contended while exporting
+			wi::vector<Event> events;
+			std::string name;
+			uint32_t tid = 0;
+
+			struct ActiveRange
+			{
+				const char* name;
+				uint64_t begin;
+			};
+			wi::vector<ActiveRange> ranges;
+			const char* label = nullptr;
+			wi::unordered_map<const char*, const char*> name_cache;
+
+			ThreadState()
+			{
+				tid = next_tid.fetch_add(1);
+				name = "Thread " + std::to_string(tid);
+				std::scoped_lock lck(locker);
+				threads.push_back(this);
+			}
+			~ThreadState()
+			{
+				std::scoped_lock lck(locker);
+				if (!events.empty())
+				{
+					retired_threads.push_back({ tid, name, std::move(events) });
+				}
+				for (auto& x : threads)
+				{
+					if (x == this)
+					{
+						x = threads.back();
+						threads.pop_back();
+						break;
+					}
+				}
+			}
+
+			inline void record(const Event& event)
+			{
+				std::scoped_lock lck(events_locker);
+				events.push_back(event);
+			}
+
+			const char* intern(const char* str)
+			{
+				// Most names are string literals that are seen repeatedly from the same address:
+				auto it = name_cache.find(str);
+				if (it != name_cache.end() && std::strcmp(it->second, str) == 0)
+				{
+					return it->second;
+				}
+				std::scoped_lock lck(names_locker);
+				const char* result = names.insert(str).first->c_str();
+				name_cache[str] = result;
+				return result;
+			}
+		};
+		thread_local ThreadState thread_state;
+
+		const auto epoch = std::chrono::steady_clock::now();
+
+		void clear()
+		{
+			std::scoped_lock lck(locker);
+			for (auto& x : threads)
+			{
+				std::scoped_lock lck2(x->events_locker);
+				x->events.clear();
+			}
+			retired_threads.clear();
+		}
+
+		void write_escaped(std::string& out, const char* str)
+		{
+			for (; *str; ++str)
+			{
+				const char c = *str;
+				switch (c)
+				{
+				case '"': out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\t': out += "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20)
+					{
+						char buf[8];
+						snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+						out += buf;
+					}
+					else
+					{
+						out += c;
+					}
+					break;
+				}
+			}
+		}
+
+		void write_time(std::string& out, uint64_t nanoseconds)
+		{
+			// Chrome trace timestamps are in microseconds:
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%.3f", double(nanoseconds) / 1000.0);
+			out += buf;
+		}
+
+		void write_event(std::string& out, const Event& event, uint32_t tid)
+		{
+			out += ",\n{\"pid\":1,\"tid\":";
+			out += std::to_string(tid);
+			out += ",\"ts\":";
+			write_time(out, event.begin);
+			switch (event.type)
+			{
+			case EventType::Range:
+				out += ",\"ph\":\"X\",\"cat\":\"range\",\"name\":\"";
+				write_escaped(out, event.name);
+				out += "\",\"dur\":";
+				write_time(out, event.end - event.begin);
+				out += "}";
+				break;
+			case EventType::Job:
+				out += ",\"ph\":\"X\",\"cat\":\"job\",\"name\":\"";
+				write_escaped(out, event.name == nullptr ? "Job" : event.name);
+				out += "\",\"dur\":";
+				write_time(out, event.end - event.begin);
+				out += ",\"args\":{\"group\":";
+				out += std::to_string(event.group);
+				out += ",\"queued_us\":";
+				write_time(out, event.begin > event.enqueue_time ? event.begin - event.enqueue_time : 0);
+				out += "}}";
+				break;
+			case EventType::Wait:
+				out += ",\"ph\":\"X\",\"cat\":\"wait\",\"name\":\"Wait stall\",\"dur\":";
+				write_time(out, event.end - event.begin);
+				out += "}";
+				break;
+			case EventType::Frame:
+				out += ",\"ph\":\"i\",\"s\":\"g\",\"cat\":\"frame\",\"name\":\"Frame ";
+				out += std::to_string(event.group);
+				out += "\"}";
+				break;
+			}
+		}
+	}
+	using namespace trace_internal;
+
+	void SetEnabled(bool value)
+	{
+		if (value && !IsEnabled())
+		{
+			clear();
+		}
+		enabled.store(value);
+	}
+
+	uint64_t Now()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	void SetThreadName(const std::string& name)
+	{
+		ThreadState& state = thread_state; // first access registers the thread, which also locks
+		std::scoped_lock lck(locker);
+		state.name = name;
+	}
+
+	bool BeginRange(const char* name)
+	{
+		if (!IsEnabled())
+			return false;
+		ThreadState& state = thread_state;
+		state.ranges.push_back({ state.intern(name), Now() });
+		return true;
+	}
+
+	void EndRange()
+	{
+		ThreadState& state = thread_state;
+		if (state.ranges.empty())
+			return;
+		const ThreadState::ActiveRange range = state.ranges.back();
+		state.ranges.pop_back();
+		if (!IsEnabled())
+			return;
+		Event event = {};
+		event.type = EventType::Range;
+		event.name = range.name;
+		event.begin = range.begin;
+		event.end = Now();
+		state.record(event);
+	}
+
+	const char* GetThreadLabel()
+	{
+		const ThreadState& state = thread_state;
+		return state.ranges.empty() ? state.label : state.ranges.back().name;
+	}
+
+	const char* SetThreadLabel(const char* label)
+	{
+		ThreadState& state = thread_state;
+		const char* prev = state.label;
+		state.label = label;
+		return prev;
+	}
+
+	void RecordJob(const char* label, uint64_t enqueue_time, uint64_t begin, uint64_t end, uint32_t group)
+	{
+		if (!IsEnabled())
+			return;
+		Event event = {};
+		event.type = EventType::Job;
+		event.name = label;
+		event.begin = begin;
+		event.end = end;
+		event.enqueue_time = enqueue_time;
+		event.group = group;
+		thread_state.record(event);
+	}
+
+	void RecordWait(uint64_t begin, uint64_t end)
+	{
+		if (!IsEnabled())
+			return;
+		Event event = {};
+		event.type = EventType::Wait;
+		event.begin = begin;
+		event.end = end;
+		thread_state.record(event);
+	}
+
+	void EndFrame()
+	{
+		if (IsEnabled())
+		{
+			Event event = {};
+			event.type = EventType::Frame;
+			event.begin = Now();
+			event.end = event.begin;
+			event.group = (uint32_t)frame_index;
+			thread_state.record(event);
+		}
+		frame_index++;
+
+		if (capture_frames_remaining > 0 && --capture_frames_remaining == 0)
+		{
+			SetEnabled(false);
+			Export(capture_filename);
+			Clear();
+		}
+	}
+
+	void CaptureFrames(uint32_t frame_count, const std::string& filename)
+	{
+		if (frame_count == 0)
+			return;
+		capture_frames_remaining = frame_count;
+		capture_filename = filename;
+		SetEnabled(false);
+		SetEnabled(true);
+	}
+
+	bool Export(const std::string& filename)
+	{
+		std::string out;
+		out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		out += "{\"pid\":1,\"tid\":0,\"ph\":\"M\",\"name\":\"process_name\",\"args\":{\"name\":\"Wicked Engine\"}}";
+
+		size_t event_count = 0;
+		{
+			std::scoped_lock lck(locker);
+			auto write_thread_name = [&](uint32_t tid, const std::string& name) {
+				out += ",\n{\"pid\":1,\"tid\":";
+				out += std::to_string(tid);
+				out += ",\"ph\":\"M\",\"name\":\"thread_name\",\"args\":{\"name\":\"";
+				write_escaped(out, name.c_str());
+				out += "\"}}";
+			};
+			for (auto& thread : retired_threads)
+			{
+				write_thread_name(thread.tid, thread.name);
+				for (auto& event : thread.events)
+				{
+					write_event(out, event, thread.tid);
+				}
+				event_count += thread.events.size();
+			}
+			for (auto& thread : threads)
+			{
+				write_thread_name(thread->tid, thread->name);
+				std::scoped_lock lck2(thread->events_locker);
+				for (auto& event : thread->events)
+				{
+					write_event(out, event, thread->tid);
+				}
+				event_count += thread->events.size();
+			}
+		}
+
+		out += "\n]}\n";
+
+		if (!wi::helper::FileWrite(filename, (const uint8_t*)out.data(), out.size()))
+		{
+			wi::backlog::post("wi::trace::Export failed to write file: " + filename, wi::backlog::LogLevel::Error);
+			return false;
+		}
+		wi::backlog::post("wi::trace::Export: " + std::to_string(event_count) + " events written to " + filename);
+		return true;
+	}
+
+	void Clear()
+	{
+		clear();
+	}
+}
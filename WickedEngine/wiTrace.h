@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Timeline tracing of the CPU work of every thread, which can be exported to the Chrome trace JSON format
+//	The trace can be opened with chrome://tracing, https://ui.perfetto.dev or Speedscope to find load imbalance and idle threads
+//	It records:
+//		- job system jobs: start and end on the executing thread, time spent waiting in queue since submission
+//		- stalls of jobsystem::Wait() when no job could be picked up by the waiting thread
+//		- CPU ranges of wi::profiler (even if the profiler display is disabled) and ranges started with wi::trace::BeginRange()
+//	Tracing is disabled by default, and when disabled it costs one atomic load per traced event
+namespace wi::trace
+{
+	namespace trace_internal
+	{
+		inline std::atomic_bool enabled{ false };
+	}
+
+	// Enable/disable recording of trace events. Enabling clears the previously recorded events
+	//	It is best to toggle it between frames, when no jobs are running
+	void SetEnabled(bool value);
+
+	inline bool IsEnabled() { return trace_internal::enabled.load(std::memory_order_relaxed); }
+
+	// Returns the current time of the trace clock in nanoseconds
+	uint64_t Now();
+
+	// Name the current thread in the exported trace
+	void SetThreadName(const std::string& name);
+
+	// Start a named range on the current thread. Ranges on the same thread must be ended in reverse order that they were started
+	//	returns true if the range was started, in this case EndRange() must be called on the same thread
+	//	Jobs that are submitted while the range is active will be labeled with its name
+	bool BeginRange(const char* name);
+
+	// End the most recently started range of the current thread
+	void EndRange();
+
+	// Range that lasts until the end of the scope
+	struct ScopedRange
+	{
+		bool started = false;
+		ScopedRange(const char* name) : started(BeginRange(name)) {}
+		~ScopedRange() { if (started) EndRange(); }
+		ScopedRange(const ScopedRange&) = delete;
+		ScopedRange& operator=(const ScopedRange&) = delete;
+	};
+
+	// Returns the label that jobs submitted from the current thread will receive:
+	//	the name of the innermost active range, or the label of the job that the thread is executing, or nullptr
+	const char* GetThreadLabel();
+
+	// Set the label of the job that the current thread is executing, returns the previous label
+	//	This is used by the job system, so that jobs submitted from jobs inherit their label
+	const char* SetThreadLabel(const char* label);
+
+	// Record a job that was executed by the current thread
+	//	enqueue_time	: the time when the job was submitted
+	//	begin, end		: the time when the job started and finished executing
+	//	group			: the job group index within its dispatch
+	void RecordJob(const char* label, uint64_t enqueue_time, uint64_t begin, uint64_t end, uint32_t group);
+
+	// Record a period of the current thread waiting on jobs of other threads
+	void RecordWait(uint64_t begin, uint64_t end);
+
+	// Mark the end of a frame. This drives the automatic export that was started with CaptureFrames()
+	//	wi::Application calls this at the end of every frame, applications with their own main loop should call it themselves
+	void EndFrame();
+
+	// Start tracing now, and after frame_count frames have ended, export the trace to a file and disable tracing
+	void CaptureFrames(uint32_t frame_count, const std::string& filename = "trace.json");
+
+	// Export every recorded event to a Chrome trace JSON file
+	//	returns false if the file couldn't be written
+	bool Export(const std::string& filename);
+
+	// Remove every recorded event
+	void Clear();
+}
@@ -32,11 +32,11 @@ namespace wi
 		{
 			resize(size);
 		}
-		inline vector(const vector<T>& other)
+		inline vector(const vector<T, A>& other)
 		{
 			copy_from(other);
 		}
-		inline vector(vector<T>&& other) noexcept
+		inline vector(vector<T, A>&& other) noexcept
 		{
 			move_from(std::move(other));
 		}
@@ -56,12 +56,12 @@ namespace wi
 				m_allocator.deallocate(m_data, m_capacity);
 			}
 		}
-		inline vector<T>& operator=(const vector<T>& other)
+		inline vector<T, A>& operator=(const vector<T, A>& other)
 		{
 			copy_from(other);
 			return *this;
 		}
-		inline vector<T>& operator=(vector<T>&& other)
+		inline vector<T, A>& operator=(vector<T, A>&& other)
 		{
 			move_from(std::move(other));
 			return *this;
@@ -266,7 +266,7 @@ namespace wi
 			}
 			return nullptr;
 		}
-		inline void copy_from(const vector<T>& other)
+		inline void copy_from(const vector<T, A>& other)
 		{
 			resize(other.size());
 			for (size_t i = 0; i < m_size; ++i)
@@ -274,7 +274,7 @@ namespace wi
 				m_data[i] = other.m_data[i];
 			}
 		}
-		inline void move_from(vector<T>&& other)
+		inline void move_from(vector<T, A>&& other)
 		{
 			clear();
 			if (m_data != nullptr)